@@ -0,0 +1,713 @@
+﻿#include "Exports.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// measures the per call latency of every function in exports.def against the fake backend and prints the results as json
+// usage: WinGamingInputBench [--devices 1,4,16,64] [--threads 1,2,...,16] [--samples 1000] [--batch 32] [--rate 1000] [--output file]
+
+using namespace WindowsGamingInput;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	struct Options
+	{
+		std::vector<size_t> devices{ 1, 4, 16, 64 };
+		std::vector<size_t> threads{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+		size_t samples = 1000; // timed batches per entry point
+		size_t batch = 32; // calls per timed batch
+		uint32_t rate = 1000; // readings per second produced by every fake device
+		std::string output;
+	};
+
+	// ns per call
+	struct Result
+	{
+		std::string name;
+		size_t samples;
+		double mean, min, p50, p90, p99, max;
+	};
+
+	struct ScalingResult
+	{
+		std::string name;
+		size_t threads;
+		double calls_per_second;
+		double mean; // ns per call and thread
+		size_t hotplugs; // devices added and removed by the writer while the readers ran
+	};
+
+	constexpr size_t kButtonCount = 16;
+	constexpr size_t kSwitchCount = 4;
+	constexpr size_t kAxisCount = 6;
+
+	// keeps the results of the measured calls alive
+	volatile uint64_t g_sink;
+
+	template<typename T>
+	void Consume(const T& value)
+	{
+		g_sink = (uint64_t)value;
+	}
+
+	Result Summarize(std::string name, std::vector<double>& ns)
+	{
+		std::sort(ns.begin(), ns.end());
+		const auto percentile = [&ns](double p) { return ns[std::min(ns.size() - 1, (size_t)(p * (double)ns.size()))]; };
+
+		Result result{ std::move(name), ns.size() };
+		result.mean = std::accumulate(ns.cbegin(), ns.cend(), 0.0) / (double)ns.size();
+		result.min = ns.front();
+		result.p50 = percentile(0.5);
+		result.p90 = percentile(0.9);
+		result.p99 = percentile(0.99);
+		result.max = ns.back();
+		return result;
+	}
+
+	// call(i) gets invoked with a running call index, every sample is the mean of batch calls
+	template<typename F>
+	Result Measure(std::string name, const Options& options, F&& call)
+	{
+		size_t i = 0;
+		for (size_t n = 0; n < options.samples / 10 * options.batch; ++n)
+			Consume(call(i++));
+
+		std::vector<double> ns(options.samples);
+		for (auto& sample : ns)
+		{
+			const auto start = Clock::now();
+			for (size_t n = 0; n < options.batch; ++n)
+				Consume(call(i++));
+
+			sample = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / (double)options.batch;
+		}
+
+		return Summarize(std::move(name), ns);
+	}
+
+	// for entry points that only make sense in pairs (start/stop, add/remove), every sample is a single call of each
+	template<typename F, typename G>
+	void MeasurePair(std::vector<Result>& results, std::string first_name, std::string second_name, size_t samples, F&& first, G&& second)
+	{
+		std::vector<double> first_ns(samples), second_ns(samples);
+		for (size_t i = 0; i < samples; ++i)
+		{
+			const auto start = Clock::now();
+			Consume(first());
+			const auto middle = Clock::now();
+			second();
+			const auto end = Clock::now();
+
+			first_ns[i] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count();
+			second_ns[i] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count();
+		}
+
+		results.emplace_back(Summarize(std::move(first_name), first_ns));
+		results.emplace_back(Summarize(std::move(second_name), second_ns));
+	}
+
+	// every thread does calls calls of call(thread, i) after all threads got started
+	// with a backend given, a writer thread keeps hot-plugging a gamepad and a raw controller on it until the readers are done
+	template<typename F>
+	ScalingResult MeasureScaling(std::string name, size_t thread_count, size_t calls, Backend::FakeBackend* churn, F&& call)
+	{
+		std::latch ready(thread_count + 1);
+		std::atomic_bool done = false;
+		size_t hotplugs = 0;
+		std::thread writer;
+		if (churn)
+		{
+			writer = std::thread([&]
+			{
+				while (!done.load(std::memory_order_relaxed))
+				{
+					const auto gamepad = churn->AddGamepad();
+					const auto controller = churn->AddRawController(L"bench-churn", L"Benchmark Churn Controller", kButtonCount, kSwitchCount, kAxisCount);
+					churn->Remove(gamepad);
+					churn->Remove(controller);
+					hotplugs += 2;
+				}
+			});
+		}
+
+		std::vector<double> thread_ns(thread_count);
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < thread_count; ++t)
+		{
+			threads.emplace_back([&, t]
+			{
+				ready.arrive_and_wait();
+				const auto start = Clock::now();
+				for (size_t i = 0; i < calls; ++i)
+					Consume(call(t, i));
+
+				thread_ns[t] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+			});
+		}
+
+		ready.arrive_and_wait();
+		for (auto& thread : threads)
+			thread.join();
+
+		done = true;
+		if (writer.joinable())
+		{
+			writer.join();
+			name += " (hot-plug)";
+		}
+
+		const double slowest = *std::max_element(thread_ns.cbegin(), thread_ns.cend());
+		const double total = std::accumulate(thread_ns.cbegin(), thread_ns.cend(), 0.0);
+		return { std::move(name), thread_count, (double)(calls * thread_count) * 1e9 / slowest, total / (double)(calls * thread_count), hotplugs };
+	}
+
+	void OnControllerChanged(EventType, ControllerType, std::variant<size_t, std::wstring_view>) {}
+
+	// buffers for one raw controller reading
+	struct RawBuffers
+	{
+		bool buttons[kButtonCount]{};
+		SwitchPosition switches[kSwitchCount]{};
+		double axis[kAxisCount]{};
+		uint64_t timestamp = 0;
+
+		RawController::State GetState()
+		{
+			return { buttons, kButtonCount, switches, kSwitchCount, axis, kAxisCount, 0 };
+		}
+	};
+
+	struct Run
+	{
+		size_t devices;
+		std::vector<Result> results;
+		std::vector<ScalingResult> scaling;
+	};
+
+	Run RunDevices(const Options& options, size_t device_count)
+	{
+		Run run{ device_count };
+		auto& results = run.results;
+
+		auto backend = std::make_shared<Backend::FakeBackend>();
+		std::vector<std::wstring> uids;
+		for (size_t i = 0; i < device_count; ++i)
+		{
+			backend->SetBatteryStatus(backend->AddGamepad(options.rate), true, BatteryStatus::Discharging, 0.5);
+
+			uids.emplace_back(L"bench-" + std::to_wstring(i));
+			const auto id = backend->AddRawController(uids.back(), L"Benchmark Controller " + std::to_wstring(i), kButtonCount, kSwitchCount, kAxisCount, options.rate);
+			backend->SetBatteryStatus(id, false, BatteryStatus::NotPresent, 0);
+		}
+		Backend::SetBackend(backend);
+
+		std::vector<std::wstring_view> uid_views(uids.cbegin(), uids.cend());
+		std::vector<RawController::Handle> handles;
+		for (const auto& uid : uids)
+			handles.emplace_back(RawGameController::Open(uid));
+
+		const auto device = [device_count](size_t i) { return i % device_count; };
+
+		// top level
+		MeasurePair(results, "AddControllerChanged", "RemoveControllerChanged", options.samples,
+			[] { AddControllerChanged(&OnControllerChanged); return 0; },
+			[] { RemoveControllerChanged(&OnControllerChanged); });
+		results.emplace_back(Measure("GetInitializationStats", options, [](size_t)
+		{
+			InitializationStats stats;
+			GetInitializationStats(stats);
+			return stats.gamepads;
+		}));
+		results.emplace_back(Measure("GetControllerChangedStats", options, [](size_t)
+		{
+			ControllerChangedStats stats;
+			GetControllerChangedStats(stats);
+			return stats.delivered;
+		}));
+		results.emplace_back(Measure("GetMetrics", options, [](size_t)
+		{
+			Metrics metrics;
+			GetMetrics(metrics);
+			return metrics.calls[(size_t)EntryPoint::GetMetrics];
+		}));
+		results.emplace_back(Measure("ResetMetrics", options, [](size_t) { ResetMetrics(); return 0; }));
+		results.emplace_back(Measure("WaitForInput (timeout 0)", options, [](size_t) { return (int)WaitForInput(1, nullptr, 0, 0); }));
+		results.emplace_back(Measure("GetHostTime", options, [](size_t) { return GetHostTime(); }));
+
+		const auto recording = (std::filesystem::temp_directory_path() / "WinGamingInputBench.wgir").wstring();
+		MeasurePair(results, "StartRecording", "StopRecording", std::max<size_t>(options.samples / 10, 1),
+			[&recording] { return StartRecording(recording); },
+			[] { StopRecording(); });
+		std::error_code ec;
+		std::filesystem::remove(recording, ec);
+
+		// gamepads
+		results.emplace_back(Measure("Gamepad_IsInitialized", options, [](size_t) { return Gamepad::IsInitialized(); }));
+		results.emplace_back(Measure("Gamepad_GetCount", options, [](size_t) { return Gamepad::GetCount(); }));
+		results.emplace_back(Measure("Gamepad_IsConnected", options, [&](size_t i) { return Gamepad::IsConnected(device(i)); }));
+		results.emplace_back(Measure("Gamepad_GetGeneration", options, [&](size_t i) { return Gamepad::GetGeneration(device(i)); }));
+		results.emplace_back(Measure("Gamepad_IsWireless", options, [&](size_t i)
+		{
+			bool wireless;
+			return Gamepad::IsWireless(device(i), wireless) && wireless;
+		}));
+		results.emplace_back(Measure("Gamepad_GetBatteryStatus", options, [&](size_t i)
+		{
+			BatteryStatus status;
+			double battery;
+			return Gamepad::GetBatteryStatus(device(i), status, battery) ? battery : 0.0;
+		}));
+		SetStatusRefreshInterval(0);
+		results.emplace_back(Measure("Gamepad_GetBatteryStatus (uncached)", options, [&](size_t i)
+		{
+			BatteryStatus status;
+			double battery;
+			return Gamepad::GetBatteryStatus(device(i), status, battery) ? battery : 0.0;
+		}));
+		SetStatusRefreshInterval(2000);
+		results.emplace_back(Measure("Gamepad_GetState", options, [&](size_t i)
+		{
+			GamepadState state;
+			return Gamepad::GetState(device(i), state) ? state.Timestamp : 0;
+		}));
+
+		std::vector<GamepadState> states(device_count);
+		results.emplace_back(Measure("Gamepad_GetAllStates", options, [&](size_t)
+		{
+			uint64_t connected;
+			return Gamepad::GetAllStates(states.data(), states.size(), connected);
+		}));
+		results.emplace_back(Measure("Gamepad_GetPackedState", options, [&](size_t i)
+		{
+			PackedGamepadState state;
+			uint64_t timestamp;
+			return Gamepad::GetPackedState(device(i), state, timestamp) ? timestamp : 0;
+		}));
+
+		std::vector<PackedGamepadState> packed_states(device_count);
+		results.emplace_back(Measure("Gamepad_GetAllPackedStates", options, [&](size_t)
+		{
+			uint64_t timestamp, connected;
+			return Gamepad::GetAllPackedStates(packed_states.data(), packed_states.size(), timestamp, connected);
+		}));
+
+		results.emplace_back(Measure("Gamepad_SetVibration", options, [&](size_t i)
+		{
+			Vibration vibration;
+			vibration.LeftMotor = (double)(i & 1);
+			return Gamepad::SetVibration(device(i), vibration);
+		}));
+		results.emplace_back(Measure("Gamepad_SubmitVibration", options, [&](size_t i)
+		{
+			Vibration vibration;
+			vibration.LeftMotor = (double)(i & 1);
+			return Gamepad::SubmitVibration(device(i), vibration);
+		}));
+
+		// a short rumble followed by a pulse train on the right motor
+		VibrationEffect effect;
+		effect.channels[0] = { 1.0, 0, 10, 50, 100 };
+		effect.channels[1] = { 0.5, 100, 0, 20, 0, 60, 5 };
+		results.emplace_back(Measure("Gamepad_PlayEffect", options, [&](size_t i) { return Gamepad::PlayEffect(device(i), effect); }));
+		results.emplace_back(Measure("Gamepad_StopEffect", options, [&](size_t i) { return Gamepad::StopEffect(device(i)); }));
+		results.emplace_back(Measure("Gamepad_GetVibration", options, [&](size_t i)
+		{
+			Vibration vibration;
+			return Gamepad::GetVibration(device(i), vibration) ? vibration.LeftMotor : 0.0;
+		}));
+
+		// the same reads with a deadzone and curve on every axis
+		GamepadProcessing processing;
+		processing.axes[0] = processing.axes[1] = { 0.0, 0.0, 1.0, 0.05 };
+		for (size_t axis = 2; axis < std::size(processing.axes); ++axis)
+			processing.axes[axis] = { -1.0, 0.0, 1.0, 0.15, 0.95, 0.5 };
+
+		results.emplace_back(Measure("Gamepad_SetProcessing", options, [&](size_t i) { return Gamepad::SetProcessing(device(i), &processing); }));
+		results.emplace_back(Measure("Gamepad_GetState (processing)", options, [&](size_t i)
+		{
+			GamepadState state;
+			return Gamepad::GetState(device(i), state) ? state.Timestamp : 0;
+		}));
+		results.emplace_back(Measure("Gamepad_GetAllStates (processing)", options, [&](size_t)
+		{
+			uint64_t connected;
+			return Gamepad::GetAllStates(states.data(), states.size(), connected);
+		}));
+		for (size_t i = 0; i < device_count; ++i)
+			Gamepad::SetProcessing(i, nullptr);
+
+		results.emplace_back(Measure("Gamepad_ToHostTime", options, [&](size_t i)
+		{
+			uint64_t host;
+			return Gamepad::ToHostTime(device(i), i, host) ? host : 0;
+		}));
+		results.emplace_back(Measure("Gamepad_GetTimingStats", options, [&](size_t i)
+		{
+			ReadingTimingStats stats;
+			return Gamepad::GetTimingStats(device(i), stats) ? stats.age.count : 0;
+		}));
+
+		MeasurePair(results, "Gamepad_StartPolling", "Gamepad_StopPolling", std::max<size_t>(options.samples / 10, 1),
+			[] { return Gamepad::StartPolling(1000); },
+			[] { Gamepad::StopPolling(); });
+		results.emplace_back(Measure("Gamepad_SetAdaptivePolling", options, [](size_t i) { Gamepad::SetAdaptivePolling(i & 1); return 0; }));
+		Gamepad::SetAdaptivePolling(false);
+		MeasurePair(results, "Gamepad_EnableChangeEvents", "Gamepad_DisableChangeEvents", options.samples,
+			[] { return Gamepad::EnableChangeEvents(1024); },
+			[] { Gamepad::DisableChangeEvents(); });
+
+		// reads served from the published snapshots while polling
+		Gamepad::StartPolling(1000);
+		Gamepad::EnableChangeEvents(1024);
+		results.emplace_back(Measure("Gamepad_GetState (polling)", options, [&](size_t i)
+		{
+			GamepadState state;
+			return Gamepad::GetState(device(i), state) ? state.Timestamp : 0;
+		}));
+		results.emplace_back(Measure("Gamepad_GetAllStates (polling)", options, [&](size_t)
+		{
+			uint64_t connected;
+			return Gamepad::GetAllStates(states.data(), states.size(), connected);
+		}));
+		results.emplace_back(Measure("Gamepad_GetAllPackedStates (polling)", options, [&](size_t)
+		{
+			uint64_t timestamp, connected;
+			return Gamepad::GetAllPackedStates(packed_states.data(), packed_states.size(), timestamp, connected);
+		}));
+
+		GamepadChange changes[64];
+		results.emplace_back(Measure("Gamepad_PopChanges", options, [&](size_t) { return Gamepad::PopChanges(changes, std::size(changes)); }));
+		Gamepad::DisableChangeEvents();
+		Gamepad::StopPolling();
+
+		// raw controllers
+		results.emplace_back(Measure("RawGameController_IsInitialized", options, [](size_t) { return RawGameController::IsInitialized(); }));
+		results.emplace_back(Measure("RawGameController_GetCount", options, [](size_t) { return RawGameController::GetCount(); }));
+
+		std::vector<RawController::Description> descriptions(device_count);
+		results.emplace_back(Measure("RawGameController_GetControllers", options, [&](size_t)
+		{
+			return RawGameController::GetControllers(descriptions.data(), descriptions.size());
+		}));
+
+		uint64_t version = 0;
+		size_t count = descriptions.size();
+		RawGameController::GetControllersIfChanged(version, descriptions.data(), count);
+		results.emplace_back(Measure("RawGameController_GetControllersIfChanged", options, [&](size_t)
+		{
+			size_t count = descriptions.size();
+			return RawGameController::GetControllersIfChanged(version, descriptions.data(), count);
+		}));
+
+		results.emplace_back(Measure("RawGameController_GetController", options, [&](size_t i)
+		{
+			RawController::Description description;
+			return RawGameController::GetController(uid_views[device(i)], description) ? description.button_count : 0;
+		}));
+		results.emplace_back(Measure("RawGameController_Open", options, [&](size_t i) { return RawGameController::Open(uid_views[device(i)]); }));
+
+		// every entry point with a uid has a handle overload
+		const auto measure_both = [&](const std::string& name, auto&& call)
+		{
+			results.emplace_back(Measure("RawGameController_" + name, options, [&](size_t i) { return call(uid_views[device(i)], i); }));
+			results.emplace_back(Measure("RawGameController_" + name + "ByHandle", options, [&](size_t i) { return call(handles[device(i)], i); }));
+		};
+
+		measure_both("GetButtonLabel", [](auto controller, size_t i)
+		{
+			ButtonLabel label;
+			return RawGameController::GetButtonLabel(controller, i % kButtonCount, label) ? (int)label : -1;
+		});
+		measure_both("GetCapabilities", [](auto controller, size_t)
+		{
+			RawController::Capabilities capabilities;
+			ButtonLabel labels[kButtonCount];
+			return RawGameController::GetCapabilities(controller, capabilities, labels, kButtonCount) ? (int)labels[kButtonCount - 1] : -1;
+		});
+		measure_both("IsConnected", [](auto controller, size_t) { return RawGameController::IsConnected(controller); });
+		measure_both("IsWireless", [](auto controller, size_t)
+		{
+			bool wireless;
+			return RawGameController::IsWireless(controller, wireless) && wireless;
+		});
+		measure_both("GetBatteryStatus", [](auto controller, size_t)
+		{
+			BatteryStatus status;
+			double battery;
+			return RawGameController::GetBatteryStatus(controller, status, battery) ? battery : 0.0;
+		});
+
+		RawBuffers buffers;
+		measure_both("GetState", [&buffers](auto controller, size_t)
+		{
+			return RawGameController::GetState(controller, buffers.buttons, kButtonCount, buffers.switches, kSwitchCount, buffers.axis, kAxisCount, buffers.timestamp) ? buffers.timestamp : 0;
+		});
+
+		uint64_t packed_buttons[(kButtonCount + 63) / 64], changed_buttons[(kButtonCount + 63) / 64], previous_buttons[(kButtonCount + 63) / 64]{};
+		measure_both("GetPackedState", [&](auto controller, size_t)
+		{
+			return RawGameController::GetPackedState(controller, packed_buttons, changed_buttons, previous_buttons, std::size(packed_buttons), buffers.switches, kSwitchCount, buffers.axis, kAxisCount, buffers.timestamp) ? buffers.timestamp : 0;
+		});
+
+		AxisProcessing axis_processing[kAxisCount];
+		for (auto& axis : axis_processing)
+			axis = { 0.0, 0.5, 1.0, 0.1, 1.0, 0.5 };
+
+		measure_both("SetProcessing", [&](auto controller, size_t) { return RawGameController::SetProcessing(controller, axis_processing, kAxisCount, 1); });
+		results.emplace_back(Measure("RawGameController_GetStateByHandle (processing)", options, [&](size_t i)
+		{
+			return RawGameController::GetState(handles[device(i)], buffers.buttons, kButtonCount, buffers.switches, kSwitchCount, buffers.axis, kAxisCount, buffers.timestamp) ? buffers.timestamp : 0;
+		}));
+		for (const auto handle : handles)
+			RawGameController::SetProcessing(handle, nullptr, 0, 0);
+
+		std::vector<RawBuffers> all_buffers(device_count);
+		std::vector<RawController::State> raw_states(device_count);
+		for (size_t i = 0; i < device_count; ++i)
+			raw_states[i] = all_buffers[i].GetState();
+
+		results.emplace_back(Measure("RawGameController_GetAllStates", options, [&](size_t)
+		{
+			uint64_t connected;
+			return RawGameController::GetAllStates(uid_views.data(), raw_states.data(), raw_states.size(), connected);
+		}));
+		results.emplace_back(Measure("RawGameController_GetAllStatesByHandle", options, [&](size_t)
+		{
+			uint64_t connected;
+			return RawGameController::GetAllStates(handles.data(), raw_states.data(), raw_states.size(), connected);
+		}));
+
+		measure_both("SetVibration", [](auto controller, size_t i) { return RawGameController::SetVibration(controller, (double)(i & 1)); });
+		measure_both("SubmitVibration", [](auto controller, size_t i) { return RawGameController::SubmitVibration(controller, (double)(i & 1)); });
+		measure_both("PlayEffect", [&](auto controller, size_t) { return RawGameController::PlayEffect(controller, effect); });
+		measure_both("StopEffect", [](auto controller, size_t) { return RawGameController::StopEffect(controller); });
+		measure_both("IsVibrating", [](auto controller, size_t) { return RawGameController::IsVibrating(controller); });
+		measure_both("HasVibration", [](auto controller, size_t) { return RawGameController::HasVibration(controller); });
+		measure_both("ToHostTime", [](auto controller, size_t i)
+		{
+			uint64_t host;
+			return RawGameController::ToHostTime(controller, i, host) ? host : 0;
+		});
+		measure_both("GetTimingStats", [](auto controller, size_t)
+		{
+			ReadingTimingStats stats;
+			return RawGameController::GetTimingStats(controller, stats) ? stats.age.count : 0;
+		});
+
+		// the same devices read back through the shared memory in this process
+		const std::wstring shared_name = L"WinGamingInputBench";
+		SharedState::StartPublishing(shared_name, 1000);
+		const SharedState::View* view = nullptr;
+		MeasurePair(results, "SharedState_Open", "SharedState_Close", std::max<size_t>(options.samples / 10, 1),
+			[&] { view = SharedState::Open(shared_name); return view != nullptr; },
+			[&] { SharedState::Close(view); });
+
+		view = SharedState::Open(shared_name);
+		results.emplace_back(Measure("SharedState_GetUpdateTime", options, [&](size_t) { return SharedState::GetUpdateTime(view); }));
+		results.emplace_back(Measure("SharedState_GetGamepadState", options, [&](size_t i)
+		{
+			GamepadState state;
+			return SharedState::GetGamepadState(view, device(i), state) ? state.Timestamp : 0;
+		}));
+
+		std::vector<RawController::Handle> shared_handles(device_count);
+		results.emplace_back(Measure("SharedState_GetRawControllers", options, [&](size_t)
+		{
+			return SharedState::GetRawControllers(view, descriptions.data(), shared_handles.data(), shared_handles.size());
+		}));
+		shared_handles.resize(std::max<size_t>(SharedState::GetRawControllers(view, nullptr, shared_handles.data(), shared_handles.size()), 1));
+		results.emplace_back(Measure("SharedState_GetRawControllerState", options, [&](size_t i)
+		{
+			auto state = buffers.GetState();
+			return SharedState::GetRawControllerState(view, shared_handles[i % shared_handles.size()], state) ? state.timestamp : 0;
+		}));
+		SharedState::Close(view);
+		SharedState::StopPublishing();
+
+		// concurrent readers, each thread reads all devices in turn
+		// once quiet and once while a writer hot-plugs devices, so the registry swaps are part of the measurement
+		const size_t calls = options.samples * options.batch;
+		std::vector<RawBuffers> thread_buffers(*std::max_element(options.threads.cbegin(), options.threads.cend()));
+		for (const size_t thread_count : options.threads)
+		for (auto* churn : { (Backend::FakeBackend*)nullptr, backend.get() })
+		{
+			run.scaling.emplace_back(MeasureScaling("Gamepad_GetState", thread_count, calls, churn, [&](size_t, size_t i)
+			{
+				GamepadState state;
+				return Gamepad::GetState(device(i), state) ? state.Timestamp : 0;
+			}));
+			run.scaling.emplace_back(MeasureScaling("RawGameController_GetState", thread_count, calls, churn, [&](size_t t, size_t i)
+			{
+				auto& buffers = thread_buffers[t];
+				return RawGameController::GetState(uid_views[device(i)], buffers.buttons, kButtonCount, buffers.switches, kSwitchCount, buffers.axis, kAxisCount, buffers.timestamp);
+			}));
+			run.scaling.emplace_back(MeasureScaling("RawGameController_GetStateByHandle", thread_count, calls, churn, [&](size_t t, size_t i)
+			{
+				auto& buffers = thread_buffers[t];
+				return RawGameController::GetState(handles[device(i)], buffers.buttons, kButtonCount, buffers.switches, kSwitchCount, buffers.axis, kAxisCount, buffers.timestamp);
+			}));
+		}
+
+		Gamepad::StartPolling(1000);
+		for (const size_t thread_count : options.threads)
+		for (auto* churn : { (Backend::FakeBackend*)nullptr, backend.get() })
+		{
+			run.scaling.emplace_back(MeasureScaling("Gamepad_GetState (polling)", thread_count, calls, churn, [&](size_t, size_t i)
+			{
+				GamepadState state;
+				return Gamepad::GetState(device(i), state) ? state.Timestamp : 0;
+			}));
+		}
+		Gamepad::StopPolling();
+
+		Backend::SetBackend(nullptr);
+		return run;
+	}
+
+	void WriteJson(std::ostream& out, const Options& options, const std::vector<Run>& runs)
+	{
+		const auto join = [](const std::vector<size_t>& values)
+		{
+			std::string result;
+			for (const auto value : values)
+				result += (result.empty() ? "" : ", ") + std::to_string(value);
+			return result;
+		};
+
+		out.setf(std::ios::fixed);
+		out.precision(1);
+		out << "{\n";
+		out << "\t\"config\": { \"samples\": " << options.samples << ", \"batch\": " << options.batch << ", \"rate\": " << options.rate
+			<< ", \"devices\": [" << join(options.devices) << "], \"threads\": [" << join(options.threads) << "] },\n";
+		out << "\t\"runs\": [\n";
+		for (size_t r = 0; r < runs.size(); ++r)
+		{
+			const auto& run = runs[r];
+			out << "\t\t{\n\t\t\t\"devices\": " << run.devices << ",\n\t\t\t\"entry_points\": [\n";
+			for (size_t i = 0; i < run.results.size(); ++i)
+			{
+				const auto& result = run.results[i];
+				out << "\t\t\t\t{ \"name\": \"" << result.name << "\", \"samples\": " << result.samples
+					<< ", \"mean_ns\": " << result.mean << ", \"min_ns\": " << result.min << ", \"p50_ns\": " << result.p50
+					<< ", \"p90_ns\": " << result.p90 << ", \"p99_ns\": " << result.p99 << ", \"max_ns\": " << result.max
+					<< " }" << (i + 1 < run.results.size() ? "," : "") << "\n";
+			}
+
+			out << "\t\t\t],\n\t\t\t\"scaling\": [\n";
+			for (size_t i = 0; i < run.scaling.size(); ++i)
+			{
+				const auto& result = run.scaling[i];
+				out << "\t\t\t\t{ \"name\": \"" << result.name << "\", \"threads\": " << result.threads
+					<< ", \"calls_per_second\": " << result.calls_per_second << ", \"mean_ns\": " << result.mean
+					<< ", \"hotplugs\": " << result.hotplugs << " }" << (i + 1 < run.scaling.size() ? "," : "") << "\n";
+			}
+
+			out << "\t\t\t]\n\t\t}" << (r + 1 < runs.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n}\n";
+	}
+
+	bool ParseList(const char* arg, std::vector<size_t>& values)
+	{
+		values.clear();
+		std::stringstream stream(arg);
+		std::string value;
+		while (std::getline(stream, value, ','))
+		{
+			const size_t parsed = std::strtoull(value.c_str(), nullptr, 10);
+			if (parsed == 0)
+				return false;
+
+			values.emplace_back(parsed);
+		}
+
+		return !values.empty();
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (!value)
+				return false;
+
+			++i;
+			if (arg == "--devices")
+			{
+				// one bit per device in the GetAllStates masks
+				if (!ParseList(value, options.devices) || *std::max_element(options.devices.cbegin(), options.devices.cend()) > 64)
+					return false;
+			}
+			else if (arg == "--threads")
+			{
+				if (!ParseList(value, options.threads))
+					return false;
+			}
+			else if (arg == "--samples")
+				options.samples = std::max<size_t>(std::strtoull(value, nullptr, 10), 1);
+			else if (arg == "--batch")
+				options.batch = std::max<size_t>(std::strtoull(value, nullptr, 10), 1);
+			else if (arg == "--rate")
+				options.rate = (uint32_t)std::strtoul(value, nullptr, 10);
+			else if (arg == "--output")
+				options.output = value;
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--devices 1,4,16,64] [--threads 1,2,...,16] [--samples 1000] [--batch 32] [--rate 1000] [--output file]" << std::endl;
+		return 1;
+	}
+
+	std::vector<Run> runs;
+	for (const size_t device_count : options.devices)
+	{
+		std::cerr << "running with " << device_count << " devices" << std::endl;
+		runs.emplace_back(RunDevices(options, device_count));
+	}
+
+	Backend::Shutdown();
+
+	if (options.output.empty())
+		WriteJson(std::cout, options, runs);
+	else
+	{
+		std::ofstream file(options.output);
+		WriteJson(file, options, runs);
+		if (!file)
+		{
+			std::cerr << "failed to write " << options.output << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
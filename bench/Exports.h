@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+// the raw controller functions as defined and exported by the dll (see exports.def),
+// the public header declares them as WindowsGamingInput::RawController
+namespace WindowsGamingInput::RawGameController
+{
+	bool IsInitialized();
+	size_t GetCount();
+	size_t GetControllers(RawController::Description* controllers, size_t count);
+	bool GetControllersIfChanged(uint64_t& version, RawController::Description* controllers, size_t& count);
+	bool GetController(std::wstring_view uid, RawController::Description& description);
+	bool GetButtonLabel(std::wstring_view uid, size_t button, ButtonLabel& label);
+	bool GetCapabilities(std::wstring_view uid, RawController::Capabilities& capabilities, ButtonLabel* labels, size_t label_count);
+
+	bool IsConnected(std::wstring_view uid);
+	bool GetState(std::wstring_view uid, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+	bool GetPackedState(std::wstring_view uid, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+	size_t GetAllStates(const std::wstring_view* uids, RawController::State* states, size_t count, uint64_t& connected);
+	bool SetProcessing(std::wstring_view uid, const AxisProcessing* axes, size_t count, uint64_t radial_sticks);
+	bool ToHostTime(std::wstring_view uid, uint64_t timestamp, uint64_t& host);
+	bool GetTimingStats(std::wstring_view uid, ReadingTimingStats& stats);
+
+	bool SetVibration(std::wstring_view uid, double vibration);
+	bool SubmitVibration(std::wstring_view uid, double vibration);
+	bool PlayEffect(std::wstring_view uid, const VibrationEffect& effect);
+	bool StopEffect(std::wstring_view uid);
+	bool IsVibrating(std::wstring_view uid);
+	bool HasVibration(std::wstring_view uid);
+
+	bool IsWireless(std::wstring_view uid, bool& wireless);
+	bool GetBatteryStatus(std::wstring_view uid, BatteryStatus& status, double& battery);
+
+	RawController::Handle Open(std::wstring_view uid);
+	bool GetButtonLabel(RawController::Handle handle, size_t button, ButtonLabel& label);
+	bool GetCapabilities(RawController::Handle handle, RawController::Capabilities& capabilities, ButtonLabel* labels, size_t label_count);
+
+	bool IsConnected(RawController::Handle handle);
+	bool GetState(RawController::Handle handle, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+	bool GetPackedState(RawController::Handle handle, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+	size_t GetAllStates(const RawController::Handle* handles, RawController::State* states, size_t count, uint64_t& connected);
+	bool SetProcessing(RawController::Handle handle, const AxisProcessing* axes, size_t count, uint64_t radial_sticks);
+	bool ToHostTime(RawController::Handle handle, uint64_t timestamp, uint64_t& host);
+	bool GetTimingStats(RawController::Handle handle, ReadingTimingStats& stats);
+
+	bool SetVibration(RawController::Handle handle, double vibration);
+	bool SubmitVibration(RawController::Handle handle, double vibration);
+	bool PlayEffect(RawController::Handle handle, const VibrationEffect& effect);
+	bool StopEffect(RawController::Handle handle);
+	bool IsVibrating(RawController::Handle handle);
+	bool HasVibration(RawController::Handle handle);
+
+	bool IsWireless(RawController::Handle handle, bool& wireless);
+	bool GetBatteryStatus(RawController::Handle handle, BatteryStatus& status, double& battery);
+}
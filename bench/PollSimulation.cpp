@@ -0,0 +1,160 @@
+﻿#include "../include/WindowsGamingInput.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// runs the gamepad poller against fake gamepads with mixed report rates, once polling every gamepad on every poll
+// and once with adaptive polling, and prints the reads, the picked up readings and their delay as json
+// usage: WinGamingInputPollSim [--rates 125,125,250,500,1000,1000,0,0] [--frequency 1000] [--seconds 5] [--output file]
+// a rate of 0 is a gamepad which never reports
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	struct Options
+	{
+		std::vector<uint32_t> rates{ 125, 125, 250, 500, 1000, 1000, 0, 0 };
+		uint32_t frequency = 1000; // StartPolling
+		uint32_t seconds = 5; // per mode
+		std::string output;
+	};
+
+	struct Run
+	{
+		std::string mode;
+		double seconds;
+		double expected; // reports the gamepads produced
+		PollingStats polling;
+	};
+
+	Run Simulate(const Options& options, bool adaptive)
+	{
+		auto backend = std::make_shared<Backend::FakeBackend>();
+		for (const auto rate : options.rates)
+			backend->AddGamepad(rate);
+
+		Backend::SetBackend(backend);
+		Gamepad::SetAdaptivePolling(adaptive);
+		ResetMetrics();
+
+		const auto start = std::chrono::steady_clock::now();
+		Gamepad::StartPolling(options.frequency);
+		std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+		Gamepad::StopPolling();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		Metrics metrics;
+		GetMetrics(metrics);
+		Backend::SetBackend(nullptr);
+
+		double expected = 0;
+		for (const auto rate : options.rates)
+			expected += rate * seconds;
+
+		return { adaptive ? "adaptive" : "fixed", seconds, expected, metrics.polling };
+	}
+
+	void WriteJson(std::ostream& out, const Options& options, const std::vector<Run>& runs)
+	{
+		std::string rates;
+		for (const auto rate : options.rates)
+			rates += (rates.empty() ? "" : ", ") + std::to_string(rate);
+
+		out.setf(std::ios::fixed);
+		out.precision(1);
+		out << "{\n";
+		out << "\t\"config\": { \"rates\": [" << rates << "], \"frequency\": " << options.frequency << ", \"seconds\": " << options.seconds << " },\n";
+		out << "\t\"runs\": [\n";
+		for (size_t i = 0; i < runs.size(); ++i)
+		{
+			const auto& run = runs[i];
+			const auto& delay = run.polling.delay;
+			out << "\t\t{ \"mode\": \"" << run.mode << "\", \"reads_per_second\": " << run.polling.reads / run.seconds
+				<< ", \"new_readings_per_second\": " << run.polling.new_readings / run.seconds
+				<< ", \"picked_up\": " << (run.expected > 0 ? run.polling.new_readings / run.expected : 0.0)
+				<< ", \"delay_mean_us\": " << delay.mean / 1000.0 << ", \"delay_p50_us\": " << delay.p50 / 1000.0
+				<< ", \"delay_p99_us\": " << delay.p99 / 1000.0 << ", \"delay_max_us\": " << delay.max / 1000.0
+				<< " }" << (i + 1 < runs.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n}\n";
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (!value)
+				return false;
+
+			++i;
+			if (arg == "--rates")
+			{
+				options.rates.clear();
+				std::stringstream stream(value);
+				std::string rate;
+				while (std::getline(stream, rate, ','))
+					options.rates.emplace_back((uint32_t)std::strtoul(rate.c_str(), nullptr, 10));
+
+				// one snapshot per polled slot
+				if (options.rates.empty() || options.rates.size() > 64)
+					return false;
+			}
+			else if (arg == "--frequency")
+				options.frequency = std::max<uint32_t>((uint32_t)std::strtoul(value, nullptr, 10), 1);
+			else if (arg == "--seconds")
+				options.seconds = std::max<uint32_t>((uint32_t)std::strtoul(value, nullptr, 10), 1);
+			else if (arg == "--output")
+				options.output = value;
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--rates 125,125,250,500,1000,1000,0,0] [--frequency 1000] [--seconds 5] [--output file]" << std::endl;
+		return 1;
+	}
+
+	std::vector<Run> runs;
+	for (const bool adaptive : { false, true })
+	{
+		std::cerr << "simulating " << (adaptive ? "adaptive" : "fixed") << " polling" << std::endl;
+		runs.emplace_back(Simulate(options, adaptive));
+	}
+
+	Backend::Shutdown();
+
+	if (options.output.empty())
+		WriteJson(std::cout, options, runs);
+	else
+	{
+		std::ofstream file(options.output);
+		WriteJson(file, options, runs);
+		if (!file)
+		{
+			std::cerr << "failed to write " << options.output << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include <vector>
 #include <variant>
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -14,6 +15,19 @@
 #endif
 
 #include <Windows.h>
+#else
+#include <type_traits>
+
+// same as the winnt.h macro, so the core and its tests can be built on other platforms
+#define DEFINE_ENUM_FLAG_OPERATORS(ENUMTYPE) \
+	inline constexpr ENUMTYPE operator|(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(((std::underlying_type_t<ENUMTYPE>)a) | ((std::underlying_type_t<ENUMTYPE>)b)); } \
+	inline ENUMTYPE& operator|=(ENUMTYPE& a, ENUMTYPE b) { return a = a | b; } \
+	inline constexpr ENUMTYPE operator&(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(((std::underlying_type_t<ENUMTYPE>)a) & ((std::underlying_type_t<ENUMTYPE>)b)); } \
+	inline ENUMTYPE& operator&=(ENUMTYPE& a, ENUMTYPE b) { return a = a & b; } \
+	inline constexpr ENUMTYPE operator~(ENUMTYPE a) { return ENUMTYPE(~((std::underlying_type_t<ENUMTYPE>)a)); } \
+	inline constexpr ENUMTYPE operator^(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(((std::underlying_type_t<ENUMTYPE>)a) ^ ((std::underlying_type_t<ENUMTYPE>)b)); } \
+	inline ENUMTYPE& operator^=(ENUMTYPE& a, ENUMTYPE b) { return a = a ^ b; }
+#endif
 
 #ifndef DLLEXPORT
 #define DLLEXPORT 
@@ -60,6 +74,119 @@ namespace WindowsGamingInput
 		double RightThumbstickY;
 	};
 
+	// GamepadState quantized to 16 bytes, four gamepads share a cache line
+	// the timestamp is a delta to one full timestamp passed along with the states, see PackGamepadState
+	struct PackedGamepadState
+	{
+		uint32_t Buttons : 18; // GamepadButtons
+		uint32_t TimestampDelta : 14; // µs before the full timestamp, saturates at kMaxPackedTimestampDelta
+		uint16_t LeftTrigger; // value * 65535
+		uint16_t RightTrigger;
+		int16_t LeftThumbstickX; // value * 32767, -32768 is never used
+		int16_t LeftThumbstickY;
+		int16_t RightThumbstickX;
+		int16_t RightThumbstickY;
+	};
+	static_assert(sizeof(PackedGamepadState) == 16);
+
+	constexpr uint32_t kMaxPackedTimestampDelta = (1u << 14) - 1;
+
+	// axes are clamped to their range and rounded to the nearest step, so unpacking gives back the reading to within
+	// 1 / 65534 for sticks and 1 / 131070 for triggers. packing an unpacked state again reproduces it exactly
+	// NaN packs as 0
+	inline PackedGamepadState PackGamepadState(const GamepadState& state, uint64_t timestamp)
+	{
+		const auto stick = [](double value) -> int16_t
+		{
+			if (!(value == value))
+				return 0;
+
+			value = value < -1.0 ? -1.0 : value > 1.0 ? 1.0 : value;
+			return (int16_t)(value * 32767.0 + (value < 0.0 ? -0.5 : 0.5)); // truncation rounds half away from zero
+		};
+		const auto trigger = [](double value) -> uint16_t
+		{
+			value = value > 0.0 ? (value < 1.0 ? value : 1.0) : 0.0;
+			return (uint16_t)(value * 65535.0 + 0.5);
+		};
+
+		PackedGamepadState packed;
+		packed.Buttons = (uint32_t)state.Buttons;
+		packed.TimestampDelta = timestamp <= state.Timestamp ? 0 : timestamp - state.Timestamp >= kMaxPackedTimestampDelta ? kMaxPackedTimestampDelta : (uint32_t)(timestamp - state.Timestamp);
+		packed.LeftTrigger = trigger(state.LeftTrigger);
+		packed.RightTrigger = trigger(state.RightTrigger);
+		packed.LeftThumbstickX = stick(state.LeftThumbstickX);
+		packed.LeftThumbstickY = stick(state.LeftThumbstickY);
+		packed.RightThumbstickX = stick(state.RightThumbstickX);
+		packed.RightThumbstickY = stick(state.RightThumbstickY);
+		return packed;
+	}
+
+	inline GamepadState UnpackGamepadState(const PackedGamepadState& packed, uint64_t timestamp)
+	{
+		GamepadState state;
+		state.Timestamp = timestamp - packed.TimestampDelta;
+		state.Buttons = (GamepadButtons)packed.Buttons;
+		state.LeftTrigger = packed.LeftTrigger / 65535.0;
+		state.RightTrigger = packed.RightTrigger / 65535.0;
+		state.LeftThumbstickX = packed.LeftThumbstickX / 32767.0;
+		state.LeftThumbstickY = packed.LeftThumbstickY / 32767.0;
+		state.RightThumbstickX = packed.RightThumbstickX / 32767.0;
+		state.RightThumbstickY = packed.RightThumbstickY / 32767.0;
+		return state;
+	}
+
+	enum class GamepadAxis : unsigned int
+	{
+		None = 0,
+		LeftTrigger = 0x1,
+		RightTrigger = 0x2,
+		LeftThumbstickX = 0x4,
+		LeftThumbstickY = 0x8,
+		RightThumbstickX = 0x10,
+		RightThumbstickY = 0x20,
+	};
+
+	DEFINE_ENUM_FLAG_OPERATORS(GamepadAxis)
+
+	// difference between two successive readings of one gamepad
+	struct GamepadChange
+	{
+		uint64_t Timestamp;
+		uint32_t Index;
+		uint32_t Generation;
+		GamepadButtons Buttons;
+		GamepadButtons ChangedButtons;
+		GamepadAxis ChangedAxes;
+		float Axes[6]; // current values in GamepadAxis bit order
+	};
+
+	// optional post-processing of one axis: calibration, deadzone and response curve, applied in that order
+	// gamepad values are in the units of the axis (sticks -1 .. 1, triggers 0 .. 1) and keep them after processing.
+	// raw axes read 0 .. 1 but get calibrated like a stick, min, center and max of -1, 0 and 1 stand for raw 0, 0.5 and 1.
+	// so the defaults leave every axis unchanged, and a raw throttle resting at 0 uses center = min = -1
+	struct AxisProcessing
+	{
+		// measured extremes and rest position, center == min for one-sided axes like triggers and throttles
+		double min = -1;
+		double center = 0;
+		double max = 1;
+		// fractions of the calibrated range, below deadzone the axis reads as centered, above saturation as fully deflected
+		double deadzone = 0;
+		double saturation = 1;
+		// between linear (0) and cubic (1): value * (1 - curve + curve * value²)
+		double curve = 0;
+		bool invert = false;
+	};
+
+	struct GamepadProcessing
+	{
+		AxisProcessing axes[6]; // GamepadAxis bit order
+		// deadzone on the combined x/y deflection instead of per axis, with the deadzone, saturation and curve of the x axis
+		bool radial_left_stick = true;
+		bool radial_right_stick = true;
+	};
+
 	// == ABI::Windows::Gaming::Input::GamepadVibration
 	struct Vibration
 	{
@@ -69,6 +196,26 @@ namespace WindowsGamingInput
 		double RightTrigger = 0;
 	};
 
+	// intensity over time of one vibration channel, times in ms
+	// ramps from 0 to level over attack, holds level for sustain and ramps back to 0 over decay
+	struct VibrationEnvelope
+	{
+		double level = 0;
+		uint32_t delay = 0; // before the first attack
+		uint32_t attack = 0;
+		uint32_t sustain = 0;
+		uint32_t decay = 0;
+		// pulse train: the envelope restarts every period (cut off if it is longer), 0 plays it once
+		uint32_t period = 0;
+		uint32_t count = 1; // pulses if period is set, 0 repeats until the effect gets stopped
+	};
+
+	// ends once all channels are done, the device is then turned off
+	struct VibrationEffect
+	{
+		VibrationEnvelope channels[4]; // Vibration member order, raw controllers only play the first
+	};
+
 	// == ABI::Windows::System::Power::BatteryStatus
 	enum class BatteryStatus
 	{
@@ -177,22 +324,293 @@ namespace WindowsGamingInput
 		ControllerRemoved,
 	};
 
+	enum class InitializeMode
+	{
+		Eager,
+		// raw controllers start with the first RawController call, their ControllerChanged events only from then on
+		LazyRawControllers,
+	};
+
+	// starts the backend from a background thread, the DLL calls it with Eager when it gets loaded.
+	// LazyRawControllers is opt-in for hosts starting the backend themselves (static linking with a backend factory).
+	// returns false if there is nothing left to start. an Eager call after a lazy start starts the raw controllers in the background
+	DLLEXPORT bool InitializeAsync(InitializeMode mode);
+	// waits until everything InitializeAsync started is ready, returns false on timeout (ms)
+	DLLEXPORT bool WaitForInitialization(uint32_t timeout);
+
+	struct InitializationStats
+	{
+		bool ready; // same as WaitForInitialization(0)
+		bool raw_controllers_deferred; // waiting for the first RawController call
+		// time the subsystems took to start, 0 if they didn't yet (ns)
+		uint64_t gamepads;
+		uint64_t raw_controllers;
+	};
+	DLLEXPORT void GetInitializationStats(InitializationStats& stats);
+
+	// callbacks are invoked in order from an internal dispatch thread. delivery is serial, so an event is delayed by the callbacks of
+	// every event queued before it which haven't returned yet, plus one wakeup; a slow callback delays all events behind it
+	// Add/RemoveControllerChanged block while callbacks run
 	using ControllerChanged_t = void (*)(EventType type, ControllerType controller, std::variant<size_t, std::wstring_view> uid);
 	DLLEXPORT void AddControllerChanged(ControllerChanged_t cb);
 	DLLEXPORT void RemoveControllerChanged(ControllerChanged_t cb);
 
+	struct ControllerChangedStats
+	{
+		uint64_t delivered;
+		uint64_t coalesced; // added and removed again before delivery
+		uint64_t last_latency; // ns from the hot-plug event to the callbacks
+		uint64_t max_latency; // ns
+	};
+	DLLEXPORT void GetControllerChangedStats(ControllerChangedStats& stats);
+
+	// IsWireless and GetBatteryStatus return cached values, which a background thread refreshes every interval ms (default 2000)
+	// 0 turns the cache off, every call then queries the device
+	DLLEXPORT void SetStatusRefreshInterval(uint32_t interval);
+
+	struct DeviceStatus
+	{
+		bool wireless; // false if unknown
+		bool has_battery; // false if GetBatteryStatus fails, battery_status and battery are then NotPresent and 0
+		BatteryStatus battery_status;
+		double battery;
+	};
+
+	// called from the refresh thread when the connection or battery status changes, or the battery level moves by 5% or more
+	using StatusChanged_t = void (*)(ControllerType controller, std::variant<size_t, std::wstring_view> uid, const DeviceStatus& status);
+	DLLEXPORT void AddStatusChanged(StatusChanged_t cb);
+	DLLEXPORT void RemoveStatusChanged(StatusChanged_t cb);
+
+	// writes every reading and hot-plug event into a compact binary file until StopRecording, to replay input bugs from user reports
+	DLLEXPORT bool StartRecording(std::wstring_view path);
+	DLLEXPORT void StopRecording();
+
+	// == the names in exports.def, indexes Metrics::calls
+	enum class EntryPoint : uint32_t
+	{
+		InitializeAsync,
+		WaitForInitialization,
+		GetInitializationStats,
+		AddControllerChanged,
+		RemoveControllerChanged,
+		GetControllerChangedStats,
+		SetStatusRefreshInterval,
+		AddStatusChanged,
+		RemoveStatusChanged,
+		StartRecording,
+		StopRecording,
+		GetMetrics,
+		ResetMetrics,
+		WaitForInput,
+		GetHostTime,
+
+		Gamepad_IsInitialized,
+		Gamepad_GetCount,
+		Gamepad_IsConnected,
+		Gamepad_GetGeneration,
+		Gamepad_IsWireless,
+		Gamepad_GetBatteryStatus,
+		Gamepad_GetState,
+		Gamepad_GetAllStates,
+		Gamepad_GetPackedState,
+		Gamepad_GetAllPackedStates,
+		Gamepad_GetVibration,
+		Gamepad_SetVibration,
+		Gamepad_SubmitVibration,
+		Gamepad_PlayEffect,
+		Gamepad_StopEffect,
+		Gamepad_SetProcessing,
+		Gamepad_StartPolling,
+		Gamepad_StopPolling,
+		Gamepad_SetAdaptivePolling,
+		Gamepad_EnableChangeEvents,
+		Gamepad_DisableChangeEvents,
+		Gamepad_PopChanges,
+		Gamepad_ToHostTime,
+		Gamepad_GetTimingStats,
+
+		RawGameController_IsInitialized,
+		RawGameController_GetCount,
+		RawGameController_GetControllers,
+		RawGameController_GetControllersIfChanged,
+		RawGameController_GetController,
+		RawGameController_GetButtonLabel,
+		RawGameController_GetCapabilities,
+		RawGameController_IsConnected,
+		RawGameController_IsWireless,
+		RawGameController_GetBatteryStatus,
+		RawGameController_SetProcessing,
+		RawGameController_GetState,
+		RawGameController_GetPackedState,
+		RawGameController_GetAllStates,
+		RawGameController_IsVibrating,
+		RawGameController_SetVibration,
+		RawGameController_SubmitVibration,
+		RawGameController_PlayEffect,
+		RawGameController_StopEffect,
+		RawGameController_HasVibration,
+		RawGameController_ToHostTime,
+		RawGameController_GetTimingStats,
+
+		RawGameController_Open,
+		RawGameController_GetButtonLabelByHandle,
+		RawGameController_GetCapabilitiesByHandle,
+		RawGameController_IsConnectedByHandle,
+		RawGameController_GetStateByHandle,
+		RawGameController_GetPackedStateByHandle,
+		RawGameController_GetAllStatesByHandle,
+		RawGameController_SetVibrationByHandle,
+		RawGameController_SubmitVibrationByHandle,
+		RawGameController_PlayEffectByHandle,
+		RawGameController_StopEffectByHandle,
+		RawGameController_IsVibratingByHandle,
+		RawGameController_HasVibrationByHandle,
+		RawGameController_IsWirelessByHandle,
+		RawGameController_GetBatteryStatusByHandle,
+		RawGameController_SetProcessingByHandle,
+		RawGameController_ToHostTimeByHandle,
+		RawGameController_GetTimingStatsByHandle,
+
+		SharedState_StartPublishing,
+		SharedState_StopPublishing,
+		SharedState_Open,
+		SharedState_Close,
+		SharedState_GetUpdateTime,
+		SharedState_GetGamepadState,
+		SharedState_GetRawControllers,
+		SharedState_GetRawControllerState,
+
+		Count
+	};
+
+	// all values in ns, percentiles are accurate to 12.5%
+	struct LatencyStats
+	{
+		uint64_t count;
+		uint64_t mean;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+		uint64_t max;
+	};
+
+	struct LockStats
+	{
+		uint64_t acquired;
+		uint64_t contended; // had to wait for another thread
+		uint64_t total_wait; // ns
+		uint64_t max_wait; // ns
+	};
+
+	// SubmitVibration requests and PlayEffect updates
+	struct VibrationQueueStats
+	{
+		uint64_t submitted;
+		uint64_t unchanged; // equal to the device's latest request, dropped right away
+		uint64_t replaced; // superseded by a newer request before it was applied
+		uint64_t applied;
+		uint64_t failed;
+		uint64_t effects; // started by PlayEffect
+	};
+
+	// gamepad poller reads, see Gamepad::SetAdaptivePolling
+	struct PollingStats
+	{
+		uint64_t reads;
+		uint64_t new_readings; // reads with a new timestamp
+		LatencyStats delay; // new reading to the read picking it up, relative to the smallest delay seen for the gamepad (ns)
+	};
+
+	// always collected, cumulative since load or the last ResetMetrics
+	struct Metrics
+	{
+		uint64_t calls[(size_t)EntryPoint::Count];
+
+		// time spent in the device calls (GetCurrentReading, haptics), polled reads are served from snapshots and not included
+		// readings are sampled, only one in 32 readings is timed and counted
+		LatencyStats gamepad_reading;
+		LatencyStats gamepad_vibration;
+		LatencyStats rcontroller_reading;
+		LatencyStats rcontroller_vibration;
+		VibrationQueueStats vibration_queue;
+		PollingStats polling;
+
+		uint64_t gamepads_added;
+		uint64_t gamepads_removed;
+		uint64_t rcontrollers_added;
+		uint64_t rcontrollers_removed;
+
+		LockStats gamepad_lock; // gamepad hot-plug
+		LockStats rcontroller_lock; // raw controller hot-plug
+		LockStats changes_lock; // PopChanges vs the poller
+		LockStats dispatch_lock; // ControllerChanged queue
+		LockStats callback_lock; // ControllerChanged callbacks
+	};
+	DLLEXPORT void GetMetrics(Metrics& metrics);
+	DLLEXPORT void ResetMetrics();
+
+	// timing of one device's readings, the timestamps are mapped to GetHostTime by the smallest difference seen between the two clocks.
+	// that offset includes the shortest delivery delay and assumes both clocks run at the same rate. ResetMetrics clears the stats
+	struct ReadingTimingStats
+	{
+		uint64_t interval; // learned report interval (us), 0 until two consecutive reports were seen
+		LatencyStats age; // mapped reading timestamp to the GetState returning it, sampled like the reading latency (ns)
+		LatencyStats jitter; // deviation of the report intervals from the learned interval (ns)
+		uint64_t stale; // sampled GetState calls whose reading was older than the interval, a newer report should have existed
+	};
+
+	// monotonic host clock (us) the reading timestamps get mapped to
+	DLLEXPORT uint64_t GetHostTime();
+
 	namespace Gamepad
 	{
 		DLLEXPORT bool IsInitialized();
 		DLLEXPORT size_t GetCount();
 		DLLEXPORT bool IsConnected(size_t index);
+		// changes whenever the slot gets a different gamepad assigned, 0 if no gamepad is connected at index
+		DLLEXPORT uint32_t GetGeneration(size_t index);
 		DLLEXPORT bool GetState(size_t index, GamepadState& state);
+		// fills states[i] for the first count slots (max 64), bit i of connected is set if states[i] is valid, the others are zeroed. returns the number of slots written
+		DLLEXPORT size_t GetAllStates(GamepadState* states, size_t count, uint64_t& connected);
+		// GetState packed, timestamp receives the reading's timestamp and TimestampDelta is 0
+		DLLEXPORT bool GetPackedState(size_t index, PackedGamepadState& state, uint64_t& timestamp);
+		// GetAllStates packed, timestamp receives the newest timestamp of the connected gamepads
+		// while polling all states are from the same poll
+		DLLEXPORT size_t GetAllPackedStates(PackedGamepadState* states, size_t count, uint64_t& timestamp, uint64_t& connected);
+
+		// reads all gamepads on a background thread with the given frequency (Hz), GetState then returns the last published reading
+		DLLEXPORT bool StartPolling(uint32_t frequency);
+		DLLEXPORT void StopPolling();
+		// while polling, reads each gamepad just after its next report is due instead of on every poll. the report interval
+		// is learned from the reading timestamps and gamepads without new readings are read exponentially less often, down to every 16 ms.
+		// gamepads reporting faster than the StartPolling frequency are read at that frequency
+		DLLEXPORT void SetAdaptivePolling(bool enabled);
+
+		// while polling, queues a GamepadChange for every reading that differs from the previous one (capacity changes are buffered, more get dropped)
+		DLLEXPORT bool EnableChangeEvents(size_t capacity);
+		DLLEXPORT void DisableChangeEvents();
+		// returns the number of queued changes written to changes, oldest first. only one thread may drain at a time
+		DLLEXPORT size_t PopChanges(GamepadChange* changes, size_t count);
 
 		DLLEXPORT bool SetVibration(size_t index, const Vibration& vibration);
+		// returns right away, a background thread applies the latest submitted vibration of each gamepad at most 250 times per second
+		// and skips values equal to the previous submission. SetVibration drops a pending submission
+		DLLEXPORT bool SubmitVibration(size_t index, const Vibration& vibration);
+		// plays effect on the same thread as SubmitVibration, replacing a playing effect. SetVibration and SubmitVibration stop it
+		DLLEXPORT bool PlayEffect(size_t index, const VibrationEffect& effect);
+		// turns the vibration off if an effect is playing
+		DLLEXPORT bool StopEffect(size_t index);
 		DLLEXPORT bool GetVibration(size_t index, Vibration& vibration);
 
+		// applies processing to all readings of the gamepad at index until it gets removed, nullptr turns it off
+		DLLEXPORT bool SetProcessing(size_t index, const GamepadProcessing* processing);
+
 		DLLEXPORT bool IsWireless(size_t index, bool& wireless);
 		DLLEXPORT bool GetBatteryStatus(size_t index, BatteryStatus& status, double& battery);
+
+		// converts a reading timestamp to GetHostTime, false until the gamepad delivered a reading
+		DLLEXPORT bool ToHostTime(size_t index, uint64_t timestamp, uint64_t& host);
+		DLLEXPORT bool GetTimingStats(size_t index, ReadingTimingStats& stats);
 	}
 	
 	namespace RawController
@@ -206,22 +624,132 @@ namespace WindowsGamingInput
 			size_t switches_count;
 			size_t axis_count;
 		};
+
+		// resolved once when the controller connects, see GetCapabilities
+		struct Capabilities
+		{
+			size_t button_count;
+			size_t switch_count;
+			size_t axis_count;
+			bool has_vibration;
+			bool wireless; // at connect time, IsWireless has the current value
+		};
+
+		// caller provided buffers for GetAllStates
+		struct State
+		{
+			bool* buttons;
+			size_t button_count;
+			SwitchPosition* switches;
+			size_t switch_count;
+			double* axis;
+			size_t axis_count;
+			uint64_t timestamp;
+		};
+		// refers to one connected controller, becomes stale once it gets removed (even if it reconnects later)
+		using Handle = uint64_t;
+		constexpr Handle kInvalidHandle = 0;
+
 		// <uid, display_name>
 		DLLEXPORT bool IsInitialized();
 		DLLEXPORT size_t GetCount();
 		DLLEXPORT size_t GetControllers(Description* controllers, size_t count);
+		// returns false if the list of controllers didn't change since version, otherwise behaves like GetControllers with count as in/out and updates version.
+		// if the list doesn't fit into count, nothing is copied, count receives the required size and version stays unchanged
+		DLLEXPORT bool GetControllersIfChanged(uint64_t& version, Description* controllers, size_t& count);
 		DLLEXPORT bool GetController(std::wstring_view uid, Description& description);
 		DLLEXPORT bool GetButtonLabel(std::wstring_view uid, size_t button, ButtonLabel& label);
+		// copies the labels of the first label_count buttons to labels (may be nullptr), all without calls to the device
+		DLLEXPORT bool GetCapabilities(std::wstring_view uid, Capabilities& capabilities, ButtonLabel* labels, size_t label_count);
 		
 		DLLEXPORT bool IsConnected(std::wstring_view uid);
 		DLLEXPORT bool GetState(std::wstring_view uid, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+		// buttons as a bitset, bit i of buttons[i / 64] is button i. word_count is the size of buttons, changed and previous.
+		// previous (may be nullptr) is owned by the caller, it holds the buttons of the caller's last call (zeroed initially) and receives the new ones.
+		// changed (may be nullptr) gets buttons ^ previous, so every reader with its own previous sees every edge
+		DLLEXPORT bool GetPackedState(std::wstring_view uid, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+		// reads the controllers uids[0..count) (max 64) into states, bit i of connected is set if states[i] is valid, the others get their arrays and timestamp zeroed.
+		// returns the number of entries processed
+		DLLEXPORT size_t GetAllStates(const std::wstring_view* uids, State* states, size_t count, uint64_t& connected);
 
 		DLLEXPORT bool SetVibration(std::wstring_view uid, double vibration);
+		// same as Gamepad::SubmitVibration
+		DLLEXPORT bool SubmitVibration(std::wstring_view uid, double vibration);
+		DLLEXPORT bool PlayEffect(std::wstring_view uid, const VibrationEffect& effect);
+		DLLEXPORT bool StopEffect(std::wstring_view uid);
 		DLLEXPORT bool IsVibrating(std::wstring_view uid);
 		DLLEXPORT bool HasVibration(std::wstring_view uid);
 
 		DLLEXPORT bool IsWireless(std::wstring_view uid, bool& wireless);
 		DLLEXPORT bool GetBatteryStatus(std::wstring_view uid, BatteryStatus& status, double& battery);
+
+		// applies axes[i] to axis i of all readings of the controller until it gets removed, count 0 turns it off
+		// bit k of radial_sticks makes axes 2k and 2k + 1 one stick with a radial deadzone (see GamepadProcessing)
+		DLLEXPORT bool SetProcessing(std::wstring_view uid, const AxisProcessing* axes, size_t count, uint64_t radial_sticks);
+
+		// same as Gamepad::ToHostTime
+		DLLEXPORT bool ToHostTime(std::wstring_view uid, uint64_t timestamp, uint64_t& host);
+		DLLEXPORT bool GetTimingStats(std::wstring_view uid, ReadingTimingStats& stats);
+
+		// handle based overloads, no string hashing per call. Open returns kInvalidHandle if the controller isn't connected
+		DLLEXPORT Handle Open(std::wstring_view uid);
+		DLLEXPORT bool GetButtonLabel(Handle handle, size_t button, ButtonLabel& label);
+		DLLEXPORT bool GetCapabilities(Handle handle, Capabilities& capabilities, ButtonLabel* labels, size_t label_count);
+
+		DLLEXPORT bool IsConnected(Handle handle);
+		DLLEXPORT bool GetState(Handle handle, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+		DLLEXPORT bool GetPackedState(Handle handle, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp);
+		DLLEXPORT size_t GetAllStates(const Handle* handles, State* states, size_t count, uint64_t& connected);
+
+		DLLEXPORT bool SetVibration(Handle handle, double vibration);
+		DLLEXPORT bool SubmitVibration(Handle handle, double vibration);
+		DLLEXPORT bool PlayEffect(Handle handle, const VibrationEffect& effect);
+		DLLEXPORT bool StopEffect(Handle handle);
+		DLLEXPORT bool IsVibrating(Handle handle);
+		DLLEXPORT bool HasVibration(Handle handle);
+
+		DLLEXPORT bool IsWireless(Handle handle, bool& wireless);
+		DLLEXPORT bool GetBatteryStatus(Handle handle, BatteryStatus& status, double& battery);
+		DLLEXPORT bool SetProcessing(Handle handle, const AxisProcessing* axes, size_t count, uint64_t radial_sticks);
+		DLLEXPORT bool ToHostTime(Handle handle, uint64_t timestamp, uint64_t& host);
+		DLLEXPORT bool GetTimingStats(Handle handle, ReadingTimingStats& stats);
+	}
+
+	enum class WaitResult
+	{
+		Input,
+		ControllerChanged,
+		Timeout,
+	};
+
+	// blocks until a gamepad in gamepads (bit i is index i) or one of controllers[0..count) has a reading with a new timestamp,
+	// a controller gets added or removed, or timeout (ms) passed. one shared background read of all waited on devices runs every 4 ms,
+	// gamepads come from the poller's snapshots instead while polling
+	DLLEXPORT WaitResult WaitForInput(uint64_t gamepads, const RawController::Handle* controllers, size_t count, uint32_t timeout);
+
+	// one process reads the devices and writes them to named shared memory, others map it read only and read the states
+	// without touching the devices. it holds 64 gamepads and 16 raw controllers with up to 256 buttons, 16 switches and 16 axes
+	namespace SharedState
+	{
+		struct View; // read only mapping of a published region
+
+		// writes all gamepads and raw controllers to the region name frequency (Hz) times per second from a background thread,
+		// the same states GetState returns. only one region per process, windows names may use the Local\ and Global\ prefixes
+		DLLEXPORT bool StartPublishing(std::wstring_view name, uint32_t frequency);
+		// removes the region, open views read every device as disconnected
+		DLLEXPORT void StopPublishing();
+
+		// nullptr if nothing is published under name or it was written by an incompatible version
+		DLLEXPORT const View* Open(std::wstring_view name);
+		DLLEXPORT void Close(const View* view);
+		// GetHostTime of the last publish, 0 once publishing stopped. stops changing if the publisher died
+		DLLEXPORT uint64_t GetUpdateTime(const View* view);
+		DLLEXPORT bool GetGamepadState(const View* view, size_t index, GamepadState& state);
+		// writes the published controllers and their handles (may be nullptr) in slot order, returns the number written
+		DLLEXPORT size_t GetRawControllers(const View* view, RawController::Description* controllers, RawController::Handle* handles, size_t count);
+		// fills state like RawController::GetAllStates, the handles are the publisher's from GetRawControllers. entries past the
+		// published counts or the limits above read as released, centered and 0
+		DLLEXPORT bool GetRawControllerState(const View* view, RawController::Handle handle, RawController::State& state);
 	}
 }
 
@@ -0,0 +1,142 @@
+﻿#include "AxisPipeline.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WGI_PIPELINE_SSE2
+#endif
+
+namespace WindowsGamingInput
+{
+	AxisPipeline::AxisPipeline(double center, double half_range)
+		: m_center_out(center), m_half_range(half_range) {}
+
+	void AxisPipeline::Add(const AxisProcessing& axis)
+	{
+		AddLane(axis, axis, false);
+	}
+
+	void AxisPipeline::AddStick(const AxisProcessing& x, const AxisProcessing& y)
+	{
+		if (GetLaneCount() % 2 != 0)
+			AddIdentity();
+
+		AddLane(x, x, true);
+		AddLane(y, x, true);
+	}
+
+	void AxisPipeline::AddIdentity()
+	{
+		m_center.emplace_back(0.0);
+		m_positive_scale.emplace_back(1.0);
+		m_negative_scale.emplace_back(1.0);
+		m_invert_scale.emplace_back(1.0);
+		m_invert_offset.emplace_back(0.0);
+		m_radial.emplace_back(0.0);
+		m_deadzone.emplace_back(0.0);
+		m_deadzone_scale.emplace_back(1.0);
+		m_curve_linear.emplace_back(1.0);
+		m_curve_cubic.emplace_back(0.0);
+		m_output_scale.emplace_back(1.0);
+		m_output_offset.emplace_back(0.0);
+	}
+
+	void AxisPipeline::AddLane(const AxisProcessing& axis, const AxisProcessing& deadzone, bool radial)
+	{
+		// calibrated value is (value - center) * scale of its side, in -1 .. 1 or 0 .. 1 for one-sided axes
+		const bool one_sided = axis.center <= axis.min;
+		m_center.emplace_back(axis.center);
+		m_positive_scale.emplace_back(axis.max > axis.center ? 1.0 / (axis.max - axis.center) : 0.0);
+		m_negative_scale.emplace_back(one_sided ? 0.0 : 1.0 / (axis.center - axis.min));
+
+		m_invert_scale.emplace_back(axis.invert ? -1.0 : 1.0);
+		m_invert_offset.emplace_back(axis.invert && one_sided ? 1.0 : 0.0);
+
+		// deflection d becomes (d - deadzone) * deadzone_scale clamped to 0 .. 1
+		const double inner = std::clamp(deadzone.deadzone, 0.0, 1.0);
+		const double outer = std::max(std::min(deadzone.saturation, 1.0), inner + 0.000001);
+		m_radial.emplace_back(radial ? 1.0 : 0.0);
+		m_deadzone.emplace_back(inner);
+		m_deadzone_scale.emplace_back(1.0 / (outer - inner));
+
+		const double curve = std::clamp(deadzone.curve, 0.0, 1.0);
+		m_curve_linear.emplace_back(1.0 - curve);
+		m_curve_cubic.emplace_back(curve);
+
+		m_output_scale.emplace_back(one_sided ? 1.0 : m_half_range);
+		m_output_offset.emplace_back(one_sided ? 0.0 : m_center_out);
+	}
+
+	void AxisPipeline::Process(double* values, size_t first, size_t count) const
+	{
+		count = std::min(count, GetLaneCount() - std::min(first, GetLaneCount()));
+		size_t i = 0;
+
+#ifdef WGI_PIPELINE_SSE2
+		const __m128d zero = _mm_setzero_pd();
+		const __m128d one = _mm_set1_pd(1.0);
+		const __m128d minus_one = _mm_set1_pd(-1.0);
+		for (; i + 2 <= count; i += 2)
+		{
+			const size_t lane = first + i;
+			const auto load = [lane](const std::vector<double>& table) { return _mm_loadu_pd(table.data() + lane); };
+
+			__m128d value = _mm_sub_pd(_mm_loadu_pd(values + i), load(m_center));
+			const __m128d positive = _mm_cmpge_pd(value, zero);
+			value = _mm_mul_pd(value, _mm_or_pd(_mm_and_pd(positive, load(m_positive_scale)), _mm_andnot_pd(positive, load(m_negative_scale))));
+			value = _mm_min_pd(_mm_max_pd(value, minus_one), one);
+			value = _mm_add_pd(_mm_mul_pd(value, load(m_invert_scale)), load(m_invert_offset));
+
+			// the lanes of a stick add the other axis to their deflection, shuffle swaps x and y
+			const __m128d squared = _mm_mul_pd(value, value);
+			const __m128d deflection = _mm_sqrt_pd(_mm_add_pd(squared, _mm_mul_pd(_mm_shuffle_pd(squared, squared, 1), load(m_radial))));
+
+			__m128d processed = _mm_mul_pd(_mm_sub_pd(deflection, load(m_deadzone)), load(m_deadzone_scale));
+			processed = _mm_min_pd(_mm_max_pd(processed, zero), one);
+			processed = _mm_mul_pd(processed, _mm_add_pd(load(m_curve_linear), _mm_mul_pd(load(m_curve_cubic), _mm_mul_pd(processed, processed))));
+
+			// scale the value by processed / deflection, the 0 / 0 of a centered axis is masked to 0
+			const __m128d factor = _mm_and_pd(_mm_cmpgt_pd(deflection, zero), _mm_div_pd(processed, deflection));
+			value = _mm_mul_pd(value, factor);
+			_mm_storeu_pd(values + i, _mm_add_pd(_mm_mul_pd(value, load(m_output_scale)), load(m_output_offset)));
+		}
+#endif
+
+		ProcessScalar(values + i, first + i, count - i);
+	}
+
+	void AxisPipeline::ProcessScalar(double* values, size_t first, size_t count) const
+	{
+		count = std::min(count, GetLaneCount() - std::min(first, GetLaneCount()));
+
+		// same steps as Process, a pair at a time so sticks see both axes
+		for (size_t i = 0; i < count; i += 2)
+		{
+			double calibrated[2]{};
+			const size_t pair = std::min<size_t>(2, count - i);
+			for (size_t j = 0; j < pair; ++j)
+			{
+				const size_t lane = first + i + j;
+				double value = values[i + j] - m_center[lane];
+				value *= value >= 0 ? m_positive_scale[lane] : m_negative_scale[lane];
+				value = std::clamp(value, -1.0, 1.0);
+				calibrated[j] = value * m_invert_scale[lane] + m_invert_offset[lane];
+			}
+
+			for (size_t j = 0; j < pair; ++j)
+			{
+				const size_t lane = first + i + j;
+				const double other = calibrated[1 - j];
+				const double deflection = std::sqrt(calibrated[j] * calibrated[j] + other * other * m_radial[lane]);
+
+				double processed = std::clamp((deflection - m_deadzone[lane]) * m_deadzone_scale[lane], 0.0, 1.0);
+				processed *= m_curve_linear[lane] + m_curve_cubic[lane] * processed * processed;
+
+				const double value = deflection > 0 ? calibrated[j] * (processed / deflection) : 0.0;
+				values[i + j] = value * m_output_scale[lane] + m_output_offset[lane];
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace WindowsGamingInput
+{
+	// AxisProcessing compiled into one table per parameter with a lane per axis, so Process is the same branch free
+	// arithmetic for every lane and handles two lanes per SSE2 register. sticks occupy an even/odd lane pair
+	class AxisPipeline
+	{
+	public:
+		// units of the added axes: a two-sided axis gets mapped back to center +- half_range,
+		// -1 .. 1 for gamepad sticks (0, 1) and 0 .. 1 for raw axes (0.5, 0.5)
+		AxisPipeline(double center, double half_range);
+
+		void Add(const AxisProcessing& axis);
+		// x and y of one stick sharing x's deadzone, the stick starts at an even lane
+		void AddStick(const AxisProcessing& x, const AxisProcessing& y);
+		// lane which leaves its values unchanged, for devices without processing in a shared pipeline
+		void AddIdentity();
+
+		size_t GetLaneCount() const { return m_center.size(); }
+
+		// values[i] is processed by lane first + i, first must be even
+		void Process(double* values, size_t first, size_t count) const;
+		// same result without SSE2, Process uses it for the lanes left over
+		void ProcessScalar(double* values, size_t first, size_t count) const;
+
+	private:
+		void AddLane(const AxisProcessing& axis, const AxisProcessing& deadzone, bool radial);
+
+		// per lane, see AddLane for how they are derived
+		std::vector<double> m_center;
+		std::vector<double> m_positive_scale;
+		std::vector<double> m_negative_scale;
+		std::vector<double> m_invert_scale;
+		std::vector<double> m_invert_offset;
+		std::vector<double> m_radial; // 1 if the lane is part of a stick, weight of the other axis in the deflection
+		std::vector<double> m_deadzone;
+		std::vector<double> m_deadzone_scale;
+		std::vector<double> m_curve_linear;
+		std::vector<double> m_curve_cubic;
+		std::vector<double> m_output_scale;
+		std::vector<double> m_output_offset;
+
+		double m_center_out;
+		double m_half_range;
+	};
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+#include <memory>
+#include <string>
+
+// everything the core needs from a platform input api, the DLL uses the WinRT backend
+namespace WindowsGamingInput::Backend
+{
+	// one connected gamepad, all methods may be called from any thread
+	class IGamepadDevice
+	{
+	public:
+		virtual ~IGamepadDevice() = default;
+
+		virtual bool GetReading(GamepadState& state) = 0;
+
+		virtual bool SetVibration(const Vibration& vibration) = 0;
+		virtual bool GetVibration(Vibration& vibration) = 0;
+
+		virtual bool IsWireless(bool& wireless) = 0;
+		virtual bool GetBatteryStatus(BatteryStatus& status, double& battery) = 0;
+	};
+
+	// one connected raw controller, all methods may be called from any thread
+	class IRawControllerDevice
+	{
+	public:
+		virtual ~IRawControllerDevice() = default;
+
+		// fills the caller provided buffers of state
+		virtual bool GetReading(RawController::State& state) = 0;
+		virtual bool GetButtonLabel(size_t button, ButtonLabel& label) = 0;
+
+		virtual bool HasVibration() = 0;
+		virtual bool SetVibration(double vibration) = 0;
+		virtual bool IsVibrating() = 0;
+
+		virtual bool IsWireless(bool& wireless) = 0;
+		virtual bool GetBatteryStatus(BatteryStatus& status, double& battery) = 0;
+	};
+
+	using GamepadDevicePtr = std::shared_ptr<IGamepadDevice>;
+	using RawControllerDevicePtr = std::shared_ptr<IRawControllerDevice>;
+
+	// implemented by the core, backends report hot-plug events through it from any thread
+	class IListener
+	{
+	public:
+		virtual ~IListener() = default;
+
+		// key identifies the gamepad until it gets removed again, adding a known key is ignored
+		virtual void OnGamepadAdded(const void* key, GamepadDevicePtr device) = 0;
+		virtual void OnGamepadRemoved(const void* key) = 0;
+
+		// adding a known uid is ignored
+		virtual void OnRawControllerAdded(const RawController::Description& description, RawControllerDevicePtr device) = 0;
+		virtual void OnRawControllerRemoved(std::wstring_view uid) = 0;
+	};
+
+	class IBackend
+	{
+	public:
+		virtual ~IBackend() = default;
+
+		// registers for hot-plug events and reports all connected devices, returns false if the api isn't available
+		virtual bool StartGamepads(IListener& listener) = 0;
+		virtual bool StartRawControllers(IListener& listener) = 0;
+
+		// the listener must not be called anymore once this returns
+		virtual void Stop() = 0;
+	};
+
+	// stops the current backend and drops all of its devices, then starts backend (may be nullptr)
+	// with defer_raw_controllers its raw controllers start with the first RawController call
+	void SetBackend(std::shared_ptr<IBackend> backend, bool defer_raw_controllers = false);
+
+	// creates the backend InitializeAsync starts, the DLL sets the WinRT one
+	using Factory_t = std::shared_ptr<IBackend> (*)();
+	void SetFactory(Factory_t factory);
+	// detaches all internal threads and drops the backend, for DLL_PROCESS_DETACH where threads can't be joined
+	void Shutdown();
+}
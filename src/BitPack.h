@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WGI_PACK_SSE2
+#endif
+
+// packs count bools (0 or 1 bytes, as written by GetCurrentReading) into words, bit i of words[i / 64] is values[i]
+// words must hold (count + 63) / 64 entries, unused high bits of the last word are cleared
+inline void PackBools(const bool* values, size_t count, uint64_t* words)
+{
+	static_assert(sizeof(bool) == 1);
+	const auto* bytes = reinterpret_cast<const uint8_t*>(values);
+
+	size_t i = 0;
+	for (; i + 64 <= count; i += 64)
+	{
+#ifdef WGI_PACK_SSE2
+		// shift bit 0 of every byte into the sign bit and collect 16 of them per movemask
+		uint64_t word = 0;
+		for (size_t j = 0; j < 64; j += 16)
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + j));
+			word |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_slli_epi64(chunk, 7)) << j;
+		}
+		words[i / 64] = word;
+#else
+		// multiplying 8 bytes of 0/1 by this constant gathers their low bits in the top byte
+		uint64_t word = 0;
+		for (size_t j = 0; j < 64; j += 8)
+		{
+			uint64_t chunk;
+			std::memcpy(&chunk, bytes + i + j, sizeof(chunk));
+			word |= ((chunk * 0x0102040810204080ull) >> 56) << j;
+		}
+		words[i / 64] = word;
+#endif
+	}
+
+	if (i < count)
+	{
+		uint64_t word = 0;
+		for (size_t j = 0; i + j < count; ++j)
+			word |= (uint64_t)(bytes[i + j] & 1) << j;
+
+		words[i / 64] = word;
+	}
+}
@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace WindowsGamingInput
+{
+	// maps the timestamps of one device to the host clock (GetHostTime) and times the readings handed out for it.
+	// the offset is the smallest host - device difference seen so far, so a mapped timestamp includes the shortest
+	// delivery delay and both clocks are assumed to run at the same rate. everything is relaxed atomics, any thread may call in
+	class ClockCorrelation
+	{
+	public:
+		// repeated readings can't improve the offset, this spares the device reads the clock read for them
+		bool IsNew(uint64_t timestamp) const
+		{
+			return timestamp != m_timestamp.load(std::memory_order_relaxed);
+		}
+
+		// after device reads returning a new reading, learns the offset and the report interval
+		void Sync(uint64_t timestamp, uint64_t now)
+		{
+			if (timestamp == 0)
+				return;
+
+			const int64_t offset = (int64_t)(now - timestamp);
+			int64_t current = m_offset.load(std::memory_order_relaxed);
+			while (offset < current && !m_offset.compare_exchange_weak(current, offset, std::memory_order_relaxed))
+				;
+
+			// concurrent readers may see the same or an older reading
+			const uint64_t previous = m_timestamp.exchange(timestamp, std::memory_order_relaxed);
+			if (previous == 0 || timestamp <= previous)
+				return;
+
+			const uint64_t interval = timestamp - previous;
+			const uint64_t learned = m_interval.load(std::memory_order_relaxed);
+			if (learned == 0 || interval < learned / 2)
+			{
+				m_interval.store(interval, std::memory_order_relaxed);
+				return;
+			}
+
+			// a gap means reports were missed or the device only reports changes, that's not jitter
+			if (interval > learned * 2)
+				return;
+
+			m_jitter.Record((interval > learned ? interval - learned : learned - interval) * 1000);
+			m_interval.store(learned + (int64_t)(interval - learned) / 8, std::memory_order_relaxed);
+		}
+
+		// for a sample of the readings returned by GetState, stale if a newer report should already exist
+		void Observe(uint64_t timestamp, uint64_t now)
+		{
+			const int64_t offset = m_offset.load(std::memory_order_relaxed);
+			if (timestamp == 0 || offset == kUnknown)
+				return;
+
+			const int64_t age = std::max<int64_t>((int64_t)(now - timestamp) - offset, 0);
+			m_age.Record((uint64_t)age * 1000);
+
+			const uint64_t interval = m_interval.load(std::memory_order_relaxed);
+			if (interval != 0 && (uint64_t)age > interval)
+				m_stale.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		bool ToHost(uint64_t timestamp, uint64_t& host) const
+		{
+			const int64_t offset = m_offset.load(std::memory_order_relaxed);
+			if (offset == kUnknown)
+				return false;
+
+			host = timestamp + offset;
+			return true;
+		}
+
+		void Get(ReadingTimingStats& stats) const
+		{
+			stats.interval = m_interval.load(std::memory_order_relaxed);
+			m_age.Get(stats.age);
+			m_jitter.Get(stats.jitter);
+			stats.stale = m_stale.load(std::memory_order_relaxed);
+		}
+
+		// the offset and the interval are kept, they describe the device and not the measurement
+		void ResetStats()
+		{
+			m_age.Reset();
+			m_jitter.Reset();
+			m_stale.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		static constexpr int64_t kUnknown = std::numeric_limits<int64_t>::max();
+
+		std::atomic_int64_t m_offset = kUnknown;
+		std::atomic_uint64_t m_timestamp = 0; // newest reading passed to Sync
+		std::atomic_uint64_t m_interval = 0; // learned report interval (us)
+		Instrumentation::LatencyHistogram m_age;
+		Instrumentation::LatencyHistogram m_jitter;
+		std::atomic_uint64_t m_stale = 0;
+	};
+}
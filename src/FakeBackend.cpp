@@ -0,0 +1,384 @@
+﻿#include "FakeBackend.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace WindowsGamingInput::Backend
+{
+	namespace
+	{
+		// microseconds like the WinRT reading timestamps
+		uint64_t GetTimestamp()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// number of readings generated at rate since start
+		uint64_t GetTick(std::chrono::steady_clock::time_point start, uint32_t rate)
+		{
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			return (uint64_t)elapsed * rate / 1000000000;
+		}
+
+		// -1 .. 1 .. -1 over 100 ticks
+		double Triangle(uint64_t tick)
+		{
+			const double phase = (double)(tick % 100) / 50.0;
+			return phase <= 1.0 ? phase * 2.0 - 1.0 : 3.0 - phase * 2.0;
+		}
+
+		struct Battery
+		{
+			bool wireless = false;
+			BatteryStatus status = BatteryStatus::NotPresent;
+			double battery = 0;
+		};
+	}
+
+	class FakeBackend::FakeGamepad : public IGamepadDevice
+	{
+	public:
+		FakeGamepad(uint32_t rate)
+			: m_rate(rate)
+		{
+			m_state.Store({ GetTimestamp() });
+		}
+
+		bool GetReading(GamepadState& state) override
+		{
+			state = m_state.Load();
+			if (m_rate == 0)
+				return true;
+
+			// toggle one button per tick and sweep the axes
+			const uint64_t tick = GetTick(m_start, m_rate);
+			state.Timestamp += tick * 1000000 / m_rate;
+			state.Buttons ^= (GamepadButtons)(1u << (tick % 18));
+			state.LeftTrigger = (double)(tick % 10) / 10.0;
+			state.RightTrigger = 1.0 - state.LeftTrigger;
+			state.LeftThumbstickX = Triangle(tick);
+			state.LeftThumbstickY = -state.LeftThumbstickX;
+			state.RightThumbstickX = Triangle(tick + 50);
+			state.RightThumbstickY = -state.RightThumbstickX;
+			return true;
+		}
+
+		bool SetVibration(const Vibration& vibration) override
+		{
+			std::scoped_lock lock(m_mutex);
+			m_vibration = vibration;
+			return true;
+		}
+
+		bool GetVibration(Vibration& vibration) override
+		{
+			std::scoped_lock lock(m_mutex);
+			vibration = m_vibration;
+			return true;
+		}
+
+		bool IsWireless(bool& wireless) override
+		{
+			std::scoped_lock lock(m_mutex);
+			wireless = m_battery.wireless;
+			return true;
+		}
+
+		bool GetBatteryStatus(BatteryStatus& status, double& battery) override
+		{
+			std::scoped_lock lock(m_mutex);
+			if (!m_battery.wireless)
+				return false;
+
+			status = m_battery.status;
+			battery = m_battery.battery;
+			return true;
+		}
+
+		// called with the backend mutex held, which serializes the SeqLock writers
+		void SetState(GamepadState state)
+		{
+			if (state.Timestamp == 0)
+				state.Timestamp = GetTimestamp();
+
+			m_state.Store(state);
+		}
+
+		void SetBattery(const Battery& battery)
+		{
+			std::scoped_lock lock(m_mutex);
+			m_battery = battery;
+		}
+
+	private:
+		const uint32_t m_rate;
+		const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+		SeqLock<GamepadState> m_state;
+
+		std::mutex m_mutex;
+		Vibration m_vibration{};
+		Battery m_battery{};
+	};
+
+	class FakeBackend::FakeRawController : public IRawControllerDevice
+	{
+	public:
+		FakeRawController(const WindowsGamingInput::RawController::Description& description, uint32_t rate)
+			: m_description(description), m_rate(rate),
+			m_buttons(description.button_count), m_switches(description.switches_count), m_axis(description.axis_count) {}
+
+		const WindowsGamingInput::RawController::Description& GetDescription() const { return m_description; }
+
+		bool GetReading(WindowsGamingInput::RawController::State& state) override
+		{
+			std::scoped_lock lock(m_mutex);
+			const size_t button_count = std::min(state.button_count, m_buttons.size());
+			const size_t switch_count = std::min(state.switch_count, m_switches.size());
+			const size_t axis_count = std::min(state.axis_count, m_axis.size());
+			std::copy_n(m_buttons.cbegin(), button_count, state.buttons);
+			std::copy_n(m_switches.cbegin(), switch_count, state.switches);
+			std::copy_n(m_axis.cbegin(), axis_count, state.axis);
+			state.timestamp = m_timestamp;
+			if (m_rate == 0)
+				return true;
+
+			// press one button per tick, rotate the switches and sweep the axes
+			const uint64_t tick = GetTick(m_start, m_rate);
+			state.timestamp += tick * 1000000 / m_rate;
+			if (button_count != 0)
+				state.buttons[tick % button_count] = !state.buttons[tick % button_count];
+
+			for (size_t i = 0; i < switch_count; ++i)
+				state.switches[i] = (SwitchPosition)((tick + i) % 9);
+
+			for (size_t i = 0; i < axis_count; ++i)
+				state.axis[i] = (Triangle(tick + i * 10) + 1.0) / 2.0; // raw axes are 0 .. 1
+
+			return true;
+		}
+
+		bool GetButtonLabel(size_t button, ButtonLabel& label) override
+		{
+			if (button >= m_buttons.size())
+				return false;
+
+			label = ButtonLabel::None;
+			return true;
+		}
+
+		bool HasVibration() override
+		{
+			return true;
+		}
+
+		bool SetVibration(double vibration) override
+		{
+			std::scoped_lock lock(m_mutex);
+			m_vibration = vibration;
+			return true;
+		}
+
+		bool IsVibrating() override
+		{
+			std::scoped_lock lock(m_mutex);
+			return m_vibration > 0.000001;
+		}
+
+		bool IsWireless(bool& wireless) override
+		{
+			std::scoped_lock lock(m_mutex);
+			wireless = m_battery.wireless;
+			return true;
+		}
+
+		bool GetBatteryStatus(BatteryStatus& status, double& battery) override
+		{
+			std::scoped_lock lock(m_mutex);
+			if (!m_battery.wireless)
+				return false;
+
+			status = m_battery.status;
+			battery = m_battery.battery;
+			return true;
+		}
+
+		void SetState(const bool* buttons, const SwitchPosition* switches, const double* axis, uint64_t timestamp)
+		{
+			std::scoped_lock lock(m_mutex);
+			std::copy_n(buttons, m_buttons.size(), m_buttons.begin());
+			std::copy_n(switches, m_switches.size(), m_switches.begin());
+			std::copy_n(axis, m_axis.size(), m_axis.begin());
+			m_timestamp = timestamp != 0 ? timestamp : GetTimestamp();
+		}
+
+		void SetBattery(const Battery& battery)
+		{
+			std::scoped_lock lock(m_mutex);
+			m_battery = battery;
+		}
+
+		double GetVibration()
+		{
+			std::scoped_lock lock(m_mutex);
+			return m_vibration;
+		}
+
+	private:
+		const WindowsGamingInput::RawController::Description m_description;
+		const uint32_t m_rate;
+		const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+		std::mutex m_mutex;
+		std::vector<bool> m_buttons;
+		std::vector<SwitchPosition> m_switches;
+		std::vector<double> m_axis;
+		uint64_t m_timestamp = GetTimestamp();
+		double m_vibration = 0;
+		Battery m_battery{};
+	};
+
+	bool FakeBackend::StartGamepads(IListener& listener)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_gamepad_listener = &listener;
+		for (const auto& [id, device] : m_devices)
+		{
+			if (device.gamepad)
+				listener.OnGamepadAdded(device.gamepad.get(), device.gamepad);
+		}
+
+		return true;
+	}
+
+	bool FakeBackend::StartRawControllers(IListener& listener)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_rcontroller_listener = &listener;
+		for (const auto& [id, device] : m_devices)
+		{
+			if (device.controller)
+				listener.OnRawControllerAdded(device.controller->GetDescription(), device.controller);
+		}
+
+		return true;
+	}
+
+	void FakeBackend::Stop()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_gamepad_listener = nullptr;
+		m_rcontroller_listener = nullptr;
+	}
+
+	FakeBackend::DeviceId FakeBackend::AddGamepad(uint32_t rate)
+	{
+		std::scoped_lock lock(m_mutex);
+		const DeviceId id = m_next_id++;
+		auto gamepad = std::make_shared<FakeGamepad>(rate);
+		m_devices.emplace(id, Device{ gamepad, nullptr });
+		if (m_gamepad_listener)
+			m_gamepad_listener->OnGamepadAdded(gamepad.get(), gamepad);
+
+		return id;
+	}
+
+	FakeBackend::DeviceId FakeBackend::AddRawController(std::wstring_view uid, std::wstring_view display_name, size_t button_count, size_t switch_count, size_t axis_count, uint32_t rate)
+	{
+		WindowsGamingInput::RawController::Description description{};
+		uid.copy(description.uid, std::size(description.uid) - 1);
+		display_name.copy(description.display_name, std::size(description.display_name) - 1);
+		description.button_count = button_count;
+		description.switches_count = switch_count;
+		description.axis_count = axis_count;
+
+		std::scoped_lock lock(m_mutex);
+		const DeviceId id = m_next_id++;
+		auto controller = std::make_shared<FakeRawController>(description, rate);
+		m_devices.emplace(id, Device{ nullptr, controller });
+		if (m_rcontroller_listener)
+			m_rcontroller_listener->OnRawControllerAdded(description, controller);
+
+		return id;
+	}
+
+	bool FakeBackend::Remove(DeviceId id)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(id);
+		if (it == m_devices.cend())
+			return false;
+
+		if (it->second.gamepad && m_gamepad_listener)
+			m_gamepad_listener->OnGamepadRemoved(it->second.gamepad.get());
+		else if (it->second.controller && m_rcontroller_listener)
+			m_rcontroller_listener->OnRawControllerRemoved(it->second.controller->GetDescription().uid);
+
+		m_devices.erase(it);
+		return true;
+	}
+
+	void FakeBackend::RemoveAll()
+	{
+		std::unique_lock lock(m_mutex);
+		while (!m_devices.empty())
+		{
+			const DeviceId id = m_devices.cbegin()->first;
+			lock.unlock();
+			Remove(id);
+			lock.lock();
+		}
+	}
+
+	bool FakeBackend::SetGamepadState(DeviceId id, const GamepadState& state)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(id);
+		if (it == m_devices.cend() || !it->second.gamepad)
+			return false;
+
+		it->second.gamepad->SetState(state);
+		return true;
+	}
+
+	bool FakeBackend::SetRawControllerState(DeviceId id, const bool* buttons, const SwitchPosition* switches, const double* axis, uint64_t timestamp)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(id);
+		if (it == m_devices.cend() || !it->second.controller)
+			return false;
+
+		it->second.controller->SetState(buttons, switches, axis, timestamp);
+		return true;
+	}
+
+	bool FakeBackend::SetBatteryStatus(DeviceId id, bool wireless, BatteryStatus status, double battery)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(id);
+		if (it == m_devices.cend())
+			return false;
+
+		const Battery value{ wireless, status, battery };
+		if (it->second.gamepad)
+			it->second.gamepad->SetBattery(value);
+		else
+			it->second.controller->SetBattery(value);
+
+		return true;
+	}
+
+	bool FakeBackend::GetVibration(DeviceId id, Vibration& vibration)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(id);
+		if (it == m_devices.cend())
+			return false;
+
+		if (it->second.gamepad)
+			return it->second.gamepad->GetVibration(vibration);
+
+		vibration = {};
+		vibration.LeftMotor = it->second.controller->GetVibration();
+		return true;
+	}
+}
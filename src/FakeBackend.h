@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include "Backend.h"
+#include "SeqLock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace WindowsGamingInput::Backend
+{
+	// scriptable in-process backend for tests and benchmarks, devices get plugged in and out by calling its methods
+	// with a rate > 0 a device produces a new reading rate times per second on top of the last set state,
+	// with a rate of 0 it only returns what got set
+	class FakeBackend : public IBackend
+	{
+	public:
+		using DeviceId = uint64_t;
+
+		bool StartGamepads(IListener& listener) override;
+		bool StartRawControllers(IListener& listener) override;
+		void Stop() override;
+
+		// devices added before Start* get reported once the backend is started
+		DeviceId AddGamepad(uint32_t rate = 0);
+		DeviceId AddRawController(std::wstring_view uid, std::wstring_view display_name, size_t button_count, size_t switch_count, size_t axis_count, uint32_t rate = 0);
+		bool Remove(DeviceId id);
+		void RemoveAll();
+
+		// a Timestamp of 0 gets replaced by the current time
+		bool SetGamepadState(DeviceId id, const GamepadState& state);
+		// buttons, switches and axis must hold as many values as the controller got added with, a timestamp of 0 gets replaced by the current time
+		bool SetRawControllerState(DeviceId id, const bool* buttons, const SwitchPosition* switches, const double* axis, uint64_t timestamp = 0);
+
+		bool SetBatteryStatus(DeviceId id, bool wireless, BatteryStatus status, double battery);
+		// last vibration set by the core, the raw controller value is returned in LeftMotor
+		bool GetVibration(DeviceId id, Vibration& vibration);
+
+	private:
+		class FakeGamepad;
+		class FakeRawController;
+
+		struct Device
+		{
+			std::shared_ptr<FakeGamepad> gamepad;
+			std::shared_ptr<FakeRawController> controller;
+		};
+
+		std::mutex m_mutex; // guards everything below, the listener gets called while holding it
+		std::map<DeviceId, Device> m_devices;
+		DeviceId m_next_id = 1;
+		IListener* m_gamepad_listener = nullptr;
+		IListener* m_rcontroller_listener = nullptr;
+	};
+}
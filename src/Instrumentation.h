@@ -0,0 +1,225 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// always-on counters behind GetMetrics, everything is relaxed atomics so recording never blocks a caller
+namespace WindowsGamingInput::Instrumentation
+{
+	inline uint64_t ElapsedNs(std::chrono::steady_clock::time_point start)
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	inline void UpdateMax(std::atomic_uint64_t& max, uint64_t value)
+	{
+		uint64_t current = max.load(std::memory_order_relaxed);
+		while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			;
+	}
+
+	// HDR style log-linear histogram of ns values: exact below 8, above that 8 buckets per power of two (<= 12.5% error)
+	class LatencyHistogram
+	{
+		static constexpr uint32_t kSubBits = 3;
+		static constexpr size_t kSubBuckets = 1 << kSubBits;
+		static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+	public:
+		void Record(uint64_t ns)
+		{
+			m_buckets[GetBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+			m_total.fetch_add(ns, std::memory_order_relaxed);
+			UpdateMax(m_max, ns);
+		}
+
+		void Get(LatencyStats& stats) const
+		{
+			uint64_t counts[kBuckets];
+			uint64_t count = 0;
+			for (size_t i = 0; i < kBuckets; ++i)
+			{
+				counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+				count += counts[i];
+			}
+
+			stats.count = count;
+			stats.mean = count ? m_total.load(std::memory_order_relaxed) / count : 0;
+			stats.max = m_max.load(std::memory_order_relaxed);
+
+			// upper bound of the bucket holding the percentile
+			const auto percentile = [&](uint64_t per_mille)
+			{
+				const uint64_t rank = (count * per_mille + 999) / 1000;
+				uint64_t seen = 0;
+				for (size_t i = 0; i < kBuckets; ++i)
+				{
+					seen += counts[i];
+					if (seen >= rank && seen > 0)
+						return std::min(GetUpperBound(i), stats.max);
+				}
+				return stats.max;
+			};
+
+			stats.p50 = percentile(500);
+			stats.p90 = percentile(900);
+			stats.p99 = percentile(990);
+		}
+
+		void Reset()
+		{
+			for (auto& bucket : m_buckets)
+				bucket.store(0, std::memory_order_relaxed);
+
+			m_total.store(0, std::memory_order_relaxed);
+			m_max.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		static size_t GetBucket(uint64_t ns)
+		{
+			if (ns < kSubBuckets)
+				return (size_t)ns;
+
+			const uint32_t msb = (uint32_t)std::bit_width(ns) - 1;
+			const size_t sub = (size_t)(ns >> (msb - kSubBits)) & (kSubBuckets - 1);
+			return (msb - kSubBits + 1) * kSubBuckets + sub;
+		}
+
+		static uint64_t GetUpperBound(size_t bucket)
+		{
+			if (bucket < kSubBuckets)
+				return bucket;
+
+			const uint32_t shift = (uint32_t)(bucket / kSubBuckets) - 1;
+			const uint64_t lower = (uint64_t)(kSubBuckets + bucket % kSubBuckets) << shift;
+			return lower + ((1ull << shift) - 1);
+		}
+
+		std::atomic_uint64_t m_buckets[kBuckets]{};
+		std::atomic_uint64_t m_total = 0;
+		std::atomic_uint64_t m_max = 0;
+	};
+
+	// one thread_local for both, every access costs a tls lookup in the dll
+	struct ThreadState
+	{
+		size_t shard;
+		uint32_t random; // xorshift32 state, never 0
+	};
+
+	inline ThreadState& GetThreadState()
+	{
+		static std::atomic_size_t next = 0;
+		thread_local ThreadState state = [] {
+			const size_t shard = next.fetch_add(1, std::memory_order_relaxed);
+			return ThreadState{ shard, (uint32_t)(shard * 2654435761u) | 1 };
+		}();
+		return state;
+	}
+
+	// true for one in kSampleInterval calls on average, for the hot paths where two clock reads per call would cost more than the call.
+	// random instead of every n-th call, so alternating calls to different devices don't alias with the interval
+	constexpr uint32_t kSampleInterval = 32;
+
+	inline bool ShouldSample()
+	{
+		uint32_t& x = GetThreadState().random;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return x % kSampleInterval == 0;
+	}
+
+	// per entry point call counts, sharded by thread so concurrent readers don't share a cache line
+	class CallCounters
+	{
+		static constexpr size_t kShards = 16;
+		static constexpr size_t kEntryPoints = (size_t)EntryPoint::Count;
+
+		struct alignas(64) Shard
+		{
+			std::atomic_uint64_t calls[kEntryPoints]{};
+		};
+
+	public:
+		void Count(EntryPoint entry)
+		{
+			m_shards[GetThreadState().shard % kShards].calls[(size_t)entry].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void Get(uint64_t (&calls)[kEntryPoints]) const
+		{
+			std::fill(std::begin(calls), std::end(calls), 0);
+			for (const auto& shard : m_shards)
+			{
+				for (size_t i = 0; i < kEntryPoints; ++i)
+					calls[i] += shard.calls[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		void Reset()
+		{
+			for (auto& shard : m_shards)
+			{
+				for (auto& calls : shard.calls)
+					calls.store(0, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		Shard m_shards[kShards];
+	};
+
+	// wait times of one mutex, the uncontended path only costs a try_lock and a counter
+	class LockMonitor
+	{
+	public:
+		template<typename Mutex>
+		std::unique_lock<Mutex> Lock(Mutex& mutex)
+		{
+			m_acquired.fetch_add(1, std::memory_order_relaxed);
+			std::unique_lock lock(mutex, std::try_to_lock);
+			if (!lock.owns_lock())
+			{
+				const auto start = std::chrono::steady_clock::now();
+				lock.lock();
+
+				const uint64_t wait = ElapsedNs(start);
+				m_contended.fetch_add(1, std::memory_order_relaxed);
+				m_total_wait.fetch_add(wait, std::memory_order_relaxed);
+				UpdateMax(m_max_wait, wait);
+			}
+
+			return lock;
+		}
+
+		void Get(LockStats& stats) const
+		{
+			stats.acquired = m_acquired.load(std::memory_order_relaxed);
+			stats.contended = m_contended.load(std::memory_order_relaxed);
+			stats.total_wait = m_total_wait.load(std::memory_order_relaxed);
+			stats.max_wait = m_max_wait.load(std::memory_order_relaxed);
+		}
+
+		void Reset()
+		{
+			m_acquired.store(0, std::memory_order_relaxed);
+			m_contended.store(0, std::memory_order_relaxed);
+			m_total_wait.store(0, std::memory_order_relaxed);
+			m_max_wait.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic_uint64_t m_acquired = 0;
+		std::atomic_uint64_t m_contended = 0;
+		std::atomic_uint64_t m_total_wait = 0;
+		std::atomic_uint64_t m_max_wait = 0;
+	};
+}
@@ -0,0 +1,102 @@
+﻿#include "PollScheduler.h"
+
+#include <algorithm>
+
+namespace WindowsGamingInput
+{
+	void PollScheduler::Update(size_t slot, uint64_t now, uint64_t timestamp)
+	{
+		m_reads.fetch_add(1, std::memory_order_relaxed);
+
+		auto& state = m_slots[slot];
+		state.active = true;
+		const uint64_t min_interval = m_min_interval.load(std::memory_order_relaxed);
+
+		// nothing new. right after the expected report the read was too early, so the margin grows and the read is retried
+		// after it. from one interval past the expected report on the gamepad idles or missed reports and gets backed off
+		if (timestamp == 0 || timestamp == state.timestamp)
+		{
+			if (state.expected != 0 && now < state.expected + state.interval)
+			{
+				state.margin = std::min(state.margin * 2, state.interval / 2);
+				state.due = now + state.margin;
+				return;
+			}
+
+			state.expected = 0;
+			state.idle = state.idle == 0 ? min_interval : std::min(state.idle * 2, kMaxIdleInterval);
+			state.due = now + state.idle;
+			return;
+		}
+
+		m_new_readings.fetch_add(1, std::memory_order_relaxed);
+		const int64_t offset = (int64_t)(now - timestamp);
+		state.offset = std::min(state.offset, offset);
+		m_delay.Record((uint64_t)(offset - state.offset) * 1000);
+
+		if (state.timestamp != 0 && timestamp > state.timestamp)
+		{
+			// a gap of several intervals is idle time or missed reports, not a slower rate
+			const uint64_t delta = timestamp - state.timestamp;
+			if (state.interval == 0 ? delta <= kMaxIdleInterval : delta < state.interval / 2)
+				state.interval = delta;
+			else if (delta <= state.interval * 2)
+				state.interval = (uint64_t)((int64_t)state.interval + ((int64_t)delta - (int64_t)state.interval) / 8);
+		}
+
+		// found on time, try a bit earlier next time. at least 1 µs, a 16th of a small margin rounds to 0
+		if (state.expected != 0)
+			state.margin = std::max(state.margin - std::max<uint64_t>(state.margin / 16, 1), kMinMargin);
+
+		state.timestamp = timestamp;
+		state.idle = 0;
+		state.expected = 0;
+
+		if (state.interval == 0)
+		{
+			state.due = now + min_interval;
+			return;
+		}
+
+		// reports faster than the poll rate are read at the poll rate, there is nothing to wait for
+		if (state.interval < min_interval)
+		{
+			state.due = now + min_interval;
+			return;
+		}
+
+		// the first expected report after now, in our clock
+		uint64_t expected = (uint64_t)((int64_t)timestamp + state.offset) + state.interval;
+		if (expected <= now)
+			expected += ((now - expected) / state.interval + 1) * state.interval;
+
+		state.expected = expected;
+		state.due = expected + state.margin;
+	}
+
+	uint64_t PollScheduler::NextDue(uint64_t now) const
+	{
+		uint64_t due = now + kMaxIdleInterval;
+		for (const auto& slot : m_slots)
+		{
+			if (slot.active)
+				due = std::min(due, slot.due);
+		}
+
+		return due;
+	}
+
+	void PollScheduler::GetStats(PollingStats& stats) const
+	{
+		stats.reads = m_reads.load(std::memory_order_relaxed);
+		stats.new_readings = m_new_readings.load(std::memory_order_relaxed);
+		m_delay.Get(stats.delay);
+	}
+
+	void PollScheduler::ResetStats()
+	{
+		m_reads.store(0, std::memory_order_relaxed);
+		m_new_readings.store(0, std::memory_order_relaxed);
+		m_delay.Reset();
+	}
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+#include "Instrumentation.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace WindowsGamingInput
+{
+	// decides when the gamepad poller reads each slot. learns every gamepad's report interval from its reading timestamps,
+	// reads it a learned margin after the next report is due and backs off exponentially while no new readings come in.
+	// the margin shrinks with every report found on time and doubles when a read comes too early, which then retries after it.
+	// all times are microseconds, now is the steady clock and timestamps are the device's clock. only the poller calls Update
+	class PollScheduler
+	{
+	public:
+		static constexpr size_t kMaxSlots = 64;
+		static constexpr uint64_t kMinMargin = 10;
+		static constexpr uint64_t kInitialMargin = 100;
+		static constexpr uint64_t kMaxIdleInterval = 16000;
+
+		// the poll interval, slots reporting faster are read at it
+		void SetMinInterval(uint64_t interval) { m_min_interval = interval; }
+
+		bool IsDue(size_t slot, uint64_t now) const { return m_slots[slot].due <= now; }
+		// forgets what was learned, for removed gamepads and new ones in the slot
+		void Reset(size_t slot) { m_slots[slot] = {}; }
+		// after every read, timestamp 0 if it failed
+		void Update(size_t slot, uint64_t now, uint64_t timestamp);
+		// earliest due time of all active slots, at most kMaxIdleInterval after now
+		uint64_t NextDue(uint64_t now) const;
+		// learned report interval (0 until known) and current read margin of a slot
+		uint64_t GetInterval(size_t slot) const { return m_slots[slot].interval; }
+		uint64_t GetMargin(size_t slot) const { return m_slots[slot].margin; }
+
+		void GetStats(PollingStats& stats) const;
+		void ResetStats();
+
+	private:
+		struct Slot
+		{
+			bool active = false;
+			uint64_t timestamp = 0; // of the last new reading
+			uint64_t interval = 0; // learned report interval, 0 until known
+			uint64_t idle = 0; // current back off, 0 while the reports come in
+			int64_t offset = INT64_MAX; // smallest now - timestamp seen, maps the device's clock to ours
+			uint64_t margin = kInitialMargin; // read this long after the expected report
+			uint64_t expected = 0; // our time of the report the next read waits for, 0 if none
+			uint64_t due = 0;
+		};
+
+		std::array<Slot, kMaxSlots> m_slots{};
+		std::atomic_uint64_t m_min_interval = 1000;
+
+		std::atomic_uint64_t m_reads = 0;
+		std::atomic_uint64_t m_new_readings = 0;
+		Instrumentation::LatencyHistogram m_delay;
+	};
+}
@@ -0,0 +1,279 @@
+﻿#include "Recorder.h"
+#include "RecordingFormat.h"
+
+#include <algorithm>
+
+namespace WindowsGamingInput
+{
+	using namespace Recording;
+
+	// flush to disk once this much is buffered, drop records above kMaxBuffered
+	constexpr size_t kFlushSize = 64 * 1024;
+	constexpr size_t kMaxBuffered = 16 * 1024 * 1024;
+	constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+	namespace
+	{
+		void WriteString(std::vector<uint8_t>& out, const wchar_t* str)
+		{
+			const size_t length = std::char_traits<wchar_t>::length(str);
+			WriteVarint(out, length);
+			for (size_t i = 0; i < length; ++i)
+				WriteVarint(out, (uint32_t)str[i]);
+		}
+	}
+
+	Recorder::~Recorder()
+	{
+		Stop();
+	}
+
+	bool Recorder::Start(const std::filesystem::path& path)
+	{
+		std::scoped_lock lock(m_mutex);
+		if (m_writer.joinable())
+			return false;
+
+		m_file.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_file)
+			return false;
+
+		m_file.write((const char*)kMagic, sizeof(kMagic));
+		m_file.put((char)kVersion);
+
+		m_buffer.clear();
+		m_buffer.reserve(kFlushSize * 2);
+		m_start = std::chrono::steady_clock::now();
+		m_last_time = 0;
+		m_gamepads.clear();
+		m_controllers.clear();
+		m_next_id = 0;
+		m_dropped = 0;
+
+		m_writer_stop = false;
+		m_writer = std::thread(&Recorder::WriterThread, this);
+		m_recording = true;
+		return true;
+	}
+
+	void Recorder::Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			if (!m_writer.joinable())
+				return;
+
+			m_recording = false;
+			m_writer_stop = true;
+			m_cv.notify_all();
+		}
+
+		m_writer.join(); // writes what's left
+		m_file.close();
+	}
+
+	void Recorder::Detach()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_recording = false;
+		m_writer_stop = true;
+		m_cv.notify_all();
+		if (m_writer.joinable())
+			m_writer.detach();
+	}
+
+	void Recorder::WriterThread()
+	{
+		std::vector<uint8_t> buffer;
+		buffer.reserve(kFlushSize * 2);
+
+		std::unique_lock lock(m_mutex);
+		while (true)
+		{
+			m_cv.wait_for(lock, kFlushInterval, [this] { return m_writer_stop || m_buffer.size() >= kFlushSize; });
+			const bool stop = m_writer_stop;
+
+			buffer.swap(m_buffer);
+			lock.unlock();
+
+			m_file.write((const char*)buffer.data(), (std::streamsize)buffer.size());
+			buffer.clear();
+			if (stop)
+			{
+				m_file.flush();
+				return;
+			}
+
+			lock.lock();
+		}
+	}
+
+	bool Recorder::BeginRecord(uint8_t type)
+	{
+		if (!m_recording || m_buffer.size() >= kMaxBuffered)
+		{
+			if (m_recording)
+				++m_dropped;
+
+			return false;
+		}
+
+		const uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+		m_buffer.emplace_back(type);
+		WriteVarint(m_buffer, time - m_last_time);
+		m_last_time = time;
+
+		if (m_buffer.size() >= kFlushSize)
+			m_cv.notify_one();
+
+		return true;
+	}
+
+	void Recorder::GamepadConnected(size_t index)
+	{
+		std::scoped_lock lock(m_mutex);
+		if (!BeginRecord((uint8_t)RecordType::GamepadConnected))
+			return;
+
+		WriteVarint(m_buffer, index);
+		m_gamepads[index] = {};
+	}
+
+	void Recorder::GamepadDisconnected(size_t index)
+	{
+		std::scoped_lock lock(m_mutex);
+		if (!BeginRecord((uint8_t)RecordType::GamepadDisconnected))
+			return;
+
+		WriteVarint(m_buffer, index);
+		m_gamepads.erase(index);
+	}
+
+	void Recorder::GamepadReading(size_t index, const GamepadState& state)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_gamepads.find(index);
+		if (it == m_gamepads.end() || it->second.Timestamp == state.Timestamp)
+			return;
+
+		if (!BeginRecord((uint8_t)RecordType::GamepadReading))
+			return;
+
+		auto& previous = it->second;
+		uint8_t changed = previous.Buttons != state.Buttons ? 1 : 0;
+		for (size_t i = 0; i < std::size(kGamepadAxes); ++i)
+		{
+			if (previous.*kGamepadAxes[i] != state.*kGamepadAxes[i])
+				changed |= 1 << (i + 1);
+		}
+
+		WriteVarint(m_buffer, index);
+		WriteSigned(m_buffer, (int64_t)(state.Timestamp - previous.Timestamp));
+		m_buffer.emplace_back(changed);
+		if (changed & 1)
+			WriteVarint(m_buffer, (uint32_t)state.Buttons);
+
+		for (size_t i = 0; i < std::size(kGamepadAxes); ++i)
+		{
+			if (changed & (1 << (i + 1)))
+				WriteDouble(m_buffer, state.*kGamepadAxes[i]);
+		}
+
+		previous = state;
+	}
+
+	void Recorder::RawControllerConnected(RawController::Handle handle, const RawController::Description& description)
+	{
+		std::scoped_lock lock(m_mutex);
+		if (!BeginRecord((uint8_t)RecordType::RawControllerConnected))
+			return;
+
+		const uint32_t id = m_next_id++;
+		WriteVarint(m_buffer, id);
+		WriteVarint(m_buffer, description.button_count);
+		WriteVarint(m_buffer, description.switches_count);
+		WriteVarint(m_buffer, description.axis_count);
+		WriteString(m_buffer, description.uid);
+		WriteString(m_buffer, description.display_name);
+		m_controllers.insert_or_assign(handle, RawDevice{ id });
+	}
+
+	void Recorder::RawControllerDisconnected(RawController::Handle handle)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_controllers.find(handle);
+		if (it == m_controllers.end() || !BeginRecord((uint8_t)RecordType::RawControllerDisconnected))
+			return;
+
+		WriteVarint(m_buffer, it->second.id);
+		m_controllers.erase(it);
+	}
+
+	void Recorder::RawControllerReading(RawController::Handle handle, const RawController::State& state)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_controllers.find(handle);
+		if (it == m_controllers.end() || it->second.timestamp == state.timestamp)
+			return;
+
+		if (!BeginRecord((uint8_t)RecordType::RawControllerReading))
+			return;
+
+		auto& previous = it->second;
+		// a different buffer size than last time is diffed against a zeroed reading
+		if (previous.buttons.size() != state.button_count || previous.switches.size() != state.switch_count || previous.axis.size() != state.axis_count)
+		{
+			previous.buttons.assign(state.button_count, false);
+			previous.switches.assign(state.switch_count, SwitchPosition::Center);
+			previous.axis.assign(state.axis_count, 0.0);
+		}
+
+		uint8_t changed = 0;
+		if (!std::equal(previous.buttons.cbegin(), previous.buttons.cend(), state.buttons))
+			changed |= 1;
+		if (!std::equal(previous.switches.cbegin(), previous.switches.cend(), state.switches))
+			changed |= 2;
+
+		WriteVarint(m_buffer, previous.id);
+		WriteSigned(m_buffer, (int64_t)(state.timestamp - previous.timestamp));
+		WriteVarint(m_buffer, state.button_count);
+		WriteVarint(m_buffer, state.switch_count);
+		WriteVarint(m_buffer, state.axis_count);
+		m_buffer.emplace_back(changed);
+
+		if (changed & 1)
+		{
+			for (size_t i = 0; i < state.button_count; i += 8)
+			{
+				uint8_t bits = 0;
+				for (size_t j = i; j < std::min(i + 8, state.button_count); ++j)
+					bits |= (state.buttons[j] ? 1 : 0) << (j - i);
+
+				m_buffer.emplace_back(bits);
+			}
+			std::copy_n(state.buttons, state.button_count, previous.buttons.begin());
+		}
+
+		if (changed & 2)
+		{
+			for (size_t i = 0; i < state.switch_count; ++i)
+				m_buffer.emplace_back((uint8_t)state.switches[i]);
+
+			std::copy_n(state.switches, state.switch_count, previous.switches.begin());
+		}
+
+		const size_t mask_offset = m_buffer.size();
+		m_buffer.resize(mask_offset + (state.axis_count + 7) / 8);
+		for (size_t i = 0; i < state.axis_count; ++i)
+		{
+			if (previous.axis[i] == state.axis[i])
+				continue;
+
+			m_buffer[mask_offset + i / 8] |= 1 << (i % 8);
+			WriteDouble(m_buffer, state.axis[i]);
+			previous.axis[i] = state.axis[i];
+		}
+
+		previous.timestamp = state.timestamp;
+	}
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WindowsGamingInput
+{
+	// appends readings and hot-plug events to a recording (see RecordingFormat.h)
+	// records are encoded into a memory buffer on the calling thread and written to disk by a background thread,
+	// readings with an unchanged timestamp are skipped
+	class Recorder
+	{
+	public:
+		~Recorder();
+
+		bool Start(const std::filesystem::path& path);
+		void Stop();
+		// stops recording without joining the writer, for DLL_PROCESS_DETACH
+		void Detach();
+
+		// cheap check for the callers to skip building a record
+		bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+		// records which didn't fit into the buffer because the disk couldn't keep up
+		uint64_t GetDropped() const { return m_dropped; }
+
+		void GamepadConnected(size_t index);
+		void GamepadDisconnected(size_t index);
+		void GamepadReading(size_t index, const GamepadState& state);
+
+		void RawControllerConnected(RawController::Handle handle, const RawController::Description& description);
+		void RawControllerDisconnected(RawController::Handle handle);
+		void RawControllerReading(RawController::Handle handle, const RawController::State& state);
+
+	private:
+		struct RawDevice
+		{
+			uint32_t id;
+			uint64_t timestamp = 0;
+			std::vector<bool> buttons;
+			std::vector<SwitchPosition> switches;
+			std::vector<double> axis;
+		};
+
+		// expects m_mutex to be held, returns false if the record has to be dropped
+		bool BeginRecord(uint8_t type);
+		void WriterThread();
+
+		std::atomic_bool m_recording = false;
+		std::atomic_uint64_t m_dropped = 0;
+
+		std::mutex m_mutex; // guards everything below
+		std::condition_variable m_cv;
+		std::vector<uint8_t> m_buffer;
+		std::chrono::steady_clock::time_point m_start;
+		uint64_t m_last_time = 0; // µs since m_start
+		std::unordered_map<size_t, GamepadState> m_gamepads; // slot -> last recorded reading
+		std::unordered_map<RawController::Handle, RawDevice> m_controllers;
+		uint32_t m_next_id = 0;
+
+		std::thread m_writer;
+		bool m_writer_stop = false;
+		std::ofstream m_file; // only touched by the writer while it runs
+	};
+}
@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// file layout shared by the Recorder and the ReplayBackend
+// header: kMagic, kVersion
+// every record: uint8 RecordType, varint µs since the previous record, payload as documented on RecordType
+// integers are LEB128 varints (signed ones zigzag encoded), doubles are stored as their 8 raw bytes
+// readings are delta encoded against the previous reading of the same device, which starts out zeroed on connect
+namespace WindowsGamingInput::Recording
+{
+	constexpr uint8_t kMagic[4] = { 'W', 'G', 'I', 'R' };
+	constexpr uint8_t kVersion = 1;
+
+	// upper bounds for the counts and string lengths in a file, larger values mark it as corrupt
+	constexpr size_t kMaxInputCount = 4096; // buttons, switches or axes of one raw controller
+	constexpr size_t kMaxStringLength = 1024;
+
+	enum class RecordType : uint8_t
+	{
+		GamepadConnected = 1, // varint slot
+		GamepadDisconnected = 2, // varint slot
+		// varint slot, svarint Timestamp delta, uint8 changed (bit 0 buttons, bit 1 + i axis i of kGamepadAxes),
+		// varint Buttons if changed, double per changed axis
+		GamepadReading = 3,
+		// varint id, varint button/switch/axis count, varint length + chars of uid and display_name
+		RawControllerConnected = 4,
+		RawControllerDisconnected = 5, // varint id
+		// varint id, svarint timestamp delta, varint button/switch/axis count, uint8 changed (bit 0 buttons, bit 1 switches),
+		// packed button bits if changed, one byte per switch if changed, bitmask of changed axes, double per changed axis
+		RawControllerReading = 6,
+	};
+
+	// GamepadAxis bit order
+	constexpr double GamepadState::* kGamepadAxes[] = {
+		&GamepadState::LeftTrigger, &GamepadState::RightTrigger,
+		&GamepadState::LeftThumbstickX, &GamepadState::LeftThumbstickY,
+		&GamepadState::RightThumbstickX, &GamepadState::RightThumbstickY,
+	};
+
+	inline void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.emplace_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.emplace_back((uint8_t)value);
+	}
+
+	inline void WriteSigned(std::vector<uint8_t>& out, int64_t value)
+	{
+		WriteVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+
+	inline void WriteDouble(std::vector<uint8_t>& out, double value)
+	{
+		uint8_t bytes[sizeof(double)];
+		std::memcpy(bytes, &value, sizeof(double));
+		out.insert(out.end(), std::begin(bytes), std::end(bytes));
+	}
+
+	// bounds checked cursor over a recording, every read after the end fails and returns 0
+	class Reader
+	{
+	public:
+		Reader(const uint8_t* data, size_t size)
+			: m_data(data), m_end(data + size) {}
+
+		bool IsEnd() const { return m_data == m_end; }
+		bool HasError() const { return m_error; }
+		size_t GetRemaining() const { return (size_t)(m_end - m_data); }
+
+		// fails if fewer than bytes are left, for payloads whose size follows from counts read before
+		bool Require(size_t bytes)
+		{
+			if (GetRemaining() < bytes)
+				m_error = true;
+			return !m_error;
+		}
+
+		// a count or length which has to be at most max, fails and returns 0 otherwise
+		size_t ReadCount(size_t max)
+		{
+			const uint64_t value = ReadVarint();
+			if (value > max)
+			{
+				m_error = true;
+				return 0;
+			}
+			return (size_t)value;
+		}
+
+		uint8_t ReadByte()
+		{
+			if (m_data == m_end)
+			{
+				m_error = true;
+				return 0;
+			}
+			return *m_data++;
+		}
+
+		uint64_t ReadVarint()
+		{
+			uint64_t value = 0;
+			for (uint32_t shift = 0; shift < 64; shift += 7)
+			{
+				const uint8_t byte = ReadByte();
+				value |= (uint64_t)(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					return value;
+			}
+
+			m_error = true;
+			return 0;
+		}
+
+		int64_t ReadSigned()
+		{
+			const uint64_t value = ReadVarint();
+			return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+		}
+
+		double ReadDouble()
+		{
+			double value = 0;
+			if ((size_t)(m_end - m_data) < sizeof(double))
+			{
+				m_error = true;
+				m_data = m_end;
+				return value;
+			}
+
+			std::memcpy(&value, m_data, sizeof(double));
+			m_data += sizeof(double);
+			return value;
+		}
+
+	private:
+		const uint8_t* m_data;
+		const uint8_t* m_end;
+		bool m_error = false;
+	};
+}
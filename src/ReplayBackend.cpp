@@ -0,0 +1,371 @@
+﻿#include "ReplayBackend.h"
+
+#include <algorithm>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WindowsGamingInput::Backend
+{
+	using namespace Recording;
+
+	// read only view of a whole file
+	struct ReplayBackend::Mapping
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+
+		bool Open(const std::filesystem::path& path)
+		{
+			file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER file_size{};
+			if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+				return false;
+
+			mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping)
+				return false;
+
+			data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			size = (size_t)file_size.QuadPart;
+			return data != nullptr;
+		}
+
+		~Mapping()
+		{
+			if (data)
+				UnmapViewOfFile(data);
+			if (mapping)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+		}
+#else
+		int fd = -1;
+
+		bool Open(const std::filesystem::path& path)
+		{
+			fd = open(path.c_str(), O_RDONLY);
+			if (fd == -1)
+				return false;
+
+			struct stat info{};
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+				return false;
+
+			void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view == MAP_FAILED)
+				return false;
+
+			madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+			data = (const uint8_t*)view;
+			size = (size_t)info.st_size;
+			return true;
+		}
+
+		~Mapping()
+		{
+			if (data)
+				munmap((void*)data, size);
+			if (fd != -1)
+				close(fd);
+		}
+#endif
+	};
+
+	namespace
+	{
+		std::wstring ReadString(Reader& reader)
+		{
+			// every char takes at least one byte
+			const size_t length = reader.ReadCount(kMaxStringLength);
+			if (!reader.Require(length))
+				return {};
+
+			std::wstring result(length, L'\0');
+			for (auto& c : result)
+			{
+				c = (wchar_t)reader.ReadVarint();
+				if (reader.HasError())
+					return {};
+			}
+			return result;
+		}
+	}
+
+	ReplayBackend::ReplayBackend(std::unique_ptr<Mapping> mapping)
+		: m_mapping(std::move(mapping)), m_reader(m_mapping->data + sizeof(kMagic) + 1, m_mapping->size - sizeof(kMagic) - 1)
+	{
+		ReadHeader();
+	}
+
+	ReplayBackend::~ReplayBackend()
+	{
+		Pause();
+	}
+
+	std::shared_ptr<ReplayBackend> ReplayBackend::Open(const std::filesystem::path& path)
+	{
+		auto mapping = std::make_unique<Mapping>();
+		if (!mapping->Open(path))
+			return nullptr;
+
+		if (mapping->size < sizeof(kMagic) + 1 || std::memcmp(mapping->data, kMagic, sizeof(kMagic)) != 0 || mapping->data[sizeof(kMagic)] != kVersion)
+			return nullptr;
+
+		return std::shared_ptr<ReplayBackend>(new ReplayBackend(std::move(mapping)));
+	}
+
+	void ReplayBackend::Stop()
+	{
+		Pause();
+		FakeBackend::Stop();
+	}
+
+	uint64_t ReplayBackend::GetTime()
+	{
+		std::scoped_lock lock(m_replay_mutex);
+		return m_time;
+	}
+
+	bool ReplayBackend::IsFinished()
+	{
+		std::scoped_lock lock(m_replay_mutex);
+		return !m_has_next;
+	}
+
+	bool ReplayBackend::AdvanceTo(uint64_t time)
+	{
+		std::scoped_lock lock(m_replay_mutex);
+		while (m_has_next && m_next_time <= time)
+		{
+			m_time = m_next_time;
+			ApplyRecord();
+			ReadHeader();
+		}
+
+		return m_has_next;
+	}
+
+	void ReplayBackend::Play(double speed)
+	{
+		Pause();
+
+		std::scoped_lock lock(m_playback_mutex);
+		m_playback_stop = false;
+		m_playback = std::thread(&ReplayBackend::PlaybackThread, this, speed);
+	}
+
+	void ReplayBackend::Pause()
+	{
+		{
+			std::scoped_lock lock(m_playback_mutex);
+			if (!m_playback.joinable())
+				return;
+
+			m_playback_stop = true;
+			m_playback_cv.notify_all();
+		}
+
+		m_playback.join();
+	}
+
+	void ReplayBackend::PlaybackThread(double speed)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t start_time = GetTime();
+
+		while (true)
+		{
+			uint64_t next;
+			{
+				std::scoped_lock lock(m_replay_mutex);
+				if (!m_has_next)
+					return;
+
+				next = m_next_time;
+			}
+
+			std::unique_lock lock(m_playback_mutex);
+			if (speed > 0)
+			{
+				const auto due = start + std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::micro>((double)(next - start_time) / speed));
+				if (m_playback_cv.wait_until(lock, due, [this] { return m_playback_stop; }))
+					return;
+			}
+			else if (m_playback_stop)
+				return;
+
+			lock.unlock();
+			AdvanceTo(next);
+		}
+	}
+
+	bool ReplayBackend::ReadHeader()
+	{
+		m_has_next = false;
+		if (m_reader.IsEnd())
+			return false;
+
+		m_next_type = (RecordType)m_reader.ReadByte();
+		m_next_time = m_time + m_reader.ReadVarint();
+		m_has_next = !m_reader.HasError();
+		return m_has_next;
+	}
+
+	void ReplayBackend::ApplyRecord()
+	{
+		switch (m_next_type)
+		{
+		case RecordType::GamepadConnected:
+		{
+			const size_t slot = m_reader.ReadVarint();
+			if (!m_reader.HasError())
+				m_gamepads.insert_or_assign(slot, ReplayGamepad{ AddGamepad() });
+			break;
+		}
+		case RecordType::GamepadDisconnected:
+		{
+			const auto it = m_gamepads.find(m_reader.ReadVarint());
+			if (it != m_gamepads.end() && !m_reader.HasError())
+			{
+				Remove(it->second.id);
+				m_gamepads.erase(it);
+			}
+			break;
+		}
+		case RecordType::GamepadReading:
+			ApplyGamepadReading();
+			break;
+		case RecordType::RawControllerConnected:
+		{
+			const uint32_t id = (uint32_t)m_reader.ReadVarint();
+			const size_t button_count = m_reader.ReadCount(kMaxInputCount);
+			const size_t switch_count = m_reader.ReadCount(kMaxInputCount);
+			const size_t axis_count = m_reader.ReadCount(kMaxInputCount);
+			const auto uid = ReadString(m_reader);
+			const auto display_name = ReadString(m_reader);
+			if (m_reader.HasError())
+				break;
+
+			ReplayRawController controller{ AddRawController(uid, display_name, button_count, switch_count, axis_count) };
+			controller.device_button_count = button_count;
+			controller.device_buttons = std::make_unique<bool[]>(button_count);
+			controller.device_switches.resize(switch_count);
+			controller.device_axis.resize(axis_count);
+			m_controllers.insert_or_assign(id, std::move(controller));
+			break;
+		}
+		case RecordType::RawControllerDisconnected:
+		{
+			const auto it = m_controllers.find((uint32_t)m_reader.ReadVarint());
+			if (it != m_controllers.end() && !m_reader.HasError())
+			{
+				Remove(it->second.id);
+				m_controllers.erase(it);
+			}
+			break;
+		}
+		case RecordType::RawControllerReading:
+			ApplyRawControllerReading();
+			break;
+		}
+
+		// can't resync after a truncated or unknown record
+		if (m_reader.HasError() || m_next_type < RecordType::GamepadConnected || m_next_type > RecordType::RawControllerReading)
+			m_reader = Reader(nullptr, 0);
+	}
+
+	void ReplayBackend::ApplyGamepadReading()
+	{
+		const auto it = m_gamepads.find(m_reader.ReadVarint());
+		GamepadState unknown{};
+		auto& state = it != m_gamepads.end() ? it->second.state : unknown;
+
+		state.Timestamp += m_reader.ReadSigned();
+		const uint8_t changed = m_reader.ReadByte();
+		if (changed & 1)
+			state.Buttons = (GamepadButtons)m_reader.ReadVarint();
+
+		for (size_t i = 0; i < std::size(kGamepadAxes); ++i)
+		{
+			if (changed & (1 << (i + 1)))
+				state.*kGamepadAxes[i] = m_reader.ReadDouble();
+		}
+
+		if (it != m_gamepads.end() && !m_reader.HasError())
+			SetGamepadState(it->second.id, state);
+	}
+
+	void ReplayBackend::ApplyRawControllerReading()
+	{
+		const auto it = m_controllers.find((uint32_t)m_reader.ReadVarint());
+		ReplayRawController unknown{};
+		auto& controller = it != m_controllers.end() ? it->second : unknown;
+
+		controller.timestamp += m_reader.ReadSigned();
+		const size_t button_count = m_reader.ReadCount(kMaxInputCount);
+		const size_t switch_count = m_reader.ReadCount(kMaxInputCount);
+		const size_t axis_count = m_reader.ReadCount(kMaxInputCount);
+		const uint8_t changed = m_reader.ReadByte();
+
+		// the payload has to be in the file before the buffers get resized for it
+		const size_t payload = ((changed & 1) ? (button_count + 7) / 8 : 0) + ((changed & 2) ? switch_count : 0) + (axis_count + 7) / 8;
+		if (m_reader.HasError() || !m_reader.Require(payload))
+			return;
+
+		// same as the recorder, a different buffer size starts from a zeroed reading
+		if (controller.buttons.size() != button_count || controller.switches.size() != switch_count || controller.axis.size() != axis_count)
+		{
+			controller.buttons.assign(button_count, false);
+			controller.switches.assign(switch_count, SwitchPosition::Center);
+			controller.axis.assign(axis_count, 0.0);
+		}
+
+		if (changed & 1)
+		{
+			for (size_t i = 0; i < button_count; i += 8)
+			{
+				const uint8_t bits = m_reader.ReadByte();
+				for (size_t j = i; j < std::min(i + 8, button_count); ++j)
+					controller.buttons[j] = (bits >> (j - i)) & 1;
+			}
+		}
+
+		if (changed & 2)
+		{
+			for (auto& position : controller.switches)
+				position = (SwitchPosition)m_reader.ReadByte();
+		}
+
+		std::vector<uint8_t> axis_mask((axis_count + 7) / 8);
+		for (auto& bits : axis_mask)
+			bits = m_reader.ReadByte();
+
+		for (size_t i = 0; i < axis_count; ++i)
+		{
+			if (axis_mask[i / 8] & (1 << (i % 8)))
+				controller.axis[i] = m_reader.ReadDouble();
+		}
+
+		if (it == m_controllers.end() || m_reader.HasError())
+			return;
+
+		std::copy_n(controller.buttons.cbegin(), std::min(button_count, controller.device_button_count), controller.device_buttons.get());
+		std::copy_n(controller.switches.cbegin(), std::min(switch_count, controller.device_switches.size()), controller.device_switches.begin());
+		std::copy_n(controller.axis.cbegin(), std::min(axis_count, controller.device_axis.size()), controller.device_axis.begin());
+		SetRawControllerState(controller.id, controller.device_buttons.get(), controller.device_switches.data(), controller.device_axis.data(), controller.timestamp);
+	}
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "FakeBackend.h"
+#include "RecordingFormat.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace WindowsGamingInput::Backend
+{
+	// plays a recording of the Recorder back through the fake devices
+	// the file is memory mapped and decoded incrementally, either driven by the caller with AdvanceTo or by Play
+	class ReplayBackend : public FakeBackend
+	{
+	public:
+		~ReplayBackend() override;
+
+		// returns nullptr if path can't be mapped or isn't a recording
+		static std::shared_ptr<ReplayBackend> Open(const std::filesystem::path& path);
+
+		// also pauses the playback
+		void Stop() override;
+
+		// µs since the start of the recording of the last applied record
+		uint64_t GetTime();
+		bool IsFinished();
+
+		// applies all records up to time, returns false once the end of the recording has been reached
+		bool AdvanceTo(uint64_t time);
+
+		// replays on a background thread with the recorded timing scaled by speed (2 = twice as fast),
+		// a speed of 0 applies the records as fast as possible
+		void Play(double speed);
+		void Pause();
+
+	private:
+		struct Mapping;
+
+		struct ReplayGamepad
+		{
+			DeviceId id;
+			GamepadState state{};
+		};
+
+		struct ReplayRawController
+		{
+			DeviceId id;
+			uint64_t timestamp = 0;
+			// as recorded, sized by the reader's buffers
+			std::vector<bool> buttons;
+			std::vector<SwitchPosition> switches;
+			std::vector<double> axis;
+			// as passed to the device, sized by its description
+			size_t device_button_count = 0;
+			std::unique_ptr<bool[]> device_buttons;
+			std::vector<SwitchPosition> device_switches;
+			std::vector<double> device_axis;
+		};
+
+		ReplayBackend(std::unique_ptr<Mapping> mapping);
+
+		// expects m_replay_mutex to be held
+		bool ReadHeader();
+		void ApplyRecord();
+		void ApplyGamepadReading();
+		void ApplyRawControllerReading();
+
+		void PlaybackThread(double speed);
+
+		std::unique_ptr<Mapping> m_mapping;
+
+		std::mutex m_replay_mutex; // guards the decoder state below
+		Recording::Reader m_reader;
+		uint64_t m_time = 0;
+		bool m_has_next = false;
+		Recording::RecordType m_next_type{};
+		uint64_t m_next_time = 0;
+		std::unordered_map<size_t, ReplayGamepad> m_gamepads; // recorded slot -> device
+		std::unordered_map<uint32_t, ReplayRawController> m_controllers; // recorded id -> device
+
+		std::mutex m_playback_mutex;
+		std::condition_variable m_playback_cv;
+		std::thread m_playback;
+		bool m_playback_stop = false;
+	};
+}
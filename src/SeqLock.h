@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// single writer, multiple reader sequence lock
+// the value is stored as relaxed atomic words so readers never touch torn data without noticing it
+template<typename T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+	// must only be called from one thread at a time
+	void Store(const T& value)
+	{
+		uint64_t words[kWords]{};
+		std::memcpy(words, &value, sizeof(T));
+
+		const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed); // odd -> write in progress
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < kWords; ++i)
+			m_words[i].store(words[i], std::memory_order_relaxed);
+
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// returns false if a write was in progress or happened while reading
+	bool TryLoad(T& value) const
+	{
+		const uint32_t before = m_sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			return false;
+
+		uint64_t words[kWords];
+		for (size_t i = 0; i < kWords; ++i)
+			words[i] = m_words[i].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_sequence.load(std::memory_order_relaxed) != before)
+			return false;
+
+		std::memcpy(&value, words, sizeof(T));
+		return true;
+	}
+
+	T Load() const
+	{
+		T value;
+		while (!TryLoad(value))
+			std::this_thread::yield(); // writer got preempted mid-store
+
+		return value;
+	}
+
+private:
+	std::atomic<uint32_t> m_sequence = 0;
+	std::atomic<uint64_t> m_words[kWords]{};
+};
@@ -0,0 +1,212 @@
+﻿#include "SharedState.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WindowsGamingInput::SharedState
+{
+#ifdef _WIN32
+	Region::~Region()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+	}
+
+	std::unique_ptr<Region> Region::Create(std::wstring_view name, size_t size)
+	{
+		std::unique_ptr<Region> region(new Region());
+		const std::wstring path(name);
+		region->m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, path.c_str());
+		if (!region->m_mapping || GetLastError() == ERROR_ALREADY_EXISTS)
+			return nullptr;
+
+		region->m_data = MapViewOfFile(region->m_mapping, FILE_MAP_WRITE, 0, 0, size);
+		if (!region->m_data)
+			return nullptr;
+
+		region->m_size = size;
+		return region;
+	}
+
+	std::unique_ptr<Region> Region::Open(std::wstring_view name, size_t size)
+	{
+		std::unique_ptr<Region> region(new Region());
+		const std::wstring path(name);
+		region->m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, path.c_str());
+		if (!region->m_mapping)
+			return nullptr;
+
+		// the view fails if the mapping is smaller than size
+		region->m_data = MapViewOfFile(region->m_mapping, FILE_MAP_READ, 0, 0, size);
+		if (!region->m_data)
+			return nullptr;
+
+		region->m_size = size;
+		return region;
+	}
+#else
+	namespace
+	{
+		std::string GetShmName(std::wstring_view name)
+		{
+			const std::string path = std::filesystem::path(name).string();
+			return path.starts_with('/') ? path : '/' + path;
+		}
+	}
+
+	Region::~Region()
+	{
+		if (m_data)
+			munmap(m_data, m_size);
+		// unlinked before the lock goes away with the fd, so nobody takes over a region that is being removed
+		if (!m_name.empty())
+			shm_unlink(m_name.c_str());
+		if (m_fd != -1)
+			close(m_fd);
+	}
+
+	std::unique_ptr<Region> Region::Create(std::wstring_view name, size_t size)
+	{
+		constexpr size_t kRetries = 4;
+
+		std::unique_ptr<Region> region(new Region());
+		const std::string shm_name = GetShmName(name);
+		for (size_t i = 0; i < kRetries && region->m_fd == -1; ++i)
+		{
+			region->m_fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+			if (region->m_fd != -1)
+			{
+				// held until the fd is closed, which the kernel also does if this process dies. waits out a
+				// concurrent Create that found the region still empty
+				flock(region->m_fd, LOCK_EX);
+				break;
+			}
+
+			if (errno != EEXIST)
+				return nullptr;
+
+			// the name is taken. if nobody holds the lock its publisher died and left it behind, then it is taken over
+			const int fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+			if (fd == -1)
+			{
+				if (errno == ENOENT) // removed in the meantime
+					continue;
+				return nullptr;
+			}
+
+			struct stat info{};
+			if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &info) != 0)
+			{
+				close(fd);
+				return nullptr;
+			}
+
+			// unlinked by its owner since it was opened, try the name again
+			if (info.st_nlink == 0)
+			{
+				close(fd);
+				continue;
+			}
+
+			// still empty, another Create made it and is about to lock it
+			if (info.st_size == 0)
+			{
+				close(fd);
+				return nullptr;
+			}
+
+			region->m_fd = fd;
+		}
+
+		if (region->m_fd == -1)
+			return nullptr;
+
+		region->m_name = shm_name;
+		if (ftruncate(region->m_fd, (off_t)size) != 0)
+			return nullptr;
+
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, region->m_fd, 0);
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		region->m_data = data;
+		region->m_size = size;
+		return region;
+	}
+
+	std::unique_ptr<Region> Region::Open(std::wstring_view name, size_t size)
+	{
+		std::unique_ptr<Region> region(new Region());
+		region->m_fd = shm_open(GetShmName(name).c_str(), O_RDONLY, 0);
+		if (region->m_fd == -1)
+			return nullptr;
+
+		struct stat info{};
+		if (fstat(region->m_fd, &info) != 0 || (size_t)info.st_size < size)
+			return nullptr;
+
+		void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, region->m_fd, 0);
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		region->m_data = data;
+		region->m_size = size;
+		return region;
+	}
+#endif
+
+	void ToUtf16(const wchar_t* str, char16_t (&out)[kMaxString])
+	{
+		size_t length = 0;
+		for (; *str; ++str)
+		{
+			const uint32_t c = (uint32_t)*str;
+			if (sizeof(wchar_t) > 2 && c > 0xFFFF)
+			{
+				if (length + 2 >= kMaxString)
+					break;
+
+				out[length++] = (char16_t)(0xD800 + ((c - 0x10000) >> 10));
+				out[length++] = (char16_t)(0xDC00 + ((c - 0x10000) & 0x3FF));
+				continue;
+			}
+
+			if (length + 1 >= kMaxString)
+				break;
+
+			out[length++] = (char16_t)c;
+		}
+
+		std::fill(out + length, std::end(out), u'\0');
+	}
+
+	void FromUtf16(const char16_t (&str)[kMaxString], wchar_t* out, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		size_t length = 0;
+		for (size_t i = 0; i < kMaxString && str[i] && length + 1 < size; ++i)
+		{
+			uint32_t c = str[i];
+			if (sizeof(wchar_t) > 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < kMaxString && str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000)
+				c = 0x10000 + ((c - 0xD800) << 10) + (str[++i] - 0xDC00);
+
+			out[length++] = (wchar_t)c;
+		}
+
+		out[length] = L'\0';
+	}
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+#include "SeqLock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// layout of the named shared memory written by StartPublishing and mapped read only by SharedState::Open
+// a header followed by one seqlock per slot, slot i of the gamepads is gamepad index i and slot i of the raw controllers
+// holds the controller whose handle has slot i. strings are utf-16 so the layout doesn't depend on the size of wchar_t
+namespace WindowsGamingInput::SharedState
+{
+	constexpr uint32_t kMagic = 0x53494757; // "WGIS"
+	constexpr uint32_t kVersion = 1;
+
+	constexpr size_t kGamepadSlots = 64;
+	constexpr size_t kRawControllerSlots = 16;
+	constexpr size_t kMaxButtons = 256; // the rest is cut off
+	constexpr size_t kMaxSwitches = 16;
+	constexpr size_t kMaxAxes = 16;
+	constexpr size_t kMaxString = 256;
+
+	struct GamepadSlot
+	{
+		GamepadState state;
+		uint32_t generation; // 0 if no gamepad is connected
+	};
+
+	// written when a controller connects
+	struct RawControllerInfo
+	{
+		RawController::Handle handle; // kInvalidHandle if the slot is free
+		uint32_t button_count;
+		uint32_t switch_count;
+		uint32_t axis_count;
+		char16_t uid[kMaxString];
+		char16_t display_name[kMaxString];
+	};
+
+	struct RawControllerSlot
+	{
+		RawController::Handle handle; // kInvalidHandle if the slot is free or the controller couldn't be read
+		uint64_t timestamp;
+		uint64_t buttons[kMaxButtons / 64]; // bit i of buttons[i / 64] is button i
+		uint8_t switches[kMaxSwitches];
+		double axis[kMaxAxes];
+	};
+
+	struct Layout
+	{
+		std::atomic_uint32_t magic; // stored last, readers only see initialized regions
+		uint32_t version;
+		uint64_t size; // sizeof(Layout) of the publisher
+		std::atomic_uint64_t update_time; // GetHostTime of the last publish, 0 once the publisher stopped
+
+		SeqLock<GamepadSlot> gamepads[kGamepadSlots];
+		SeqLock<RawControllerInfo> rcontroller_infos[kRawControllerSlots];
+		SeqLock<RawControllerSlot> rcontrollers[kRawControllerSlots];
+	};
+
+	// a named shared memory region, created read-write by the publisher or opened read only by the readers.
+	// names are used as is on windows (Local\ or Global\ prefixes apply) and get a leading / for posix shm elsewhere
+	class Region
+	{
+	public:
+		~Region();
+
+		// fails if another process already publishes under name. on posix the creator holds an flock on the region until it
+		// is destroyed or the process dies, a region nobody holds the lock of was left behind by a dead publisher and is reused
+		static std::unique_ptr<Region> Create(std::wstring_view name, size_t size);
+		// fails if the region is smaller than size
+		static std::unique_ptr<Region> Open(std::wstring_view name, size_t size);
+
+		void* GetData() const { return m_data; }
+
+	private:
+		Region() = default;
+
+		void* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		HANDLE m_mapping = nullptr;
+#else
+		int m_fd = -1;
+		std::string m_name; // set if this process created the region and unlinks it
+#endif
+	};
+
+	// behind the SharedState::View handed out by SharedState::Open
+	struct View
+	{
+		std::unique_ptr<Region> region;
+		const Layout* layout;
+	};
+
+	// a seqlock written by another process may stay odd forever if the publisher dies mid-store, so readers give up after a few tries
+	template<typename T>
+	bool LoadSlot(const SeqLock<T>& slot, T& value)
+	{
+		constexpr size_t kRetries = 64;
+		for (size_t i = 0; i < kRetries; ++i)
+		{
+			if (slot.TryLoad(value))
+				return true;
+
+			std::this_thread::yield();
+		}
+		return false;
+	}
+
+	// code unit wise on windows, surrogate pairs for wchar_t > 0xFFFF elsewhere. always null terminated, cut off at kMaxString - 1
+	void ToUtf16(const wchar_t* str, char16_t (&out)[kMaxString]);
+	void FromUtf16(const char16_t (&str)[kMaxString], wchar_t* out, size_t size);
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// hands out reusable slot indices in O(log n), always the lowest free one so player slots stay where they were before
+// the generation of a slot is odd while it's allocated and gets increased on every allocate and release,
+// so a (index, generation) pair identifies one specific use of a slot
+class SlotAllocator
+{
+public:
+	size_t Allocate()
+	{
+		size_t index;
+		if (m_free.empty())
+		{
+			index = m_generations.size();
+			m_generations.emplace_back(0);
+		}
+		else
+		{
+			index = m_free.top();
+			m_free.pop();
+		}
+
+		++m_generations[index];
+		assert(IsAllocated(index));
+		return index;
+	}
+
+	void Release(size_t index)
+	{
+		assert(IsAllocated(index));
+		++m_generations[index];
+		m_free.push(index);
+	}
+
+	bool IsAllocated(size_t index) const
+	{
+		return index < m_generations.size() && (m_generations[index] & 1) != 0;
+	}
+
+	uint32_t GetGeneration(size_t index) const
+	{
+		return index < m_generations.size() ? m_generations[index] : 0;
+	}
+
+	// number of slots ever handed out, allocated or not
+	size_t GetCapacity() const
+	{
+		return m_generations.size();
+	}
+
+	void Clear()
+	{
+		m_generations.clear();
+		m_free = {};
+	}
+
+private:
+	std::vector<uint32_t> m_generations;
+	std::priority_queue<size_t, std::vector<size_t>, std::greater<>> m_free; // min-heap
+};
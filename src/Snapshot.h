@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// RCU style publication of an immutable T: writers replace the whole value, readers never lock
+// every reader thread caches the last value it has seen and only touches the shared_ptr again after a publish,
+// so the common read path is a single load of the version counter
+template<typename T>
+class Snapshot
+{
+public:
+	Snapshot()
+		: m_value(std::make_shared<const T>()) {}
+
+	// writers must be serialized by the caller
+	void Publish(std::shared_ptr<const T> value)
+	{
+		m_value.store(std::move(value));
+		m_version.fetch_add(1, std::memory_order_release);
+	}
+
+	// for writers which copy and modify the current value
+	std::shared_ptr<const T> Load() const
+	{
+		return m_value.load();
+	}
+
+	// keeps the value returned by Get alive. while a thread holds one, its nested Gets return the same value,
+	// so a caller never sees the registry it is iterating replaced underneath it
+	class Pin
+	{
+	public:
+		Pin(const Pin&) = delete;
+		Pin& operator=(const Pin&) = delete;
+
+		~Pin()
+		{
+			if (m_pins)
+				--*m_pins;
+		}
+
+		const T& operator*() const { return *m_value; }
+		const T* operator->() const { return m_value; }
+
+	private:
+		friend class Snapshot;
+
+		Pin(const T* value, uint32_t* pins)
+			: m_value(value), m_pins(pins) {}
+		Pin(std::shared_ptr<const T> value)
+			: m_value(value.get()), m_owned(std::move(value)) {}
+
+		const T* m_value;
+		uint32_t* m_pins = nullptr; // the thread's cache, nullptr if m_owned holds the value
+		std::shared_ptr<const T> m_owned;
+	};
+
+	Pin Get() const
+	{
+		struct Cache
+		{
+			const Snapshot* owner = nullptr;
+			uint64_t version = 0;
+			std::shared_ptr<const T> value;
+			uint32_t pins = 0;
+		};
+		thread_local Cache cache;
+
+		if (cache.pins == 0)
+		{
+			const uint64_t version = m_version.load(std::memory_order_acquire);
+			if (cache.owner != this || cache.version != version)
+			{
+				cache.value = m_value.load();
+				cache.version = version;
+				cache.owner = this;
+			}
+		}
+		else if (cache.owner != this)
+			return Pin(m_value.load()); // the cache is pinned to another instance
+
+		++cache.pins;
+		return Pin(cache.value.get(), &cache.pins);
+	}
+
+private:
+	std::atomic<std::shared_ptr<const T>> m_value;
+	std::atomic_uint64_t m_version = 1;
+};
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <type_traits>
+#include <vector>
+
+// lock free ring buffer for exactly one producer and one consumer thread
+template<typename T>
+class SpscRing
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+	// capacity gets rounded up to the next power of two
+	explicit SpscRing(size_t capacity)
+		: m_buffer(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask(m_buffer.size() - 1) {}
+
+	// producer only, returns false if the ring is full
+	bool Push(const T& value)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_cached_head == m_buffer.size())
+		{
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			if (tail - m_cached_head == m_buffer.size())
+				return false;
+		}
+
+		m_buffer[tail & m_mask] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only, returns the number of values written to values
+	size_t Pop(T* values, size_t count)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		const size_t tail = m_tail.load(std::memory_order_acquire);
+
+		count = std::min(count, tail - head);
+		for (size_t i = 0; i < count; ++i)
+			values[i] = m_buffer[(head + i) & m_mask];
+
+		m_head.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+private:
+	std::vector<T> m_buffer;
+	const size_t m_mask;
+
+	alignas(64) std::atomic_size_t m_head = 0; // written by the consumer
+	alignas(64) std::atomic_size_t m_tail = 0; // written by the producer
+	alignas(64) size_t m_cached_head = 0; // producer's last seen m_head
+};
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+#include "SeqLock.h"
+
+#include <cmath>
+
+namespace WindowsGamingInput
+{
+	// last IsWireless and GetBatteryStatus results of one device, written by a single refresh thread and read with a seqlock load
+	class StatusCache
+	{
+	public:
+		struct Status
+		{
+			bool refreshed = false; // false until the first Refresh
+			bool wireless_valid = false;
+			bool wireless = false;
+			bool battery_valid = false;
+			BatteryStatus battery_status = BatteryStatus::NotPresent;
+			double battery = 0;
+		};
+
+		// smallest change of the battery level which gets reported
+		static constexpr double kBatteryThreshold = 0.05;
+
+		Status Load() const { return m_status.Load(); }
+
+		// queries the device, returns true if the status changed meaningfully since the last reported change
+		// the first refresh only sets the baseline
+		template<typename Device>
+		bool Refresh(Device& device, Status& status)
+		{
+			status = {};
+			status.refreshed = true;
+			status.wireless_valid = device.IsWireless(status.wireless);
+			if (!status.wireless_valid)
+				status.wireless = false;
+
+			status.battery_valid = device.GetBatteryStatus(status.battery_status, status.battery);
+			if (!status.battery_valid)
+			{
+				status.battery_status = BatteryStatus::NotPresent;
+				status.battery = 0;
+			}
+
+			m_status.Store(status);
+
+			const bool changed = m_reported.refreshed && (status.wireless_valid != m_reported.wireless_valid || status.wireless != m_reported.wireless
+				|| status.battery_valid != m_reported.battery_valid || status.battery_status != m_reported.battery_status
+				|| std::abs(status.battery - m_reported.battery) >= kBatteryThreshold);
+
+			if (changed || !m_reported.refreshed)
+				m_reported = status;
+
+			return changed;
+		}
+
+	private:
+		SeqLock<Status> m_status;
+		Status m_reported; // refresh thread only
+	};
+}
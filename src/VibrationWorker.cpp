@@ -0,0 +1,369 @@
+﻿#include "VibrationWorker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace WindowsGamingInput
+{
+	namespace
+	{
+		constexpr double Vibration::* kChannels[] = { &Vibration::LeftMotor, &Vibration::RightMotor, &Vibration::LeftTrigger, &Vibration::RightTrigger };
+
+		bool operator==(const Vibration& a, const Vibration& b)
+		{
+			return a.LeftMotor == b.LeftMotor && a.RightMotor == b.RightMotor && a.LeftTrigger == b.LeftTrigger && a.RightTrigger == b.RightTrigger;
+		}
+
+		// a pending request copied out of the map so the device call runs without the lock
+		struct Update
+		{
+			Backend::GamepadDevicePtr gamepad;
+			Backend::RawControllerDevicePtr controller;
+			Vibration vibration;
+		};
+	}
+
+	double VibrationWorker::Sample(const VibrationEnvelope& envelope, double time, bool& done)
+	{
+		done = false;
+		time -= envelope.delay;
+		if (time < 0)
+			return 0;
+
+		if (envelope.period != 0)
+		{
+			const double pulse = std::floor(time / envelope.period);
+			if (envelope.count != 0 && pulse >= envelope.count)
+			{
+				done = true;
+				return 0;
+			}
+
+			time -= pulse * envelope.period;
+		}
+		else if (time >= (double)envelope.attack + envelope.sustain + envelope.decay)
+		{
+			done = true;
+			return 0;
+		}
+
+		if (time < envelope.attack)
+			return envelope.level * time / envelope.attack;
+
+		time -= envelope.attack;
+		if (time < envelope.sustain)
+			return envelope.level;
+
+		time -= envelope.sustain;
+		if (time < envelope.decay)
+			return envelope.level * (1.0 - time / envelope.decay);
+
+		return 0;
+	}
+
+	Vibration VibrationWorker::Sample(const VibrationEffect& effect, size_t channels, double time, bool& done)
+	{
+		Vibration vibration;
+		done = true;
+		for (size_t i = 0; i < channels; ++i)
+		{
+			bool channel_done;
+			vibration.*kChannels[i] = Sample(effect.channels[i], time, channel_done);
+			done &= channel_done;
+		}
+		return vibration;
+	}
+
+	VibrationWorker::VibrationWorker(Instrumentation::LatencyHistogram& gamepad_latency, Instrumentation::LatencyHistogram& rcontroller_latency)
+		: m_gamepad_latency(gamepad_latency), m_rcontroller_latency(rcontroller_latency) {}
+
+	VibrationWorker::~VibrationWorker()
+	{
+		Stop();
+	}
+
+	VibrationWorker::Device& VibrationWorker::Emplace(const Backend::GamepadDevicePtr& device, bool& added)
+	{
+		const auto [it, inserted] = m_devices.try_emplace(device.get());
+		if (inserted)
+			it->second.gamepad = device;
+
+		added = inserted;
+		return it->second;
+	}
+
+	VibrationWorker::Device& VibrationWorker::Emplace(const Backend::RawControllerDevicePtr& device, bool& added)
+	{
+		const auto [it, inserted] = m_devices.try_emplace(device.get());
+		if (inserted)
+			it->second.controller = device;
+
+		added = inserted;
+		return it->second;
+	}
+
+	void VibrationWorker::Submit(const Backend::GamepadDevicePtr& device, const Vibration& vibration)
+	{
+		++m_submitted;
+		std::scoped_lock lock(m_mutex);
+		bool added;
+		auto& entry = Emplace(device, added);
+		if (entry.playing)
+			EndEffect(device.get(), entry);
+
+		Queue(device.get(), entry, added, vibration);
+	}
+
+	void VibrationWorker::Submit(const Backend::RawControllerDevicePtr& device, double vibration)
+	{
+		++m_submitted;
+		std::scoped_lock lock(m_mutex);
+		bool added;
+		auto& entry = Emplace(device, added);
+		if (entry.playing)
+			EndEffect(device.get(), entry);
+
+		Queue(device.get(), entry, added, { vibration });
+	}
+
+	void VibrationWorker::Queue(const void* key, Device& device, bool added, const Vibration& vibration)
+	{
+		// a new entry doesn't know what the device currently does, so its first request always goes through
+		if (!added && device.requested == vibration)
+		{
+			++m_unchanged;
+			return;
+		}
+
+		device.requested = vibration;
+		if (device.pending)
+		{
+			++m_replaced;
+			return;
+		}
+
+		device.pending = true;
+		m_pending.emplace_back(key);
+
+		if (!m_worker.joinable() && !m_stop)
+			m_worker = std::thread(&VibrationWorker::WorkerThread, this);
+
+		m_cv.notify_one();
+	}
+
+	void VibrationWorker::Play(const Backend::GamepadDevicePtr& device, const VibrationEffect& effect)
+	{
+		std::scoped_lock lock(m_mutex);
+		bool added;
+		Play(device.get(), Emplace(device, added), added, effect);
+	}
+
+	void VibrationWorker::Play(const Backend::RawControllerDevicePtr& device, const VibrationEffect& effect)
+	{
+		std::scoped_lock lock(m_mutex);
+		bool added;
+		Play(device.get(), Emplace(device, added), added, effect);
+	}
+
+	void VibrationWorker::Play(const void* key, Device& device, bool added, const VibrationEffect& effect)
+	{
+		++m_effects;
+
+		// the first pass has to reach the device even if the effect starts at 0
+		if (added)
+		{
+			device.requested.LeftMotor = -1;
+			device.pending = true;
+			m_pending.emplace_back(key);
+		}
+
+		device.effect = effect;
+		device.effect_start = std::chrono::steady_clock::now();
+		if (!device.playing)
+		{
+			device.playing = true;
+			m_playing.emplace_back(key);
+		}
+
+		if (!m_worker.joinable() && !m_stop)
+			m_worker = std::thread(&VibrationWorker::WorkerThread, this);
+
+		m_cv.notify_one();
+	}
+
+	void VibrationWorker::StopEffect(const void* device)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(device);
+		if (it == m_devices.end() || !it->second.playing)
+			return;
+
+		EndEffect(device, it->second);
+		Queue(device, it->second, false, {});
+	}
+
+	void VibrationWorker::EndEffect(const void* key, Device& device)
+	{
+		device.playing = false;
+		m_playing.erase(std::find(m_playing.begin(), m_playing.end(), key));
+	}
+
+	void VibrationWorker::Remove(const void* device)
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_devices.find(device);
+		if (it == m_devices.end())
+			return;
+
+		if (it->second.pending)
+			m_pending.erase(std::find(m_pending.begin(), m_pending.end(), device));
+
+		if (it->second.playing)
+			EndEffect(device, it->second);
+
+		m_devices.erase(it);
+	}
+
+	void VibrationWorker::Cancel(const void* device)
+	{
+		Remove(device);
+
+		std::unique_lock lock(m_mutex);
+		m_applied_cv.wait(lock, [this, device] { return std::find(m_applying.cbegin(), m_applying.cend(), device) == m_applying.cend(); });
+	}
+
+	void VibrationWorker::Clear()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_devices.clear();
+		m_pending.clear();
+		m_playing.clear();
+	}
+
+	void VibrationWorker::Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_stop = true;
+			m_cv.notify_all();
+		}
+
+		if (m_worker.joinable())
+			m_worker.join();
+	}
+
+	void VibrationWorker::Detach()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_stop = true;
+		m_cv.notify_all();
+		if (m_worker.joinable())
+			m_worker.detach();
+	}
+
+	void VibrationWorker::GetStats(VibrationQueueStats& stats) const
+	{
+		stats.submitted = m_submitted;
+		stats.unchanged = m_unchanged;
+		stats.replaced = m_replaced;
+		stats.applied = m_applied;
+		stats.failed = m_failed;
+		stats.effects = m_effects;
+	}
+
+	void VibrationWorker::ResetStats()
+	{
+		m_submitted = 0;
+		m_unchanged = 0;
+		m_replaced = 0;
+		m_applied = 0;
+		m_failed = 0;
+		m_effects = 0;
+	}
+
+	void VibrationWorker::WorkerThread()
+	{
+		std::vector<Update> updates;
+		auto next = std::chrono::steady_clock::now();
+
+		std::unique_lock lock(m_mutex);
+		while (true)
+		{
+			m_cv.wait(lock, [this] { return m_stop || !m_pending.empty() || !m_playing.empty(); });
+
+			// requests arriving until the next pass is due replace each other
+			if (m_cv.wait_until(lock, next, [this] { return m_stop; }))
+				break;
+
+			// effects are sampled at the time of the pass, so their timing doesn't depend on when the pass runs
+			const auto now = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < m_playing.size();)
+			{
+				const void* key = m_playing[i];
+				auto& device = m_devices.at(key);
+				const double time = std::chrono::duration<double, std::milli>(now - device.effect_start).count();
+
+				bool done;
+				const Vibration vibration = Sample(device.effect, device.gamepad ? std::size(kChannels) : 1, time, done);
+
+				if (!(device.requested == vibration))
+				{
+					device.requested = vibration;
+					if (!device.pending)
+					{
+						device.pending = true;
+						m_pending.emplace_back(key);
+					}
+				}
+
+				// all channels are back at 0 once done
+				if (done)
+				{
+					device.playing = false;
+					m_playing[i] = m_playing.back();
+					m_playing.pop_back();
+				}
+				else
+					++i;
+			}
+
+			for (const void* key : m_pending)
+			{
+				auto& device = m_devices.at(key);
+				device.pending = false;
+				updates.emplace_back(device.gamepad, device.controller, device.requested);
+				m_applying.emplace_back(key);
+			}
+
+			m_pending.clear();
+			lock.unlock();
+
+			for (const auto& update : updates)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				bool result;
+				if (update.gamepad)
+				{
+					result = update.gamepad->SetVibration(update.vibration);
+					m_gamepad_latency.Record(Instrumentation::ElapsedNs(start));
+				}
+				else
+				{
+					result = update.controller->SetVibration(update.vibration.LeftMotor);
+					m_rcontroller_latency.Record(Instrumentation::ElapsedNs(start));
+				}
+
+				if (result)
+					++m_applied;
+				else
+					++m_failed;
+			}
+
+			updates.clear(); // drops the device references outside the lock
+			next = std::chrono::steady_clock::now() + kInterval;
+			lock.lock();
+			m_applying.clear();
+			m_applied_cv.notify_all();
+		}
+	}
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include "../include/WindowsGamingInput.h"
+#include "Backend.h"
+#include "Instrumentation.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WindowsGamingInput
+{
+	// applies submitted vibrations and plays effects from a background thread so callers never wait on the device
+	// only the latest request per device is kept, requests equal to it are dropped and one pass over all
+	// changed devices runs at most every kInterval. while effects play every pass samples them at the current time
+	class VibrationWorker
+	{
+	public:
+		static constexpr auto kInterval = std::chrono::milliseconds(4);
+
+		// the device calls are timed into these
+		VibrationWorker(Instrumentation::LatencyHistogram& gamepad_latency, Instrumentation::LatencyHistogram& rcontroller_latency);
+		~VibrationWorker();
+
+		void Submit(const Backend::GamepadDevicePtr& device, const Vibration& vibration);
+		void Submit(const Backend::RawControllerDevicePtr& device, double vibration);
+
+		void Play(const Backend::GamepadDevicePtr& device, const VibrationEffect& effect);
+		void Play(const Backend::RawControllerDevicePtr& device, const VibrationEffect& effect);
+		void StopEffect(const void* device);
+
+		// forgets the device and drops its pending request, for removed devices
+		void Remove(const void* device);
+		// like Remove, but also waits for a pass which already took a request for the device to apply it,
+		// so a synchronous SetVibration right after it is never overwritten by an older request
+		void Cancel(const void* device);
+		void Clear();
+
+		void Stop();
+		// stops the worker without joining it, for DLL_PROCESS_DETACH
+		void Detach();
+
+		void GetStats(VibrationQueueStats& stats) const;
+		void ResetStats();
+
+		// intensity of one channel time ms after the start of its effect, done is set once it won't change anymore
+		static double Sample(const VibrationEnvelope& envelope, double time, bool& done);
+		// the first channels of the effect (all for gamepads, one for raw controllers), done once every one of them is
+		static Vibration Sample(const VibrationEffect& effect, size_t channels, double time, bool& done);
+
+	private:
+		struct Device
+		{
+			// one of them is set
+			Backend::GamepadDevicePtr gamepad;
+			Backend::RawControllerDevicePtr controller;
+
+			Vibration requested; // raw controllers use LeftMotor
+			bool pending = false;
+
+			VibrationEffect effect;
+			std::chrono::steady_clock::time_point effect_start;
+			bool playing = false;
+		};
+
+		// expect m_mutex to be held, added is set if the device wasn't known yet
+		Device& Emplace(const Backend::GamepadDevicePtr& device, bool& added);
+		Device& Emplace(const Backend::RawControllerDevicePtr& device, bool& added);
+		void Queue(const void* key, Device& device, bool added, const Vibration& vibration);
+		void Play(const void* key, Device& device, bool added, const VibrationEffect& effect);
+		void EndEffect(const void* key, Device& device);
+		void WorkerThread();
+
+		Instrumentation::LatencyHistogram& m_gamepad_latency;
+		Instrumentation::LatencyHistogram& m_rcontroller_latency;
+
+		std::atomic_uint64_t m_submitted = 0;
+		std::atomic_uint64_t m_unchanged = 0;
+		std::atomic_uint64_t m_replaced = 0;
+		std::atomic_uint64_t m_applied = 0;
+		std::atomic_uint64_t m_failed = 0;
+		std::atomic_uint64_t m_effects = 0;
+
+		std::mutex m_mutex; // guards everything below
+		std::condition_variable m_cv;
+		std::unordered_map<const void*, Device> m_devices; // keyed by the device pointer
+		std::vector<const void*> m_pending; // keys with pending set, in submission order
+		std::vector<const void*> m_playing; // keys with playing set
+		std::vector<const void*> m_applying; // keys of the pass running without the lock
+		std::condition_variable m_applied_cv; // signaled when a pass is done
+
+		std::thread m_worker;
+		bool m_stop = false;
+	};
+}
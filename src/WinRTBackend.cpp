@@ -0,0 +1,508 @@
+﻿#include "Backend.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <roapi.h>
+#include <wrl.h>
+#include <windows.gaming.input.h>
+
+using namespace ABI::Windows::Foundation::Collections;
+using namespace ABI::Windows::Gaming::Input;
+using namespace ABI::Windows::Devices::Haptics;
+using namespace Microsoft::WRL;
+using namespace Wrappers;
+
+namespace Backend = WindowsGamingInput::Backend;
+
+RoInitializeWrapper g_ro{RO_INIT_MULTITHREADED};
+
+bool GetBatteryInfo(const ComPtr<IGameControllerBatteryInfo>& battery_info, WindowsGamingInput::BatteryStatus& status, double& battery)
+{
+	ComPtr<ABI::Windows::Devices::Power::IBatteryReport> report;
+	HRESULT hr = battery_info->TryGetBatteryReport(&report);
+	if (FAILED(hr) || !report)
+		return false;
+
+	static_assert(sizeof(WindowsGamingInput::BatteryStatus) == sizeof(ABI::Windows::System::Power::BatteryStatus));
+	hr = report->get_Status((ABI::Windows::System::Power::BatteryStatus*)&status);
+	assert(SUCCEEDED(hr));
+
+	ComPtr<__FIReference_1_int> remaining_ptr, full_ptr;
+	report->get_RemainingCapacityInMilliwattHours(&remaining_ptr);
+	report->get_FullChargeCapacityInMilliwattHours(&full_ptr);
+
+	int remaining = 0, full = 0;
+	if (remaining_ptr)
+	{
+		hr = remaining_ptr->get_Value(&remaining);
+		assert(SUCCEEDED(hr));
+	}
+
+	if (full_ptr)
+	{
+		hr = full_ptr->get_Value(&full);
+		assert(SUCCEEDED(hr));
+	}
+
+	// remaining is always 100 when connected and status discharching (?!) -> check for IsWireless before
+	battery = full <= 0 ? 0 : static_cast<double>(remaining) / static_cast<double>(full);
+	return true;
+}
+
+#pragma region Gamepad
+class GamepadDevice : public Backend::IGamepadDevice
+{
+public:
+	GamepadDevice(ComPtr<IGamepad> gamepad)
+		: m_gamepad(std::move(gamepad)) {}
+
+	bool GetReading(WindowsGamingInput::GamepadState& state) override
+	{
+		static_assert(sizeof(WindowsGamingInput::GamepadState) == sizeof(GamepadReading));
+		return SUCCEEDED(m_gamepad->GetCurrentReading((GamepadReading*)&state));
+	}
+
+	bool SetVibration(const WindowsGamingInput::Vibration& vibration) override
+	{
+		static_assert(sizeof(WindowsGamingInput::Vibration) == sizeof(GamepadVibration));
+		GamepadVibration tmp;
+		memcpy(&tmp, &vibration, sizeof(GamepadVibration));
+		return SUCCEEDED(m_gamepad->put_Vibration(tmp));
+	}
+
+	bool GetVibration(WindowsGamingInput::Vibration& vibration) override
+	{
+		return SUCCEEDED(m_gamepad->get_Vibration((GamepadVibration*)&vibration));
+	}
+
+	bool IsWireless(bool& wireless) override
+	{
+		ComPtr<IGameController> controller;
+		auto hr = m_gamepad.As(&controller);
+		assert(SUCCEEDED(hr));
+
+		static_assert(sizeof(bool) == sizeof(boolean));
+		return SUCCEEDED(controller->get_IsWireless((boolean*)&wireless));
+	}
+
+	bool GetBatteryStatus(WindowsGamingInput::BatteryStatus& status, double& battery) override
+	{
+		ComPtr<IGameControllerBatteryInfo> battery_info;
+		auto hr = m_gamepad.As(&battery_info);
+		assert(SUCCEEDED(hr));
+
+		return GetBatteryInfo(battery_info, status, battery);
+	}
+
+private:
+	ComPtr<IGamepad> m_gamepad;
+};
+#pragma endregion
+
+#pragma region RawGameController
+using RControllerPtr = ComPtr<IRawGameController>;
+
+// https://docs.microsoft.com/en-us/uwp/api/windows.devices.haptics.knownsimplehapticscontrollerwaveforms
+// ABI::Windows::Devices::Haptics::IKnownSimpleHapticsControllerWaveformsStatics::get_RumbleContinuous()
+constexpr uint16_t kRumbleContinuous = 0x1005;
+
+// haptics controller with its kRumbleContinuous feedback
+struct RumbleMotor
+{
+	ComPtr<ISimpleHapticsController> haptics;
+	ComPtr<ISimpleHapticsControllerFeedback> feedback;
+};
+
+WindowsGamingInput::RawController::Description GetDescription(const std::wstring& uid, const RControllerPtr& controller, const ComPtr<IRawGameController2>& controller2)
+{
+	WindowsGamingInput::RawController::Description description{};
+	wcscpy_s(description.uid, uid.c_str());
+
+	HString name;
+	if (SUCCEEDED(controller2->get_DisplayName(name.GetAddressOf())))
+		wcscpy_s(description.display_name, name.GetRawBuffer(nullptr));
+
+	controller->get_AxisCount((int*)&description.axis_count);
+	controller->get_ButtonCount((int*)&description.button_count);
+	controller->get_SwitchCount((int*)&description.switches_count);
+	return description;
+}
+
+std::vector<RumbleMotor> GetRumbleMotors(const ComPtr<IRawGameController2>& controller)
+{
+	std::vector<RumbleMotor> result;
+
+	ComPtr<IVectorView<SimpleHapticsController*>> haptics;
+	if (FAILED(controller->get_SimpleHapticsControllers(&haptics)))
+		return result;
+
+	uint32_t count = 0;
+	haptics->get_Size(&count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		ComPtr<ISimpleHapticsController> haptic;
+		if (FAILED(haptics->GetAt(i, &haptic)))
+			continue;
+
+		ComPtr<IVectorView<SimpleHapticsControllerFeedback*>> feedbacks;
+		if (FAILED(haptic->get_SupportedFeedback(&feedbacks)))
+			continue;
+
+		uint32_t feedback_count = 0;
+		feedbacks->get_Size(&feedback_count);
+		for (uint32_t j = 0; j < feedback_count; ++j)
+		{
+			ComPtr<ISimpleHapticsControllerFeedback> feedback;
+			if (FAILED(feedbacks->GetAt(j, &feedback)))
+				continue;
+
+			uint16_t waveform = 0;
+			feedback->get_Waveform(&waveform);
+			if (waveform == kRumbleContinuous)
+			{
+				result.emplace_back(haptic, feedback);
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+class RawControllerDevice : public Backend::IRawControllerDevice
+{
+public:
+	RawControllerDevice(RControllerPtr controller, size_t button_count, std::vector<RumbleMotor> motors)
+		: m_controller(std::move(controller)), m_button_count(button_count), m_motors(std::move(motors)) {}
+
+	bool GetReading(WindowsGamingInput::RawController::State& state) override
+	{
+		static_assert(sizeof(bool) == sizeof(boolean));
+		return SUCCEEDED(m_controller->GetCurrentReading((uint32_t)state.button_count, (boolean*)state.buttons, (uint32_t)state.switch_count, (GameControllerSwitchPosition*)state.switches, (uint32_t)state.axis_count, state.axis, &state.timestamp));
+	}
+
+	bool GetButtonLabel(size_t button, WindowsGamingInput::ButtonLabel& label) override
+	{
+		if (button >= m_button_count)
+			return false;
+
+		static_assert(sizeof(WindowsGamingInput::ButtonLabel) == sizeof(GameControllerButtonLabel));
+		return SUCCEEDED(m_controller->GetButtonLabel((int)button, (GameControllerButtonLabel*)&label));
+	}
+
+	bool HasVibration() override
+	{
+		return !m_motors.empty();
+	}
+
+	bool SetVibration(double vibration) override
+	{
+		bool result = false;
+		for (const auto& motor : m_motors)
+		{
+			if (vibration <= 0.000001)
+				motor.haptics->StopFeedback();
+			else if (SUCCEEDED(motor.haptics->SendHapticFeedbackWithIntensity(motor.feedback.Get(), vibration)))
+				result = true;
+		}
+		return result;
+	}
+
+	bool IsVibrating() override
+	{
+		for (const auto& motor : m_motors)
+		{
+			ABI::Windows::Foundation::TimeSpan ts{};
+			motor.feedback->get_Duration(&ts);
+			if (ts.Duration != 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool IsWireless(bool& wireless) override
+	{
+		ComPtr<IGameController> controller;
+		auto hr = m_controller.As(&controller);
+		assert(SUCCEEDED(hr));
+
+		static_assert(sizeof(bool) == sizeof(boolean));
+		return SUCCEEDED(controller->get_IsWireless((boolean*)&wireless));
+	}
+
+	bool GetBatteryStatus(WindowsGamingInput::BatteryStatus& status, double& battery) override
+	{
+		ComPtr<IGameControllerBatteryInfo> battery_info;
+		auto hr = m_controller.As(&battery_info);
+		if (FAILED(hr) || !battery_info)
+			return false;
+
+		return GetBatteryInfo(battery_info, status, battery);
+	}
+
+private:
+	RControllerPtr m_controller;
+	size_t m_button_count;
+	std::vector<RumbleMotor> m_motors; // resolved once when the controller gets added
+};
+
+bool GetNonRoamableId(const RControllerPtr& controller, ComPtr<IRawGameController2>& controller2, std::wstring& uid)
+{
+	if (FAILED(controller.As(&controller2))) // I guess shouldn't fail, idk (?)
+		return false;
+
+	HString name;
+	if (FAILED(controller2->get_NonRoamableId(name.GetAddressOf())))
+		return false;
+
+	uid = name.GetRawBuffer(nullptr);
+	return !uid.empty();
+}
+#pragma endregion
+
+class WinRTBackend : public Backend::IBackend
+{
+public:
+	bool StartGamepads(Backend::IListener& listener) override
+	{
+		std::scoped_lock lock(m_mutex);
+		m_listener = &listener;
+
+		auto hr = RoGetActivationFactory(HStringReference(L"Windows.Gaming.Input.Gamepad").Get(),
+		                                 IID_PPV_ARGS(&m_gamepad_statics));
+		if (FAILED(hr) || !m_gamepad_statics)
+		{
+#ifdef _DEBUG
+			std::cout << "Windows.Gaming.Input.Gamepad init failed: 0x" << std::hex << (uintptr_t)hr << std::endl;
+#endif
+			return false;
+		}
+
+		hr = m_gamepad_statics->add_GamepadAdded(
+			Callback<__FIEventHandler_1_Windows__CGaming__CInput__CGamepad>([this](IInspectable* sender, IGamepad* gamepad) { return OnGamepadAdded(gamepad); }).Get(),
+			&m_add_gamepad_token);
+		assert(SUCCEEDED(hr));
+
+		hr = m_gamepad_statics->add_GamepadRemoved(
+			Callback<__FIEventHandler_1_Windows__CGaming__CInput__CGamepad>([this](IInspectable* sender, IGamepad* gamepad) { return OnGamepadRemoved(gamepad); }).Get(),
+			&m_remove_gamepad_token);
+		assert(SUCCEEDED(hr));
+
+#ifdef _DEBUG
+		std::cout << "Windows.Gaming.Input.Gamepad initialized" << std::endl;
+#endif
+
+		ScanGamepads();
+		return true;
+	}
+
+	bool StartRawControllers(Backend::IListener& listener) override
+	{
+		std::scoped_lock lock(m_mutex);
+		m_listener = &listener;
+
+		auto hr = RoGetActivationFactory(HStringReference(L"Windows.Gaming.Input.RawGameController").Get(),
+		                                 IID_PPV_ARGS(&m_rcontroller_statics));
+		if (FAILED(hr) || !m_rcontroller_statics)
+		{
+#ifdef _DEBUG
+			std::cout << "Windows.Gaming.Input.RawGameController init failed: 0x" << std::hex << (uintptr_t)hr << std::endl;
+#endif
+			return false;
+		}
+
+		hr = m_rcontroller_statics->add_RawGameControllerAdded(
+			Callback<__FIEventHandler_1_Windows__CGaming__CInput__CRawGameController>([this](IInspectable* sender, IRawGameController* controller) { return OnRawGameControllerAdded(controller); }).Get(),
+			&m_add_rcontroller_token);
+		assert(SUCCEEDED(hr));
+
+		hr = m_rcontroller_statics->add_RawGameControllerRemoved(
+			Callback<__FIEventHandler_1_Windows__CGaming__CInput__CRawGameController>([this](IInspectable* sender, IRawGameController* controller) { return OnRawGameControllerRemoved(controller); }).Get(),
+			&m_remove_rcontroller_token);
+		assert(SUCCEEDED(hr));
+
+#ifdef _DEBUG
+		std::cout << "Windows.Gaming.Input.RawGameController initialized" << std::endl;
+#endif
+
+		ScanRawGameControllers();
+		return true;
+	}
+
+	void Stop() override
+	{
+		std::scoped_lock lock(m_mutex);
+		m_listener = nullptr;
+
+		if (m_gamepad_statics)
+		{
+			if (m_add_gamepad_token.value)
+				m_gamepad_statics->remove_GamepadAdded(m_add_gamepad_token);
+
+			if (m_remove_gamepad_token.value)
+				m_gamepad_statics->remove_GamepadRemoved(m_remove_gamepad_token);
+		}
+
+		if (m_rcontroller_statics)
+		{
+			if (m_add_rcontroller_token.value)
+				m_rcontroller_statics->remove_RawGameControllerAdded(m_add_rcontroller_token);
+
+			if (m_remove_rcontroller_token.value)
+				m_rcontroller_statics->remove_RawGameControllerRemoved(m_remove_rcontroller_token);
+		}
+	}
+
+private:
+	// expects m_mutex to be held
+	void ScanGamepads()
+	{
+		ComPtr<IVectorView<Gamepad*>> gamepads;
+		auto hr = m_gamepad_statics->get_Gamepads(&gamepads);
+		assert(SUCCEEDED(hr));
+
+		uint32_t count = 0;
+		hr = gamepads->get_Size(&count);
+		assert(SUCCEEDED(hr));
+
+#ifdef _DEBUG
+		std::cout << count << " gamepads are connected" << std::endl;
+#endif
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			ComPtr<IGamepad> gamepad;
+			hr = gamepads->GetAt(i, &gamepad);
+			assert(SUCCEEDED(hr));
+
+			m_listener->OnGamepadAdded(gamepad.Get(), std::make_shared<GamepadDevice>(gamepad));
+		}
+	}
+
+	HRESULT OnGamepadAdded(IGamepad* gamepad)
+	{
+#ifdef _DEBUG
+		std::cout << "OnGamepadAdded" << std::endl;
+#endif
+
+		std::scoped_lock lock(m_mutex);
+		if (m_listener)
+			m_listener->OnGamepadAdded(gamepad, std::make_shared<GamepadDevice>(gamepad));
+
+		return S_OK;
+	}
+
+	HRESULT OnGamepadRemoved(IGamepad* gamepad)
+	{
+#ifdef _DEBUG
+		std::cout << "OnGamepadRemoved" << std::endl;
+#endif
+
+		std::scoped_lock lock(m_mutex);
+		if (m_listener)
+			m_listener->OnGamepadRemoved(gamepad);
+
+		return S_OK;
+	}
+
+	// expects m_mutex to be held
+	void AddRawGameController(const RControllerPtr& controller)
+	{
+		ComPtr<IRawGameController2> controller2;
+		std::wstring uid;
+		if (!GetNonRoamableId(controller, controller2, uid))
+			return;
+
+		const auto description = GetDescription(uid, controller, controller2);
+		auto device = std::make_shared<RawControllerDevice>(controller, description.button_count, GetRumbleMotors(controller2));
+		m_listener->OnRawControllerAdded(description, std::move(device));
+	}
+
+	// expects m_mutex to be held
+	void ScanRawGameControllers()
+	{
+		ComPtr<IVectorView<RawGameController*>> controllers;
+		auto hr = m_rcontroller_statics->get_RawGameControllers(&controllers);
+		assert(SUCCEEDED(hr));
+
+		uint32_t count;
+		hr = controllers->get_Size(&count);
+		assert(SUCCEEDED(hr));
+
+#ifdef _DEBUG
+		std::cout << count << " controllers are connected" << std::endl;
+#endif
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			ComPtr<IRawGameController> controller;
+			hr = controllers->GetAt(i, &controller);
+			assert(SUCCEEDED(hr));
+
+			AddRawGameController(controller);
+		}
+	}
+
+	HRESULT OnRawGameControllerAdded(IRawGameController* controller)
+	{
+#ifdef _DEBUG
+		std::cout << "OnRawGameControllerAdded" << std::endl;
+#endif
+
+		std::scoped_lock lock(m_mutex);
+		if (m_listener)
+			AddRawGameController(controller);
+
+		return S_OK;
+	}
+
+	HRESULT OnRawGameControllerRemoved(IRawGameController* controller)
+	{
+#ifdef _DEBUG
+		std::cout << "OnRawGameControllerRemoved" << std::endl;
+#endif
+
+		ComPtr<IRawGameController2> controller2;
+		std::wstring uid;
+		if (!GetNonRoamableId(controller, controller2, uid))
+			return S_OK;
+
+		std::scoped_lock lock(m_mutex);
+		if (m_listener)
+			m_listener->OnRawControllerRemoved(uid);
+
+		return S_OK;
+	}
+
+	std::mutex m_mutex; // guards m_listener, hot-plug events are forwarded while holding it
+	Backend::IListener* m_listener = nullptr;
+
+	ComPtr<IGamepadStatics> m_gamepad_statics;
+	EventRegistrationToken m_add_gamepad_token{};
+	EventRegistrationToken m_remove_gamepad_token{};
+
+	ComPtr<IRawGameControllerStatics> m_rcontroller_statics;
+	EventRegistrationToken m_add_rcontroller_token{};
+	EventRegistrationToken m_remove_rcontroller_token{};
+};
+
+BOOL WINAPI DllMain(HINSTANCE hinstance, DWORD reason, LPVOID reserved)
+{
+	if (reason == DLL_PROCESS_ATTACH)
+	{
+		Backend::SetFactory([]() -> std::shared_ptr<Backend::IBackend> { return std::make_shared<WinRTBackend>(); });
+		// raw controllers get scanned at load too, so their first calls and ControllerChanged events never wait for a deferred start
+		WindowsGamingInput::InitializeAsync(WindowsGamingInput::InitializeMode::Eager);
+	}
+	else if (reason == DLL_PROCESS_DETACH)
+	{
+		Backend::Shutdown();
+	}
+
+	return TRUE;
+}
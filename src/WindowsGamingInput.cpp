@@ -1,876 +1,2822 @@
-﻿#define DLLEXPORT __declspec(dllexport)
+﻿#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#endif
 
 #include "../include/WindowsGamingInput.h"
-
+#include "AxisPipeline.h"
+#include "Backend.h"
+#include "BitPack.h"
+#include "ClockCorrelation.h"
+#include "Instrumentation.h"
+#include "PollScheduler.h"
+#include "Recorder.h"
+#include "SeqLock.h"
+#include "SharedState.h"
+#include "SlotAllocator.h"
+#include "Snapshot.h"
+#include "SpscRing.h"
+#include "StatusCache.h"
+#include "VibrationWorker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <filesystem>
 #include <iostream>
-#include <shared_mutex>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <utility>
+#include <variant>
 
 #include <unordered_map>
 #include <vector>
 #include <queue>
 
-#include <roapi.h>
-#include <wrl.h>
-#include <windows.gaming.input.h>
+namespace Backend = WindowsGamingInput::Backend;
+namespace Instrumentation = WindowsGamingInput::Instrumentation;
+namespace SharedState = WindowsGamingInput::SharedState;
 
-using namespace ABI::Windows::Foundation::Collections;
-using namespace ABI::Windows::Gaming::Input;
-using namespace ABI::Windows::Devices::Haptics;
-using namespace Microsoft::WRL;
-using namespace Wrappers;
-
-RoInitializeWrapper g_ro{RO_INIT_MULTITHREADED};
 std::mutex g_cb_mutex;
 std::vector<WindowsGamingInput::ControllerChanged_t> g_callbacks;
 
-#pragma region Gamepad
-IGamepadStatics* g_gamepad_statics = nullptr;
-using GamepadPtr = ComPtr<IGamepad>;
-std::vector<GamepadPtr> g_gamepads;
-std::shared_mutex g_gamepad_mutex;
+WindowsGamingInput::Recorder g_recorder;
+
+#pragma region Metrics
+Instrumentation::CallCounters g_calls;
+
+Instrumentation::LatencyHistogram g_gamepad_reading_latency;
+Instrumentation::LatencyHistogram g_gamepad_vibration_latency;
+Instrumentation::LatencyHistogram g_rcontroller_reading_latency;
+Instrumentation::LatencyHistogram g_rcontroller_vibration_latency;
+
+std::atomic_uint64_t g_gamepads_added = 0;
+std::atomic_uint64_t g_gamepads_removed = 0;
+std::atomic_uint64_t g_rcontrollers_added = 0;
+std::atomic_uint64_t g_rcontrollers_removed = 0;
+
+Instrumentation::LockMonitor g_gamepad_lock_stats;
+Instrumentation::LockMonitor g_rcontroller_lock_stats;
+Instrumentation::LockMonitor g_changes_lock_stats;
+Instrumentation::LockMonitor g_dispatch_lock_stats;
+Instrumentation::LockMonitor g_callback_lock_stats;
+#pragma endregion
+
+// applies SubmitVibration requests, its device calls count towards the SetVibration latencies
+WindowsGamingInput::VibrationWorker g_vibration_worker(g_gamepad_vibration_latency, g_rcontroller_vibration_latency);
 
-void ScanGamepads()
+#pragma region InputWait
+// one shared poll reads the devices WaitForInput waits on every kInputWaitInterval, gamepads only while the poller doesn't run.
+// the poller and hot-plug events wake the waiters, so they only ever compare timestamps
+constexpr auto kInputWaitInterval = std::chrono::milliseconds(4);
+
+// the devices of one WaitForInput call
+struct InputWait
 {
-	ComPtr<IVectorView<Gamepad*>> gamepads;
-	auto hr = g_gamepad_statics->get_Gamepads(&gamepads);
-	assert(SUCCEEDED(hr));
+	uint64_t gamepads;
+	const WindowsGamingInput::RawController::Handle* controllers;
+	size_t count;
+};
 
-	uint32_t count = 0;
-	hr = gamepads->get_Size(&count);
-	assert(SUCCEEDED(hr));
+// a timestamp read by the shared poll, epoch tells which pass read it
+struct InputTimestamp
+{
+	uint64_t timestamp;
+	uint64_t epoch;
+};
 
-#ifdef _DEBUG
-	std::cout << count << " gamepads are connected" << std::endl;
-#endif
+std::mutex g_input_mutex; // guards everything below except g_input_waiters
+std::condition_variable g_input_cv;
+uint64_t g_input_polls = 0;
+uint64_t g_input_hotplugs = 0;
+std::atomic_uint32_t g_input_waiters = 0;
+
+std::vector<const InputWait*> g_input_waits;
+uint64_t g_input_epoch = 0; // bumped whenever the shared poll takes the devices it reads
+bool g_input_waits_added = false;
+std::array<InputTimestamp, 64> g_input_gamepad_timestamps{};
+std::unordered_map<WindowsGamingInput::RawController::Handle, InputTimestamp> g_input_rcontroller_timestamps;
+std::condition_variable g_input_poller_cv;
+std::thread g_input_poller;
+bool g_input_poller_stop = false;
+
+void WakeInputWaiters(bool hotplug)
+{
+	// every hot-plug is counted, polls only while someone waits
+	if (!hotplug && g_input_waiters == 0)
+		return;
 
-	for (uint32_t i = 0; i < count; ++i)
 	{
-		ComPtr<IGamepad> gamepad;
-		hr = gamepads->GetAt(i, &gamepad);
-		assert(SUCCEEDED(hr));
+		std::scoped_lock lock(g_input_mutex);
+		++(hotplug ? g_input_hotplugs : g_input_polls);
+	}
 
-		std::unique_lock lock(g_gamepad_mutex);
-		const auto it = std::ranges::find(std::as_const(g_gamepads), gamepad);
-		if (it == g_gamepads.cend())
-		{
-			g_gamepads.emplace_back(gamepad);
-#ifdef _DEBUG
-			std::cout << "inserted new gamepad" << std::endl;
-#endif
-			lock.unlock();
+	g_input_cv.notify_all();
+}
+#pragma endregion
+
+#pragma region ControllerChanged
+// callbacks are invoked in order on a dedicated thread, so a slow callback never blocks the WinRT event thread
+// delivery is serial: a batch runs under one g_cb_mutex hold, so an event waits for the callbacks of every event queued before it
+// that hasn't finished yet (the rest of the batch in flight and its own batch up to it) plus one wakeup; nothing bounds a slow callback
+struct ControllerEvent
+{
+	WindowsGamingInput::EventType type;
+	WindowsGamingInput::ControllerType controller;
+	std::variant<size_t, std::wstring> uid;
+	std::chrono::steady_clock::time_point queued;
+};
+
+std::mutex g_dispatch_mutex;
+std::condition_variable g_dispatch_cv;
+std::vector<ControllerEvent> g_dispatch_queue;
+std::thread g_dispatcher;
+bool g_dispatcher_stop = false;
+
+std::atomic_uint64_t g_dispatch_delivered = 0;
+std::atomic_uint64_t g_dispatch_coalesced = 0;
+std::atomic_uint64_t g_dispatch_last_latency = 0; // ns
+std::atomic_uint64_t g_dispatch_max_latency = 0; // ns
+
+void DispatcherThread()
+{
+	std::vector<ControllerEvent> events;
+
+	std::unique_lock lock(g_dispatch_mutex);
+	while (true)
+	{
+		g_dispatch_cv.wait(lock, [] { return g_dispatcher_stop || !g_dispatch_queue.empty(); });
+		if (g_dispatcher_stop)
+			break;
 
-			std::scoped_lock cb_lock(g_cb_mutex);
-			for (const auto& cb : g_callbacks)
+		events.swap(g_dispatch_queue);
+		lock.unlock();
+
+		{
+			const auto cb_lock = g_callback_lock_stats.Lock(g_cb_mutex);
+			for (const auto& event : events)
 			{
-				cb(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::Gamepad, g_gamepads.size() - 1);
+				const uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - event.queued).count();
+				g_dispatch_last_latency = latency;
+				if (latency > g_dispatch_max_latency)
+					g_dispatch_max_latency = latency;
+
+				const auto uid = std::visit([](const auto& value) { return std::variant<size_t, std::wstring_view>{ value }; }, event.uid);
+				for (const auto& cb : g_callbacks)
+				{
+					cb(event.type, event.controller, uid);
+				}
 			}
 		}
+
+		g_dispatch_delivered += events.size();
+		events.clear();
+		lock.lock();
 	}
 }
 
-EventRegistrationToken g_add_gamepad_token{};
-HRESULT OnGamepadAdded(IInspectable* sender, IGamepad* gamepad)
+void QueueControllerChanged(WindowsGamingInput::EventType type, WindowsGamingInput::ControllerType controller, std::variant<size_t, std::wstring> uid)
 {
-#ifdef _DEBUG
-	std::cout << "OnGamepadAdded" << std::endl;
-#endif
+	WakeInputWaiters(true);
+
+	const auto lock = g_dispatch_lock_stats.Lock(g_dispatch_mutex);
 
-	const ComPtr<IGamepad> ptr{ gamepad };
-	
-	std::unique_lock lock(g_gamepad_mutex);
-	const auto it = std::ranges::find(std::as_const(g_gamepads), ptr);
-	if (it != g_gamepads.cend())
-		return S_OK;
-	
-	size_t index = (size_t)-1;
-	// check if we still got a free index in our internal list
-	for(size_t i = 0; i < g_gamepads.size(); ++i)
+	// an add which hasn't been delivered yet cancels out with its remove
+	if (type == WindowsGamingInput::EventType::ControllerRemoved)
 	{
-		if (!g_gamepads[i])
+		const auto it = std::find_if(g_dispatch_queue.rbegin(), g_dispatch_queue.rend(), [&](const ControllerEvent& event) { return event.controller == controller && event.uid == uid; });
+		if (it != g_dispatch_queue.rend() && it->type == WindowsGamingInput::EventType::ControllerAdded)
 		{
-			g_gamepads[i] = ptr;
-#ifdef _DEBUG
-			std::cout << "OnGamepadAdded:inserted new gamepad at empty index" << std::endl;
-#endif
-			index = i;
+			g_dispatch_queue.erase(std::next(it).base());
+			g_dispatch_coalesced += 2;
+			return;
 		}
 	}
-	
-	// no free index
-	if (index == (size_t)-1)
-	{
-		g_gamepads.emplace_back(gamepad);
-		index = g_gamepads.size() - 1;
-#ifdef _DEBUG
-		std::cout << "inserted new gamepad at the end" << std::endl;
-#endif
-	}
 
-	lock.unlock();
-	
-	std::scoped_lock cb_lock(g_cb_mutex);
-	for (const auto& cb : g_callbacks)
+	g_dispatch_queue.emplace_back(type, controller, std::move(uid), std::chrono::steady_clock::now());
+	if (!g_dispatcher.joinable() && !g_dispatcher_stop)
+		g_dispatcher = std::thread(DispatcherThread);
+
+	g_dispatch_cv.notify_one();
+}
+#pragma endregion
+
+#pragma region Gamepad
+std::atomic_bool g_gamepad_initialized = false;
+using GamepadPtr = Backend::GamepadDevicePtr;
+
+// immutable, republished on every gamepad hot-plug
+struct GamepadRegistry
+{
+	std::vector<GamepadPtr> gamepads; // indexed by slot, empty if the slot is free
+	std::vector<uint32_t> generations; // 0 if the slot is free
+	std::vector<std::optional<WindowsGamingInput::GamepadProcessing>> processing; // by slot, cleared when the gamepad is removed
+	std::shared_ptr<const WindowsGamingInput::AxisPipeline> pipeline; // processing of all slots, 6 lanes each, nullptr if none is set
+	std::vector<std::shared_ptr<WindowsGamingInput::StatusCache>> status; // by slot, empty if the slot is free
+	std::vector<std::shared_ptr<WindowsGamingInput::ClockCorrelation>> clocks; // by slot, empty if the slot is free
+
+	const GamepadPtr& Find(size_t index) const
 	{
-		cb(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::Gamepad, index);
+		static const GamepadPtr kEmpty;
+		return index < gamepads.size() ? gamepads[index] : kEmpty;
 	}
+};
 
-	return S_OK;
-}
+Snapshot<GamepadRegistry> g_gamepad_registry;
+
+// writer side, guarded by g_gamepad_mutex
+SlotAllocator g_gamepad_allocator;
+std::unordered_map<const void*, size_t> g_gamepad_slots; // backend key -> slot
+std::mutex g_gamepad_mutex;
 
-EventRegistrationToken g_remove_gamepad_token{};
-HRESULT OnGamepadRemoved(IInspectable* sender, IGamepad* gamepad)
+// GamepadAxis bit order, the sticks are the lane pairs 2/3 and 4/5
+constexpr double WindowsGamingInput::GamepadState::* kGamepadAxes[] = {
+	&WindowsGamingInput::GamepadState::LeftTrigger, &WindowsGamingInput::GamepadState::RightTrigger,
+	&WindowsGamingInput::GamepadState::LeftThumbstickX, &WindowsGamingInput::GamepadState::LeftThumbstickY,
+	&WindowsGamingInput::GamepadState::RightThumbstickX, &WindowsGamingInput::GamepadState::RightThumbstickY,
+};
+constexpr size_t kGamepadLanes = std::size(kGamepadAxes);
+constexpr size_t kMaxGamepadBatch = 64; // the poller and GetAllStates handle at most 64 slots
+
+void CompileGamepadProcessing(GamepadRegistry& registry)
 {
-#ifdef _DEBUG
-	std::cout << "OnGamepadRemoved" << std::endl;
-#endif
+	registry.pipeline.reset();
+	if (std::none_of(registry.processing.cbegin(), registry.processing.cend(), [](const auto& processing) { return processing.has_value(); }))
+		return;
 
-	std::unique_lock lock(g_gamepad_mutex);
-	for (size_t i = 0; i < g_gamepads.size(); ++i)
+	auto pipeline = std::make_shared<WindowsGamingInput::AxisPipeline>(0.0, 1.0);
+	for (const auto& processing : registry.processing)
 	{
-		if(g_gamepads[i].Get() == gamepad)
+		if (!processing)
 		{
-			g_gamepads[i].Reset();
-#ifdef _DEBUG
-			std::cout << "OnGamepadRemoved: removed known gamepad from internal list" << std::endl;
-#endif
-			lock.unlock();
+			for (size_t i = 0; i < kGamepadLanes; ++i)
+				pipeline->AddIdentity();
+
+			continue;
+		}
 
-			std::scoped_lock cb_lock(g_cb_mutex);
-			for (const auto& cb : g_callbacks)
+		const auto& axes = processing->axes;
+		pipeline->Add(axes[0]);
+		pipeline->Add(axes[1]);
+		for (size_t i = 2; i < kGamepadLanes; i += 2)
+		{
+			if (i == 2 ? processing->radial_left_stick : processing->radial_right_stick)
+				pipeline->AddStick(axes[i], axes[i + 1]);
+			else
 			{
-				cb(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::Gamepad, i);
+				pipeline->Add(axes[i]);
+				pipeline->Add(axes[i + 1]);
 			}
-			
-			break;
 		}
 	}
-	
-	return S_OK;
+
+	registry.pipeline = std::move(pipeline);
 }
-#pragma endregion
 
-#pragma region RawGameController
-IRawGameControllerStatics* g_rcontroller_statics = nullptr;
-using RControllerPtr = ComPtr<IRawGameController>;
+// runs the axes of the slots [first, first + count) through the pipeline in one batch, state(i) returns the reading of slot i
+template<typename F>
+void ProcessGamepads(const GamepadRegistry& registry, size_t first, size_t count, F&& state)
+{
+	if (!registry.pipeline)
+		return;
 
-struct wstring_hash
+	const size_t slots = registry.pipeline->GetLaneCount() / kGamepadLanes;
+	count = std::min({ count, slots - std::min(first, slots), kMaxGamepadBatch });
+
+	double values[kMaxGamepadBatch * kGamepadLanes];
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto& reading = state(first + i);
+		for (size_t j = 0; j < kGamepadLanes; ++j)
+			values[i * kGamepadLanes + j] = reading.*kGamepadAxes[j];
+	}
+
+	registry.pipeline->Process(values, first * kGamepadLanes, count * kGamepadLanes);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& reading = state(first + i);
+		for (size_t j = 0; j < kGamepadLanes; ++j)
+			reading.*kGamepadAxes[j] = values[i * kGamepadLanes + j];
+	}
+}
+
+// expects g_gamepad_mutex to be held, returns false if the gamepad is already known
+bool InsertGamepad(const void* key, GamepadPtr gamepad, size_t& index)
 {
-	using is_transparent = void;
-	using key_equal = std::equal_to<>;
-	using hash_type = std::hash<std::wstring_view>;
-	size_t operator()(std::wstring_view str) const { return hash_type{}(str); }
-	size_t operator()(const std::wstring& str) const { return hash_type{}(str); }
-	size_t operator()(const wchar_t* str) const { return hash_type{}(str); }
+	if (g_gamepad_slots.contains(key))
+		return false;
+
+	index = g_gamepad_allocator.Allocate();
+	g_gamepad_slots.emplace(key, index);
+
+	auto registry = std::make_shared<GamepadRegistry>(*g_gamepad_registry.Load());
+	if (index >= registry->gamepads.size())
+	{
+		registry->gamepads.resize(index + 1);
+		registry->generations.resize(index + 1);
+		registry->status.resize(index + 1);
+		registry->clocks.resize(index + 1);
+	}
+
+	registry->gamepads[index] = std::move(gamepad);
+	registry->status[index] = std::make_shared<WindowsGamingInput::StatusCache>();
+	registry->clocks[index] = std::make_shared<WindowsGamingInput::ClockCorrelation>();
+	registry->generations[index] = g_gamepad_allocator.GetGeneration(index);
+	g_gamepad_registry.Publish(std::move(registry));
+	return true;
+}
+
+// expects g_gamepad_mutex to be held
+bool EraseGamepad(const void* key, size_t& index)
+{
+	const auto it = g_gamepad_slots.find(key);
+	if (it == g_gamepad_slots.cend())
+		return false;
+
+	index = it->second;
+	g_gamepad_slots.erase(it);
+	g_gamepad_allocator.Release(index);
+
+	auto registry = std::make_shared<GamepadRegistry>(*g_gamepad_registry.Load());
+	g_vibration_worker.Remove(registry->gamepads[index].get());
+	registry->gamepads[index].reset();
+	registry->generations[index] = 0;
+	registry->status[index].reset();
+	registry->clocks[index].reset();
+	if (index < registry->processing.size() && registry->processing[index])
+	{
+		registry->processing[index].reset();
+		CompileGamepadProcessing(*registry);
+	}
+	g_gamepad_registry.Publish(std::move(registry));
+	return true;
+}
+
+// host clock of GetHostTime and the poll scheduler
+uint64_t GetSteadyMicroseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ReadGamepad(size_t index, const GamepadPtr& gamepad, WindowsGamingInput::ClockCorrelation& clock, WindowsGamingInput::GamepadState& state)
+{
+	bool result;
+	if (Instrumentation::ShouldSample())
+	{
+		const auto start = std::chrono::steady_clock::now();
+		result = gamepad->GetReading(state);
+		g_gamepad_reading_latency.Record(Instrumentation::ElapsedNs(start));
+	}
+	else
+		result = gamepad->GetReading(state);
+
+	if (!result)
+		return false;
+
+	if (clock.IsNew(state.Timestamp))
+		clock.Sync(state.Timestamp, GetSteadyMicroseconds());
+
+	if (g_recorder.IsRecording())
+		g_recorder.GamepadReading(index, state);
+
+	return true;
+}
+
+// published by the poller thread, read wait-free by Gamepad::GetState
+struct GamepadSnapshot
+{
+	WindowsGamingInput::GamepadState state;
+	bool connected;
 };
 
-std::unordered_map<std::wstring, RControllerPtr, wstring_hash, wstring_hash::key_equal> g_rcontrollers;
-std::shared_mutex g_rcontroller_mutex;
+constexpr size_t kMaxPolledGamepads = 64;
+std::array<SeqLock<GamepadSnapshot>, kMaxPolledGamepads> g_gamepad_snapshots;
+std::atomic_size_t g_gamepad_snapshot_count = 0;
+std::atomic_bool g_gamepad_polling = false;
+
+// all gamepads of one poll in a single seqlock, GetAllPackedStates copies 16 bytes per gamepad and sees no mix of polls
+struct PackedGamepadFrame
+{
+	uint64_t timestamp;
+	uint64_t connected;
+	size_t count;
+	WindowsGamingInput::PackedGamepadState states[kMaxPolledGamepads];
+};
+SeqLock<PackedGamepadFrame> g_gamepad_packed_frame;
 
-// https://docs.microsoft.com/en-us/uwp/api/windows.devices.haptics.knownsimplehapticscontrollerwaveforms
-// ABI::Windows::Devices::Haptics::IKnownSimpleHapticsControllerWaveformsStatics::get_RumbleContinuous()
-constexpr uint16_t kRumbleContinuous = 0x1005;
+// poller side state for change events
+struct PolledGamepad
+{
+	WindowsGamingInput::GamepadState state;
+	uint32_t generation;
+};
+std::array<PolledGamepad, kMaxPolledGamepads> g_polled_gamepads{};
 
-void ScanRawGameControllers()
+// last raw reading of every slot, adaptive polling reuses it for slots which aren't due
+struct PolledReading
 {
-	ComPtr<IVectorView<RawGameController*>> controllers;
-	auto hr = g_rcontroller_statics->get_RawGameControllers(&controllers);
-	assert(SUCCEEDED(hr));
+	WindowsGamingInput::GamepadState state;
+	uint32_t generation;
+	bool connected;
+};
+std::array<PolledReading, kMaxPolledGamepads> g_polled_readings{};
 
-	uint32_t count;
-	hr = controllers->get_Size(&count);
-	assert(SUCCEEDED(hr));
+WindowsGamingInput::PollScheduler g_poll_scheduler; // learns the report rates in both modes, decides the reads while adaptive
+std::atomic_bool g_adaptive_polling = false;
 
-#ifdef _DEBUG
-	std::cout << count << " controllers are connected" << std::endl;
-#endif
+using GamepadChanges = SpscRing<WindowsGamingInput::GamepadChange>;
+std::shared_ptr<GamepadChanges> g_gamepad_changes; // poller is the producer, PopChanges the consumer
+std::mutex g_gamepad_changes_mutex;
+std::atomic_uint64_t g_gamepad_changes_dropped = 0;
+
+std::mutex g_poller_control_mutex; // serializes StartPolling/StopPolling
+std::mutex g_poller_mutex;
+std::condition_variable g_poller_cv;
+std::thread g_poller;
+std::chrono::nanoseconds g_poll_interval{};
+bool g_poller_stop = false;
+
+void QueueGamepadChange(GamepadChanges& changes, size_t index, uint32_t generation, const WindowsGamingInput::GamepadState& previous, const WindowsGamingInput::GamepadState& current)
+{
+	const double previous_axes[] = { previous.LeftTrigger, previous.RightTrigger, previous.LeftThumbstickX, previous.LeftThumbstickY, previous.RightThumbstickX, previous.RightThumbstickY };
+	const double current_axes[] = { current.LeftTrigger, current.RightTrigger, current.LeftThumbstickX, current.LeftThumbstickY, current.RightThumbstickX, current.RightThumbstickY };
 
-	// check for all connected controllers
-	for (uint32_t i = 0; i < count; ++i)
+	WindowsGamingInput::GamepadChange change{};
+	change.ChangedButtons = previous.Buttons ^ current.Buttons;
+	for (size_t i = 0; i < std::size(current_axes); ++i)
 	{
-		ComPtr<IRawGameController> controller;
-		hr = controllers->GetAt(i, &controller);
-		assert(SUCCEEDED(hr));
+		change.Axes[i] = (float)current_axes[i];
+		if (previous_axes[i] != current_axes[i])
+			change.ChangedAxes |= (WindowsGamingInput::GamepadAxis)(1u << i);
+	}
 
-		ComPtr<IRawGameController2> controller2;
-		hr = controller.As(&controller2);
-		if (FAILED(hr)) // I guess shouldn't fail, idk (?)
-			continue;
+	if (change.ChangedButtons == WindowsGamingInput::GamepadButtons::None && change.ChangedAxes == WindowsGamingInput::GamepadAxis::None)
+		return;
 
-		HSTRING tmp_name;
-		hr = controller2->get_NonRoamableId(&tmp_name);
-		if (FAILED(hr))
-			continue;
+	change.Timestamp = current.Timestamp;
+	change.Index = (uint32_t)index;
+	change.Generation = generation;
+	change.Buttons = current.Buttons;
+	if (!changes.Push(change))
+		++g_gamepad_changes_dropped;
+}
 
-		std::wstring name = WindowsGetStringRawBuffer(tmp_name, nullptr);
-		if (name.empty())
-			continue;
+void PollGamepads(GamepadChanges* changes)
+{
+	const auto registry = g_gamepad_registry.Get();
+	const size_t count = std::min(registry->gamepads.size(), kMaxPolledGamepads);
 
-		std::unique_lock lock(g_rcontroller_mutex);
-		if (!g_rcontrollers.contains(name))
+	const bool adaptive = g_adaptive_polling;
+	const uint64_t now = GetSteadyMicroseconds();
+
+	GamepadSnapshot snapshots[kMaxPolledGamepads];
+	for (size_t i = 0; i < count; ++i)
+	{
+		snapshots[i] = {};
+		const auto& gamepad = registry->gamepads[i];
+		auto& reading = g_polled_readings[i];
+		if (!gamepad || reading.generation != registry->generations[i])
 		{
-			g_rcontrollers.emplace(name, controller);
-			lock.unlock();
-#ifdef _DEBUG
-			std::wcout << L"inserted new controller with uid: " << name << std::endl;
-#endif
+			reading = { {}, registry->generations[i], false };
+			g_poll_scheduler.Reset(i);
+		}
 
-			std::scoped_lock cb_lock(g_cb_mutex);
-			for (const auto& cb : g_callbacks)
-			{
-				cb(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::RawController, name);
-			}
+		if (!gamepad)
+			continue;
+
+		if (!adaptive || g_poll_scheduler.IsDue(i, now))
+		{
+			reading.connected = ReadGamepad(i, gamepad, *registry->clocks[i], reading.state);
+			g_poll_scheduler.Update(i, now, reading.connected ? reading.state.Timestamp : 0);
 		}
+
+		snapshots[i] = { reading.state, reading.connected };
 	}
-}
 
-EventRegistrationToken g_add_rcontroller_token{};
+	ProcessGamepads(*registry, 0, count, [&snapshots](size_t i) -> WindowsGamingInput::GamepadState& { return snapshots[i].state; });
 
-HRESULT OnRawGameControllerAdded(IInspectable* sender, IRawGameController* controller)
-{
-#ifdef _DEBUG
-	std::cout << "OnRawGameControllerAdded" << std::endl;
-#endif
+	PackedGamepadFrame frame{};
+	frame.count = count;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (snapshots[i].connected)
+		{
+			frame.timestamp = std::max(frame.timestamp, snapshots[i].state.Timestamp);
+			frame.connected |= 1ull << i;
+		}
+	}
 
-	ComPtr<IRawGameController2> controller2;
-	HRESULT hr = controller->QueryInterface(__uuidof(IRawGameController2), &controller2);
-	if (SUCCEEDED(hr))
+	bool input = false; // any new reading, the waiters only need to look then
+	for (size_t i = 0; i < count; ++i)
 	{
-		HSTRING tmp_name;
-		hr = controller2->get_NonRoamableId(&tmp_name);
-		if (SUCCEEDED(hr))
+		const auto& snapshot = snapshots[i];
+		g_gamepad_snapshots[i].Store(snapshot);
+
+		if (!snapshot.connected)
+			continue;
+
+		frame.states[i] = WindowsGamingInput::PackGamepadState(snapshot.state, frame.timestamp);
+
+		// a different gamepad in this slot is diffed against the neutral state
+		auto& polled = g_polled_gamepads[i];
+		if (polled.generation != registry->generations[i])
+			polled = { {}, registry->generations[i] };
+
+		if (polled.state.Timestamp != snapshot.state.Timestamp)
 		{
-			const std::wstring name = WindowsGetStringRawBuffer(tmp_name, nullptr);
-			std::unique_lock lock(g_rcontroller_mutex);
-			if (!g_rcontrollers.contains(name))
-			{
-				g_rcontrollers.emplace(name, controller);
-#ifdef _DEBUG
-				std::wcout << L"OnRawGameControllerAdded: added new controller with uid: " << name << std::endl;
-#endif
-				lock.unlock();
-				
-				std::scoped_lock cb_lock(g_cb_mutex);
-				for (const auto& cb : g_callbacks)
-				{
-					cb(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::RawController, name);
-				}
-			}
+			input = true;
+			if (changes)
+				QueueGamepadChange(*changes, i, polled.generation, polled.state, snapshot.state);
 		}
+
+		polled.state = snapshot.state;
 	}
-	
-	return S_OK;
-}
 
-EventRegistrationToken g_remove_rcontroller_token{};
+	g_gamepad_packed_frame.Store(frame);
+	g_gamepad_snapshot_count = count;
 
-HRESULT OnRawGameControllerRemoved(IInspectable* sender, IRawGameController* controller)
+	if (input)
+		WakeInputWaiters(false);
+}
+
+void GamepadPollerThread()
 {
-#ifdef _DEBUG
-	std::cout << "OnRawGameControllerRemoved" << std::endl;
-#endif
+	auto next = std::chrono::steady_clock::now();
 
-	ComPtr<IRawGameController2> controller2;
-	HRESULT hr = controller->QueryInterface(IID_PPV_ARGS(&controller2));
-	if (SUCCEEDED(hr))
+	std::unique_lock lock(g_poller_mutex);
+	while (!g_poller_stop)
 	{
-		HSTRING tmp_name;
-		hr = controller2->get_NonRoamableId(&tmp_name);
-		if (SUCCEEDED(hr))
+		const auto now = std::chrono::steady_clock::now();
+		if (g_adaptive_polling)
+			next = std::max(now, std::chrono::steady_clock::time_point(std::chrono::microseconds(g_poll_scheduler.NextDue(GetSteadyMicroseconds()))));
+		else
 		{
-			const std::wstring name = WindowsGetStringRawBuffer(tmp_name, nullptr);
+			next += g_poll_interval;
+			if (next < now) // we fell behind, don't try to catch up
+				next = now;
+		}
 
-			std::unique_lock lock(g_rcontroller_mutex);
-			const auto erased = g_rcontrollers.erase(name) == 1;
-			lock.unlock();
-#ifdef _DEBUG
-			std::cout << "OnRawGameControllerRemoved: removed known controller: " << erased << std::endl;
-#endif
-			
-			std::scoped_lock cb_lock(g_cb_mutex);
-			for (const auto& cb : g_callbacks)
-			{
-				cb(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::RawController, name);
-			}
+		if (g_poller_cv.wait_until(lock, next, [] { return g_poller_stop; }))
+			break;
+
+		lock.unlock();
+		std::shared_ptr<GamepadChanges> changes;
+		{
+			const auto changes_lock = g_changes_lock_stats.Lock(g_gamepad_changes_mutex);
+			changes = g_gamepad_changes;
 		}
+
+		PollGamepads(changes.get());
+		lock.lock();
 	}
-	
-	return S_OK;
 }
-#pragma endregion
 
-BOOL WINAPI DllMain(HINSTANCE hinstance, DWORD reason, LPVOID reserved)
+// polled snapshot if the poller runs, otherwise a fresh reading of the gamepad in registry
+bool GetGamepadState(const GamepadRegistry& registry, size_t index, WindowsGamingInput::GamepadState& state)
 {
-	if (reason == DLL_PROCESS_ATTACH)
+	if (g_gamepad_polling && index < kMaxPolledGamepads)
 	{
-		std::thread([]()
-		{
-			if (!g_gamepad_statics)
-			{
-				auto hr = RoGetActivationFactory(HStringReference(L"Windows.Gaming.Input.Gamepad").Get(),
-				                                 __uuidof(IGamepadStatics), (void**)&g_gamepad_statics);
-				if (SUCCEEDED(hr) && g_gamepad_statics)
-				{
+		const auto snapshot = g_gamepad_snapshots[index].Load();
+		if (!snapshot.connected)
+			return false;
 
-					hr = g_gamepad_statics->add_GamepadAdded(
-						Callback<__FIEventHandler_1_Windows__CGaming__CInput__CGamepad>(OnGamepadAdded).Get(),
-						&g_add_gamepad_token);
-					assert(SUCCEEDED(hr));
+		state = snapshot.state;
+		return true;
+	}
 
-					hr = g_gamepad_statics->add_GamepadRemoved(
-						Callback<__FIEventHandler_1_Windows__CGaming__CInput__CGamepad>(OnGamepadRemoved).Get(),
-						&g_remove_gamepad_token);
-					assert(SUCCEEDED(hr));
+	const auto& gamepad = registry.Find(index);
+	if (!gamepad || !ReadGamepad(index, gamepad, *registry.clocks[index], state))
+		return false;
 
-#ifdef _DEBUG
-					std::cout << "Windows.Gaming.Input.Gamepad initialized" << std::endl;
-#endif
-				}
-				else
-				{
-#ifdef _DEBUG
-					std::cout << "Windows.Gaming.Input.Gamepad init failed: 0x" << std::hex << (uintptr_t)hr << std::endl;
-#endif
-				}
-			}
+	ProcessGamepads(registry, index, 1, [&state](size_t) -> WindowsGamingInput::GamepadState& { return state; });
+	return true;
+}
 
-			if(g_gamepad_statics)
-				ScanGamepads();
-			
-			if (!g_rcontroller_statics)
-			{
-				auto hr = RoGetActivationFactory(HStringReference(L"Windows.Gaming.Input.RawGameController").Get(),
-				                                 __uuidof(IRawGameControllerStatics), (void**)&g_rcontroller_statics);
-				if (SUCCEEDED(hr) && g_rcontroller_statics)
-				{
-					hr = g_rcontroller_statics->add_RawGameControllerAdded(
-						Callback<__FIEventHandler_1_Windows__CGaming__CInput__CRawGameController>(OnRawGameControllerAdded).
-						Get(),
-						&g_add_rcontroller_token);
-					assert(SUCCEEDED(hr));
-
-					hr = g_rcontroller_statics->add_RawGameControllerRemoved(
-						Callback<__FIEventHandler_1_Windows__CGaming__CInput__CRawGameController>(
-							OnRawGameControllerRemoved).Get(),
-						&g_remove_rcontroller_token);
-					assert(SUCCEEDED(hr));
+bool GetGamepadState(size_t index, WindowsGamingInput::GamepadState& state)
+{
+	return GetGamepadState(*g_gamepad_registry.Get(), index, state);
+}
 
-#ifdef _DEBUG
-					std::cout << "Windows.Gaming.Input.RawGameController initialized" << std::endl;
-#endif
-				}
-				else
-				{
-#ifdef _DEBUG
-					std::cout << "Windows.Gaming.Input.RawGameController init failed: 0x" << std::hex << (uintptr_t)hr << std::endl;
-#endif
-				}
-			}
+// times a sample of the readings returned by GetState and GetPackedState
+void ObserveGamepadReading(size_t index, uint64_t timestamp)
+{
+	if (!Instrumentation::ShouldSample())
+		return;
 
-			if(g_rcontroller_statics)
-				ScanRawGameControllers();
-		}).detach();
-	}
-	else if (reason == DLL_PROCESS_DETACH)
-	{
-		// callbacks detach
-		{
-			std::scoped_lock lock(g_cb_mutex);
-			g_callbacks.clear();
-		}
-				
-		// gamepad detach
-		{
-			std::scoped_lock lock(g_gamepad_mutex);
-			g_gamepads.clear();
-			if (g_gamepad_statics)
-			{
-				if(g_add_gamepad_token.value)
-					g_gamepad_statics->remove_GamepadAdded(g_add_gamepad_token);
+	const auto registry = g_gamepad_registry.Get();
+	if (index < registry->clocks.size() && registry->clocks[index])
+		registry->clocks[index]->Observe(timestamp, GetSteadyMicroseconds());
+}
 
-				if(g_remove_gamepad_token.value)
-					g_gamepad_statics->remove_GamepadRemoved(g_remove_gamepad_token);
-			}
-		}
-		
+// same for the first count slots, bit i of connected is set if states[i] is valid, the other states are zeroed
+size_t GetAllGamepadStates(WindowsGamingInput::GamepadState* states, size_t count, uint64_t& connected)
+{
+	connected = 0;
+	count = std::min(count, kMaxPolledGamepads); // one bit per slot in connected
 
-		// raw game controller detach
+	if (g_gamepad_polling)
+	{
+		count = std::min(count, g_gamepad_snapshot_count.load());
+		for (size_t i = 0; i < count; ++i)
 		{
-			std::scoped_lock lock(g_rcontroller_mutex);
-			g_rcontrollers.clear();
-			if (g_rcontroller_statics)
+			const auto snapshot = g_gamepad_snapshots[i].Load();
+			if (!snapshot.connected)
 			{
-				if(g_add_rcontroller_token.value)
-					g_rcontroller_statics->remove_RawGameControllerAdded(g_add_rcontroller_token);
-				
-				if(g_remove_rcontroller_token.value)
-					g_rcontroller_statics->remove_RawGameControllerRemoved(g_remove_rcontroller_token);
+				states[i] = {};
+				continue;
 			}
+
+			states[i] = snapshot.state;
+			connected |= 1ull << i;
 		}
+
+		return count;
+	}
+
+	const auto registry = g_gamepad_registry.Get();
+	count = std::min(count, registry->gamepads.size());
+	for (size_t i = 0; i < count; ++i)
+	{
+		// the pipeline runs over every slot, so disconnected ones get a zeroed state instead of whatever the caller passed in
+		const auto& gamepad = registry->gamepads[i];
+		if (gamepad && ReadGamepad(i, gamepad, *registry->clocks[i], states[i]))
+			connected |= 1ull << i;
+		else
+			states[i] = {};
 	}
 
-	return TRUE;
+	ProcessGamepads(*registry, 0, count, [states](size_t i) -> WindowsGamingInput::GamepadState& { return states[i]; });
+	return count;
 }
+#pragma endregion
 
-namespace WindowsGamingInput
+#pragma region RawGameController
+std::atomic_bool g_rcontroller_initialized = false;
+
+struct wstring_hash
 {
-	void AddControllerChanged(ControllerChanged_t cb)
+	using is_transparent = void;
+	using key_equal = std::equal_to<>;
+	using hash_type = std::hash<std::wstring_view>;
+	size_t operator()(std::wstring_view str) const { return hash_type{}(str); }
+	size_t operator()(const std::wstring& str) const { return hash_type{}(str); }
+	size_t operator()(const wchar_t* str) const { return hash_type{}(str); }
+};
+
+struct RController
+{
+	Backend::RawControllerDevicePtr device;
+	WindowsGamingInput::RawController::Description description;
+	WindowsGamingInput::RawController::Handle handle; // generation << 32 | slot, assigned by InsertRController
+	std::shared_ptr<const WindowsGamingInput::AxisPipeline> processing; // nullptr if not set
+	std::shared_ptr<WindowsGamingInput::StatusCache> status;
+	std::shared_ptr<WindowsGamingInput::ClockCorrelation> clock;
+	WindowsGamingInput::RawController::Capabilities capabilities;
+	std::shared_ptr<WindowsGamingInput::ButtonLabel[]> button_labels; // capabilities.button_count entries
+};
+
+using RControllerEntry = std::shared_ptr<const RController>;
+
+// immutable, republished on every raw controller hot-plug
+struct RControllerRegistry
+{
+	std::vector<RControllerEntry> slots; // indexed by the slot part of the handle
+	std::unordered_map<std::wstring, size_t, wstring_hash, wstring_hash::key_equal> uids; // uid -> slot
+	std::vector<WindowsGamingInput::RawController::Description> descriptions; // all connected controllers in slot order
+	uint64_t version = 1;
+
+	const RController* Find(WindowsGamingInput::RawController::Handle handle) const
 	{
-		std::scoped_lock lock(g_cb_mutex);
-		if(std::ranges::find(std::as_const(g_callbacks), cb) == g_callbacks.cend())
-			g_callbacks.emplace_back(cb);
+		const size_t slot = (uint32_t)handle;
+		if (slot >= slots.size() || !slots[slot] || slots[slot]->handle != handle)
+			return nullptr;
+
+		return slots[slot].get();
+	}
+
+	const RController* Find(std::wstring_view uid) const
+	{
+		const auto it = uids.find(uid);
+		return it != uids.cend() ? slots[it->second].get() : nullptr;
+	}
+};
+
+Snapshot<RControllerRegistry> g_rcontroller_registry;
+
+// writer side, guarded by g_rcontroller_mutex
+SlotAllocator g_rcontroller_allocator;
+std::mutex g_rcontroller_mutex;
+
+// expects g_rcontroller_mutex to be held
+void PublishRControllers(std::shared_ptr<RControllerRegistry> registry)
+{
+	registry->descriptions.clear();
+	for (const auto& entry : registry->slots)
+	{
+		if (entry)
+			registry->descriptions.emplace_back(entry->description);
+	}
+
+	++registry->version;
+	g_rcontroller_registry.Publish(std::move(registry));
+}
+
+// expects g_rcontroller_mutex to be held, returns false if the uid is already known
+bool InsertRController(std::wstring_view uid, RController controller, WindowsGamingInput::RawController::Handle& handle)
+{
+	const auto current = g_rcontroller_registry.Load();
+	if (current->uids.contains(uid))
+		return false;
+
+	const size_t slot = g_rcontroller_allocator.Allocate();
+	controller.handle = (uint64_t)g_rcontroller_allocator.GetGeneration(slot) << 32 | slot;
+	handle = controller.handle;
+
+	auto registry = std::make_shared<RControllerRegistry>(*current);
+	if (slot >= registry->slots.size())
+		registry->slots.resize(slot + 1);
+
+	registry->slots[slot] = std::make_shared<const RController>(std::move(controller));
+	registry->uids.emplace(uid, slot);
+	PublishRControllers(std::move(registry));
+	return true;
+}
+
+// expects g_rcontroller_mutex to be held
+bool EraseRController(std::wstring_view uid, WindowsGamingInput::RawController::Handle& handle)
+{
+	const auto current = g_rcontroller_registry.Load();
+	const auto it = current->uids.find(uid);
+	if (it == current->uids.cend())
+		return false;
+
+	const size_t slot = it->second;
+	handle = current->slots[slot]->handle;
+	g_rcontroller_allocator.Release(slot);
+	g_vibration_worker.Remove(current->slots[slot]->device.get());
+
+	auto registry = std::make_shared<RControllerRegistry>(*current);
+	registry->slots[slot].reset();
+	registry->uids.erase(registry->uids.find(uid));
+	PublishRControllers(std::move(registry));
+	return true;
+}
+
+bool ReadRController(const RController& controller, WindowsGamingInput::RawController::State& state)
+{
+	bool result;
+	if (Instrumentation::ShouldSample())
+	{
+		const auto start = std::chrono::steady_clock::now();
+		result = controller.device->GetReading(state);
+		g_rcontroller_reading_latency.Record(Instrumentation::ElapsedNs(start));
+	}
+	else
+		result = controller.device->GetReading(state);
+
+	if (!result)
+		return false;
+
+	if (controller.clock->IsNew(state.timestamp))
+		controller.clock->Sync(state.timestamp, GetSteadyMicroseconds());
+
+	if (g_recorder.IsRecording())
+		g_recorder.RawControllerReading(controller.handle, state);
+
+	if (controller.processing)
+		controller.processing->Process(state.axis, 0, state.axis_count);
+
+	return true;
+}
+
+// entries GetAllStates couldn't read are zeroed like disconnected gamepad slots
+void ClearRControllerState(WindowsGamingInput::RawController::State& state)
+{
+	std::fill_n(state.buttons, state.button_count, false);
+	std::fill_n(state.switches, state.switch_count, WindowsGamingInput::SwitchPosition::Center);
+	std::fill_n(state.axis, state.axis_count, 0.0);
+	state.timestamp = 0;
+}
+
+// everything was resolved in OnRawControllerAdded, none of these call the device
+bool GetRControllerCapabilities(const RController* controller, WindowsGamingInput::RawController::Capabilities& capabilities, WindowsGamingInput::ButtonLabel* labels, size_t label_count)
+{
+	if (!controller)
+		return false;
+
+	capabilities = controller->capabilities;
+	if (labels)
+		std::copy_n(controller->button_labels.get(), std::min(label_count, capabilities.button_count), labels);
+
+	return true;
+}
+
+bool GetRControllerButtonLabel(const RController* controller, size_t button, WindowsGamingInput::ButtonLabel& label)
+{
+	if (!controller || button >= controller->capabilities.button_count)
+		return false;
+
+	label = controller->button_labels[button];
+	return true;
+}
+
+bool GetRControllerState(const RController* controller, bool* buttons, size_t button_count, WindowsGamingInput::SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+{
+	if (!controller)
+		return false;
+
+	WindowsGamingInput::RawController::State state{ buttons, button_count, switches, switch_count, axis, axis_count };
+	if (!ReadRController(*controller, state))
+		return false;
+
+	if (Instrumentation::ShouldSample())
+		controller->clock->Observe(state.timestamp, GetSteadyMicroseconds());
+
+	timestamp = state.timestamp;
+	return true;
+}
+
+bool GetPackedRControllerState(const RController* controller, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, WindowsGamingInput::SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+{
+	if (!controller)
+		return false;
+
+	// the device is always read with its full button count, winrt rejects smaller arrays
+	thread_local std::vector<uint8_t> scratch;
+	const size_t button_count = controller->description.button_count;
+	scratch.resize(button_count);
+
+	WindowsGamingInput::RawController::State state{ reinterpret_cast<bool*>(scratch.data()), button_count, switches, switch_count, axis, axis_count };
+	if (!ReadRController(*controller, state))
+		return false;
+
+	const size_t words = (button_count + 63) / 64;
+	const size_t packed = std::min(word_count, words);
+	PackBools(state.buttons, std::min(button_count, packed * 64), buttons);
+	std::fill(buttons + packed, buttons + word_count, 0);
+
+	// the previous buttons belong to the caller, so every reader sees all edges since its own last call
+	if (changed)
+	{
+		for (size_t i = 0; i < word_count; ++i)
+			changed[i] = (previous ? previous[i] : 0) ^ buttons[i];
+	}
+
+	if (previous)
+		std::copy_n(buttons, word_count, previous);
+
+	if (Instrumentation::ShouldSample())
+		controller->clock->Observe(state.timestamp, GetSteadyMicroseconds());
+
+	timestamp = state.timestamp;
+	return true;
+}
+
+// raw axes are processed in stick units, raw 0 .. 1 is -1 .. 1, so the AxisProcessing defaults leave them unchanged
+WindowsGamingInput::AxisProcessing ToRawAxisUnits(const WindowsGamingInput::AxisProcessing& axis)
+{
+	auto result = axis;
+	result.min = (axis.min + 1) / 2;
+	result.center = (axis.center + 1) / 2;
+	result.max = (axis.max + 1) / 2;
+	return result;
+}
+
+// replaces the entry of the controller with a copy using the new processing, its handle stays the same
+template<typename Key>
+bool SetRControllerProcessing(Key key, const WindowsGamingInput::AxisProcessing* axes, size_t count, uint64_t radial_sticks)
+{
+	std::shared_ptr<WindowsGamingInput::AxisPipeline> pipeline;
+	if (count != 0)
+	{
+		pipeline = std::make_shared<WindowsGamingInput::AxisPipeline>(0.5, 0.5); // raw axes are 0 .. 1
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (i % 2 == 0 && i + 1 < count && i / 2 < 64 && (radial_sticks >> (i / 2)) & 1)
+			{
+				pipeline->AddStick(ToRawAxisUnits(axes[i]), ToRawAxisUnits(axes[i + 1]));
+				++i;
+			}
+			else
+				pipeline->Add(ToRawAxisUnits(axes[i]));
+		}
+	}
+
+	const auto lock = g_rcontroller_lock_stats.Lock(g_rcontroller_mutex);
+	const auto current = g_rcontroller_registry.Load();
+	const auto* controller = current->Find(key);
+	if (!controller)
+		return false;
+
+	auto entry = std::make_shared<RController>(*controller);
+	entry->processing = std::move(pipeline);
+
+	auto registry = std::make_shared<RControllerRegistry>(*current);
+	registry->slots[(uint32_t)controller->handle] = std::move(entry);
+	g_rcontroller_registry.Publish(std::move(registry)); // same controllers, so no new version
+	return true;
+}
+
+bool SetRControllerVibration(const RController* controller, double vibration)
+{
+	if (!controller)
+		return false;
+
+	g_vibration_worker.Cancel(controller->device.get());
+	const auto start = std::chrono::steady_clock::now();
+	const bool result = controller->device->SetVibration(vibration);
+	g_rcontroller_vibration_latency.Record(Instrumentation::ElapsedNs(start));
+	return result;
+}
+
+bool SubmitRControllerVibration(const RController* controller, double vibration)
+{
+	if (!controller)
+		return false;
+
+	g_vibration_worker.Submit(controller->device, vibration);
+	return true;
+}
+
+bool PlayRControllerEffect(const RController* controller, const WindowsGamingInput::VibrationEffect& effect)
+{
+	if (!controller)
+		return false;
+
+	g_vibration_worker.Play(controller->device, effect);
+	return true;
+}
+
+bool StopRControllerEffect(const RController* controller)
+{
+	if (!controller)
+		return false;
+
+	g_vibration_worker.StopEffect(controller->device.get());
+	return true;
+}
+#pragma endregion
+
+#pragma region Status
+// refreshes the StatusCache of every device, IsWireless and GetBatteryStatus read the caches unless the interval is 0
+std::atomic_uint32_t g_status_interval = 2000; // ms
+std::atomic_bool g_status_started = false;
+std::mutex g_status_mutex;
+std::condition_variable g_status_cv;
+std::thread g_status_refresher;
+bool g_status_stop = false;
+bool g_status_wake = false; // new devices or interval
+
+std::mutex g_status_cb_mutex;
+std::vector<WindowsGamingInput::StatusChanged_t> g_status_callbacks;
+
+void RefreshStatus()
+{
+	struct Change
+	{
+		WindowsGamingInput::ControllerType controller;
+		std::variant<size_t, std::wstring> uid;
+		WindowsGamingInput::DeviceStatus status;
+	};
+	std::vector<Change> changes;
+
+	const auto to_device_status = [](const WindowsGamingInput::StatusCache::Status& status) -> WindowsGamingInput::DeviceStatus
+	{
+		return { status.wireless, status.battery_valid, status.battery_status, status.battery };
+	};
+
+	// Load instead of Get, the thread local cache would keep removed devices alive until the next pass
+	WindowsGamingInput::StatusCache::Status status;
+	const auto gamepads = g_gamepad_registry.Load();
+	for (size_t i = 0; i < gamepads->gamepads.size(); ++i)
+	{
+		if (gamepads->gamepads[i] && gamepads->status[i]->Refresh(*gamepads->gamepads[i], status))
+			changes.emplace_back(WindowsGamingInput::ControllerType::Gamepad, i, to_device_status(status));
+	}
+
+	const auto controllers = g_rcontroller_registry.Load();
+	for (const auto& controller : controllers->slots)
+	{
+		if (controller && controller->status->Refresh(*controller->device, status))
+			changes.emplace_back(WindowsGamingInput::ControllerType::RawController, std::wstring(controller->description.uid), to_device_status(status));
+	}
+
+	if (changes.empty())
+		return;
+
+	std::scoped_lock lock(g_status_cb_mutex);
+	for (const auto& change : changes)
+	{
+		const auto uid = std::visit([](const auto& value) { return std::variant<size_t, std::wstring_view>{ value }; }, change.uid);
+		for (const auto& cb : g_status_callbacks)
+		{
+			cb(change.controller, uid, change.status);
+		}
+	}
+}
+
+void StatusRefreshThread()
+{
+	std::unique_lock lock(g_status_mutex);
+	while (true)
+	{
+		g_status_wake = false;
+		if (g_status_interval != 0)
+		{
+			lock.unlock();
+			RefreshStatus();
+			lock.lock();
+		}
+
+		const auto wake = [] { return g_status_stop || g_status_wake; };
+		if (g_status_interval == 0)
+			g_status_cv.wait(lock, wake);
+		else
+			g_status_cv.wait_for(lock, std::chrono::milliseconds(g_status_interval.load()), wake);
+
+		if (g_status_stop)
+			break;
+	}
+}
+
+// the refresh thread starts with the first cached read or status callback
+void StartStatusRefresh()
+{
+	if (g_status_started.load(std::memory_order_relaxed))
+		return;
+
+	std::scoped_lock lock(g_status_mutex);
+	if (!g_status_refresher.joinable() && !g_status_stop)
+		g_status_refresher = std::thread(StatusRefreshThread);
+
+	g_status_started = true;
+}
+
+// refresh right away, for new devices and interval changes
+void WakeStatusRefresh()
+{
+	std::scoped_lock lock(g_status_mutex);
+	g_status_wake = true;
+	g_status_cv.notify_one();
+}
+
+// devices which haven't been refreshed yet and a disabled cache go to the device
+template<typename Device>
+bool GetDeviceWireless(Device& device, const WindowsGamingInput::StatusCache& cache, bool& wireless)
+{
+	if (g_status_interval != 0)
+	{
+		StartStatusRefresh();
+		const auto status = cache.Load();
+		if (status.refreshed)
+		{
+			wireless = status.wireless;
+			return status.wireless_valid;
+		}
+	}
+
+	return device.IsWireless(wireless);
+}
+
+template<typename Device>
+bool GetDeviceBatteryStatus(Device& device, const WindowsGamingInput::StatusCache& cache, WindowsGamingInput::BatteryStatus& battery_status, double& battery)
+{
+	if (g_status_interval != 0)
+	{
+		StartStatusRefresh();
+		const auto status = cache.Load();
+		if (status.refreshed)
+		{
+			battery_status = status.battery_status;
+			battery = status.battery;
+			return status.battery_valid;
+		}
+	}
+
+	return device.GetBatteryStatus(battery_status, battery);
+}
+#pragma endregion
+
+#pragma region InputPoll
+// timestamp of the current reading, 0 if the device isn't connected
+uint64_t ReadInputTimestamp(const GamepadRegistry& registry, size_t index)
+{
+	WindowsGamingInput::GamepadState state;
+	const auto& gamepad = registry.Find(index);
+	return gamepad && gamepad->GetReading(state) ? state.Timestamp : 0;
+}
+
+uint64_t ReadInputTimestamp(const RControllerRegistry& registry, WindowsGamingInput::RawController::Handle handle)
+{
+	thread_local std::vector<uint8_t> buttons;
+	thread_local std::vector<WindowsGamingInput::SwitchPosition> switches;
+	thread_local std::vector<double> axis;
+
+	const auto* controller = registry.Find(handle);
+	if (!controller)
+		return 0;
+
+	const auto& capabilities = controller->capabilities;
+	buttons.resize(capabilities.button_count);
+	switches.resize(capabilities.switch_count);
+	axis.resize(capabilities.axis_count);
+
+	WindowsGamingInput::RawController::State state{ reinterpret_cast<bool*>(buttons.data()), buttons.size(), switches.data(), switches.size(), axis.data(), axis.size() };
+	return controller->device->GetReading(state) ? state.timestamp : 0;
+}
+
+// reads the union of the devices all waiters wait on, so the device cost doesn't grow with the number of waiters.
+// the devices are read directly, so waiting doesn't show up in recordings or the reading latency
+void InputPollThread()
+{
+	std::vector<WindowsGamingInput::RawController::Handle> handles;
+	std::vector<uint64_t> timestamps;
+	std::array<uint64_t, 64> gamepad_timestamps;
+
+	std::unique_lock lock(g_input_mutex);
+	while (!g_input_poller_stop)
+	{
+		uint64_t gamepads = 0;
+		handles.clear();
+		for (const auto* wait : g_input_waits)
+		{
+			gamepads |= wait->gamepads;
+			handles.insert(handles.end(), wait->controllers, wait->controllers + wait->count);
+		}
+
+		// the waiters read the poller's snapshots
+		if (g_gamepad_polling)
+			gamepads = 0;
+
+		std::sort(handles.begin(), handles.end());
+		handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+
+		if (gamepads == 0 && handles.empty())
+		{
+			// polling may stop while gamepad waiters are left, so recheck at the interval as long as anyone waits
+			const auto wake = [] { return g_input_poller_stop; };
+			if (g_input_waits.empty())
+				g_input_poller_cv.wait(lock, [] { return g_input_poller_stop || !g_input_waits.empty(); });
+			else
+				g_input_poller_cv.wait_for(lock, kInputWaitInterval, wake);
+			continue;
+		}
+
+		const uint64_t epoch = ++g_input_epoch;
+		lock.unlock();
+
+		const auto gamepad_registry = g_gamepad_registry.Load();
+		for (uint64_t bits = gamepads; bits; bits &= bits - 1)
+		{
+			const size_t index = std::countr_zero(bits);
+			gamepad_timestamps[index] = ReadInputTimestamp(*gamepad_registry, index);
+		}
+
+		const auto rcontroller_registry = g_rcontroller_registry.Load();
+		timestamps.resize(handles.size());
+		for (size_t i = 0; i < handles.size(); ++i)
+			timestamps[i] = ReadInputTimestamp(*rcontroller_registry, handles[i]);
+
+		// waiters only get woken for a new reading, or for the first pass after they registered
+		lock.lock();
+		bool wake = g_input_waits_added;
+		g_input_waits_added = false;
+		for (uint64_t bits = gamepads; bits; bits &= bits - 1)
+		{
+			const size_t index = std::countr_zero(bits);
+			auto& polled = g_input_gamepad_timestamps[index];
+			wake |= polled.timestamp != gamepad_timestamps[index];
+			polled = { gamepad_timestamps[index], epoch };
+		}
+
+		for (size_t i = 0; i < handles.size(); ++i)
+		{
+			auto& polled = g_input_rcontroller_timestamps[handles[i]];
+			wake |= polled.timestamp != timestamps[i];
+			polled = { timestamps[i], epoch };
+		}
+
+		// drops the controllers nobody waits on anymore
+		if (g_input_rcontroller_timestamps.size() != handles.size())
+			std::erase_if(g_input_rcontroller_timestamps, [epoch](const auto& entry) { return entry.second.epoch != epoch; });
+
+		if (wake)
+		{
+			++g_input_polls;
+			g_input_cv.notify_all();
+		}
+		g_input_poller_cv.wait_for(lock, kInputWaitInterval, [] { return g_input_poller_stop; });
+	}
+}
+#pragma endregion
+
+#pragma region SharedState
+// the publisher thread writes every device to the shared memory, see StartPublishing
+std::mutex g_publisher_control_mutex; // serializes StartPublishing/StopPublishing
+std::mutex g_publisher_mutex;
+std::condition_variable g_publisher_cv;
+std::thread g_publisher;
+std::chrono::nanoseconds g_publish_interval{};
+bool g_publisher_stop = false;
+std::unique_ptr<SharedState::Region> g_publisher_region; // guarded by g_publisher_control_mutex
+
+// publisher thread only, the last published values so unchanged slots don't get rewritten
+struct PublishedSlots
+{
+	std::array<uint32_t, SharedState::kGamepadSlots> gamepad_generations{};
+	std::array<uint64_t, SharedState::kGamepadSlots> gamepad_timestamps{};
+	std::array<WindowsGamingInput::RawController::Handle, SharedState::kRawControllerSlots> rcontroller_infos{};
+	std::array<WindowsGamingInput::RawController::Handle, SharedState::kRawControllerSlots> rcontroller_handles{};
+	std::array<uint64_t, SharedState::kRawControllerSlots> rcontroller_timestamps{};
+
+	// the device is always read with its full counts, winrt rejects smaller arrays
+	std::vector<uint8_t> buttons;
+	std::vector<WindowsGamingInput::SwitchPosition> switches;
+	std::vector<double> axis;
+};
+
+void ReadPublishedRController(const RController& controller, PublishedSlots& published, SharedState::RawControllerSlot& slot)
+{
+	const auto& description = controller.description;
+	published.buttons.resize(description.button_count);
+	published.switches.resize(description.switches_count);
+	published.axis.resize(description.axis_count);
+
+	WindowsGamingInput::RawController::State state{ reinterpret_cast<bool*>(published.buttons.data()), description.button_count,
+		published.switches.data(), description.switches_count, published.axis.data(), description.axis_count };
+	if (!ReadRController(controller, state))
+		return;
+
+	slot.handle = controller.handle;
+	slot.timestamp = state.timestamp;
+	PackBools(state.buttons, std::min(state.button_count, SharedState::kMaxButtons), slot.buttons);
+	for (size_t i = 0; i < std::min(state.switch_count, SharedState::kMaxSwitches); ++i)
+		slot.switches[i] = (uint8_t)state.switches[i];
+
+	std::copy_n(state.axis, std::min(state.axis_count, SharedState::kMaxAxes), slot.axis);
+}
+
+void PublishSharedState(SharedState::Layout& layout, PublishedSlots& published)
+{
+	// held for the whole pass, the reads must not see a different registry than the generations
+	const auto gamepads = g_gamepad_registry.Load();
+	for (size_t i = 0; i < SharedState::kGamepadSlots; ++i)
+	{
+		SharedState::GamepadSlot slot{};
+		if (gamepads->Find(i) && GetGamepadState(*gamepads, i, slot.state))
+			slot.generation = gamepads->generations[i];
+
+		if (slot.generation == published.gamepad_generations[i] && slot.state.Timestamp == published.gamepad_timestamps[i])
+			continue;
+
+		layout.gamepads[i].Store(slot);
+		published.gamepad_generations[i] = slot.generation;
+		published.gamepad_timestamps[i] = slot.state.Timestamp;
+	}
+
+	const auto controllers = g_rcontroller_registry.Load();
+	for (size_t i = 0; i < SharedState::kRawControllerSlots; ++i)
+	{
+		const RController* controller = i < controllers->slots.size() ? controllers->slots[i].get() : nullptr;
+
+		// the info goes first, readers look a handle up there before reading its state
+		const auto handle = controller ? controller->handle : WindowsGamingInput::RawController::kInvalidHandle;
+		if (handle != published.rcontroller_infos[i])
+		{
+			SharedState::RawControllerInfo info{};
+			if (controller)
+			{
+				info.handle = handle;
+				info.button_count = (uint32_t)std::min(controller->description.button_count, SharedState::kMaxButtons);
+				info.switch_count = (uint32_t)std::min(controller->description.switches_count, SharedState::kMaxSwitches);
+				info.axis_count = (uint32_t)std::min(controller->description.axis_count, SharedState::kMaxAxes);
+				SharedState::ToUtf16(controller->description.uid, info.uid);
+				SharedState::ToUtf16(controller->description.display_name, info.display_name);
+			}
+
+			layout.rcontroller_infos[i].Store(info);
+			published.rcontroller_infos[i] = handle;
+		}
+
+		SharedState::RawControllerSlot slot{}; // stays empty if the controller is gone or can't be read
+		if (controller)
+			ReadPublishedRController(*controller, published, slot);
+
+		if (slot.handle == published.rcontroller_handles[i] && slot.timestamp == published.rcontroller_timestamps[i])
+			continue;
+
+		layout.rcontrollers[i].Store(slot);
+		published.rcontroller_handles[i] = slot.handle;
+		published.rcontroller_timestamps[i] = slot.timestamp;
+	}
+
+	layout.update_time.store(GetSteadyMicroseconds(), std::memory_order_release);
+}
+
+void PublisherThread(SharedState::Layout* layout)
+{
+	PublishedSlots published;
+	auto next = std::chrono::steady_clock::now();
+
+	std::unique_lock lock(g_publisher_mutex);
+	while (!g_publisher_stop)
+	{
+		lock.unlock();
+		PublishSharedState(*layout, published);
+		lock.lock();
+
+		const auto now = std::chrono::steady_clock::now();
+		next += g_publish_interval;
+		if (next < now) // we fell behind, don't try to catch up
+			next = now;
+
+		if (g_publisher_cv.wait_until(lock, next, [] { return g_publisher_stop; }))
+			break;
+	}
+}
+
+// expects g_publisher_control_mutex to be held, readers see every slot empty afterwards
+void StopPublisher()
+{
+	if (!g_publisher.joinable())
+		return;
+
+	{
+		std::scoped_lock lock(g_publisher_mutex);
+		g_publisher_stop = true;
+		g_publisher_cv.notify_all();
+	}
+	g_publisher.join();
+
+	auto& layout = *static_cast<SharedState::Layout*>(g_publisher_region->GetData());
+	for (auto& slot : layout.gamepads)
+		slot.Store({});
+	for (auto& slot : layout.rcontroller_infos)
+		slot.Store({});
+	for (auto& slot : layout.rcontrollers)
+		slot.Store({});
+
+	layout.update_time.store(0, std::memory_order_release);
+	g_publisher_region.reset();
+}
+#pragma endregion
+
+#pragma region Backend
+// forwards the hot-plug events of the current backend into the registries
+class Listener : public Backend::IListener
+{
+public:
+	void OnGamepadAdded(const void* key, Backend::GamepadDevicePtr device) override
+	{
+		size_t index;
+		auto lock = g_gamepad_lock_stats.Lock(g_gamepad_mutex);
+		if (!InsertGamepad(key, std::move(device), index))
+			return;
+
+		++g_gamepads_added;
+
+		if (g_recorder.IsRecording())
+			g_recorder.GamepadConnected(index);
+
+#ifdef _DEBUG
+		std::cout << "OnGamepadAdded: inserted new gamepad at index " << index << std::endl;
+#endif
+		lock.unlock();
+
+		if (g_status_started)
+			WakeStatusRefresh();
+
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::Gamepad, index);
+	}
+
+	void OnGamepadRemoved(const void* key) override
+	{
+		size_t index;
+		auto lock = g_gamepad_lock_stats.Lock(g_gamepad_mutex);
+		if (!EraseGamepad(key, index))
+			return;
+
+		++g_gamepads_removed;
+
+		if (g_recorder.IsRecording())
+			g_recorder.GamepadDisconnected(index);
+
+#ifdef _DEBUG
+		std::cout << "OnGamepadRemoved: removed known gamepad from index " << index << std::endl;
+#endif
+		lock.unlock();
+
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::Gamepad, index);
+	}
+
+	void OnRawControllerAdded(const WindowsGamingInput::RawController::Description& description, Backend::RawControllerDevicePtr device) override
+	{
+		const std::wstring_view uid = description.uid;
+		if (uid.empty())
+			return;
+
+		RController controller{ std::move(device), description };
+		controller.status = std::make_shared<WindowsGamingInput::StatusCache>();
+		controller.clock = std::make_shared<WindowsGamingInput::ClockCorrelation>();
+
+		// the capabilities don't change while connected, labels the device can't resolve stay None
+		auto& capabilities = controller.capabilities;
+		capabilities.button_count = description.button_count;
+		capabilities.switch_count = description.switches_count;
+		capabilities.axis_count = description.axis_count;
+		capabilities.has_vibration = controller.device->HasVibration();
+
+		controller.button_labels = std::shared_ptr<WindowsGamingInput::ButtonLabel[]>(new WindowsGamingInput::ButtonLabel[description.button_count]{});
+		for (size_t i = 0; i < description.button_count; ++i)
+			controller.device->GetButtonLabel(i, controller.button_labels[i]);
+
+		// also the first refresh of the status cache, so reads don't have to wait for the refresh thread
+		WindowsGamingInput::StatusCache::Status status;
+		controller.status->Refresh(*controller.device, status);
+		capabilities.wireless = status.wireless;
+
+		WindowsGamingInput::RawController::Handle handle;
+		auto lock = g_rcontroller_lock_stats.Lock(g_rcontroller_mutex);
+		if (!InsertRController(uid, std::move(controller), handle))
+			return;
+
+		++g_rcontrollers_added;
+
+		if (g_recorder.IsRecording())
+			g_recorder.RawControllerConnected(handle, description);
+
+#ifdef _DEBUG
+		std::wcout << L"OnRawControllerAdded: added new controller with uid: " << uid << std::endl;
+#endif
+		lock.unlock();
+
+		if (g_status_started)
+			WakeStatusRefresh();
+
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerAdded, WindowsGamingInput::ControllerType::RawController, std::wstring(uid));
+	}
+
+	void OnRawControllerRemoved(std::wstring_view uid) override
+	{
+		WindowsGamingInput::RawController::Handle handle;
+		auto lock = g_rcontroller_lock_stats.Lock(g_rcontroller_mutex);
+		if (!EraseRController(uid, handle))
+			return;
+
+		++g_rcontrollers_removed;
+
+		if (g_recorder.IsRecording())
+			g_recorder.RawControllerDisconnected(handle);
+
+#ifdef _DEBUG
+		std::wcout << L"OnRawControllerRemoved: removed known controller with uid: " << uid << std::endl;
+#endif
+		lock.unlock();
+
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::RawController, std::wstring(uid));
+	}
+};
+
+Listener g_listener;
+std::mutex g_backend_mutex; // serializes SetBackend
+std::shared_ptr<Backend::IBackend> g_backend;
+std::atomic_bool g_rcontroller_deferred = false; // the raw controllers of g_backend wait for the first RawController call
+
+// time Start* of the current backend took, ns
+std::atomic_uint64_t g_gamepad_start_time = 0;
+std::atomic_uint64_t g_rcontroller_start_time = 0;
+
+// InitializeAsync, guarded by g_init_mutex
+std::mutex g_init_mutex;
+std::condition_variable g_init_cv;
+std::thread g_init_thread;
+Backend::Factory_t g_backend_factory = nullptr;
+bool g_init_requested = false; // the backend has been started through InitializeAsync
+bool g_init_running = false;
+bool g_init_ready = false;
+bool g_init_start_raw = false; // an Eager call came in, the thread starts deferred raw controllers before it finishes
+bool g_init_stop = false;
+
+// expects g_backend_mutex to be held
+void StartRControllers()
+{
+	const auto start = std::chrono::steady_clock::now();
+	g_rcontroller_initialized = g_backend->StartRawControllers(g_listener);
+	g_rcontroller_start_time = Instrumentation::ElapsedNs(start);
+}
+
+void StartDeferredRControllers()
+{
+	std::scoped_lock lock(g_backend_mutex);
+	if (g_rcontroller_deferred)
+	{
+		StartRControllers();
+		g_rcontroller_deferred = false; // after the scan, so concurrent first calls wait for it
+	}
+}
+
+// the raw controller registry for the API calls, starts the raw controllers first if they were deferred
+Snapshot<RControllerRegistry>::Pin GetRControllers()
+{
+	if (g_rcontroller_deferred)
+		StartDeferredRControllers();
+
+	return g_rcontroller_registry.Get();
+}
+
+// expects g_backend_mutex to be held and the backend to be stopped
+// slots are released instead of cleared so old handles and generations stay invalid
+void RemoveAllDevices()
+{
+	std::vector<size_t> gamepads;
+	{
+		const auto lock = g_gamepad_lock_stats.Lock(g_gamepad_mutex);
+		for (const auto& [key, index] : g_gamepad_slots)
+		{
+			g_gamepad_allocator.Release(index);
+			gamepads.emplace_back(index);
+		}
+
+		g_gamepad_slots.clear();
+		g_gamepad_registry.Publish(std::make_shared<const GamepadRegistry>());
+	}
+
+	std::vector<std::wstring> controllers;
+	{
+		const auto lock = g_rcontroller_lock_stats.Lock(g_rcontroller_mutex);
+		const auto current = g_rcontroller_registry.Load();
+		for (const auto& [uid, slot] : current->uids)
+		{
+			g_rcontroller_allocator.Release(slot);
+			controllers.emplace_back(uid);
+		}
+
+		auto registry = std::make_shared<RControllerRegistry>();
+		registry->version = current->version;
+		PublishRControllers(std::move(registry));
+	}
+
+	g_vibration_worker.Clear();
+	g_gamepads_removed += gamepads.size();
+	g_rcontrollers_removed += controllers.size();
+
+	for (const auto index : gamepads)
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::Gamepad, index);
+
+	for (auto& uid : controllers)
+		QueueControllerChanged(WindowsGamingInput::EventType::ControllerRemoved, WindowsGamingInput::ControllerType::RawController, std::move(uid));
+}
+
+namespace WindowsGamingInput::Backend
+{
+	void SetBackend(std::shared_ptr<IBackend> backend, bool defer_raw_controllers)
+	{
+		std::scoped_lock lock(g_backend_mutex);
+		if (g_backend)
+		{
+			g_backend->Stop();
+			g_gamepad_initialized = false;
+			g_rcontroller_initialized = false;
+			g_rcontroller_deferred = false;
+			g_gamepad_start_time = 0;
+			g_rcontroller_start_time = 0;
+			RemoveAllDevices();
+		}
+
+		g_backend = std::move(backend);
+		if (g_backend)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			g_gamepad_initialized = g_backend->StartGamepads(g_listener);
+			g_gamepad_start_time = Instrumentation::ElapsedNs(start);
+
+			if (defer_raw_controllers)
+				g_rcontroller_deferred = true;
+			else
+				StartRControllers();
+		}
+	}
+
+	void SetFactory(Factory_t factory)
+	{
+		std::scoped_lock lock(g_init_mutex);
+		g_backend_factory = factory;
+	}
+
+	void Shutdown()
+	{
+		// initialization detach
+		{
+			std::scoped_lock lock(g_init_mutex);
+			g_init_stop = true;
+			if (g_init_thread.joinable())
+				g_init_thread.detach();
+		}
+
+		// poller detach
+		{
+			std::scoped_lock lock(g_poller_mutex);
+			g_poller_stop = true;
+			g_poller_cv.notify_all();
+			if (g_poller.joinable())
+				g_poller.detach();
+		}
+
+		// dispatcher detach
+		{
+			std::scoped_lock lock(g_dispatch_mutex);
+			g_dispatcher_stop = true;
+			g_dispatch_cv.notify_all();
+			if (g_dispatcher.joinable())
+				g_dispatcher.detach();
+		}
+
+		// status refresher detach
+		{
+			std::scoped_lock lock(g_status_mutex);
+			g_status_stop = true;
+			g_status_cv.notify_all();
+			if (g_status_refresher.joinable())
+				g_status_refresher.detach();
+		}
+
+		// input poll detach
+		{
+			std::scoped_lock lock(g_input_mutex);
+			g_input_poller_stop = true;
+			g_input_poller_cv.notify_all();
+			if (g_input_poller.joinable())
+				g_input_poller.detach();
+		}
+
+		// publisher detach, the region stays mapped until the process exits
+		{
+			std::scoped_lock lock(g_publisher_mutex);
+			g_publisher_stop = true;
+			g_publisher_cv.notify_all();
+			if (g_publisher.joinable())
+				g_publisher.detach();
+		}
+
+		// callbacks detach
+		{
+			std::scoped_lock lock(g_cb_mutex);
+			g_callbacks.clear();
+		}
+
+		{
+			std::scoped_lock lock(g_status_cb_mutex);
+			g_status_callbacks.clear();
+		}
+
+		g_vibration_worker.Detach();
+		g_recorder.Detach();
+		SetBackend(nullptr);
+	}
+}
+
+void InitializeThread(bool start_backend, bool defer_raw_controllers)
+{
+	if (start_backend)
+		Backend::SetBackend(g_backend_factory(), defer_raw_controllers);
+
+	std::unique_lock lock(g_init_mutex);
+	while (g_init_start_raw && !g_init_stop)
+	{
+		g_init_start_raw = false;
+		lock.unlock();
+		StartDeferredRControllers();
+		lock.lock();
+	}
+
+	g_init_running = false;
+	g_init_ready = true;
+	g_init_cv.notify_all();
+}
+
+#ifndef _WIN32
+// there is no DllMain off windows, detach the threads before their std::thread objects get destroyed
+struct ShutdownAtExit
+{
+	~ShutdownAtExit()
+	{
+		g_recorder.Stop(); // can join here, unlike in Shutdown
+		g_vibration_worker.Stop();
+		{
+			std::scoped_lock lock(g_status_mutex);
+			g_status_stop = true;
+			g_status_cv.notify_all();
+		}
+		if (g_status_refresher.joinable())
+			g_status_refresher.join();
+		{
+			std::scoped_lock lock(g_publisher_control_mutex);
+			StopPublisher(); // unlinks the posix shm
+		}
+		{
+			std::scoped_lock lock(g_input_mutex);
+			g_input_poller_stop = true;
+			g_input_poller_cv.notify_all();
+		}
+		if (g_input_poller.joinable())
+			g_input_poller.join();
+		{
+			std::scoped_lock lock(g_init_mutex);
+			g_init_stop = true;
+		}
+		if (g_init_thread.joinable())
+			g_init_thread.join();
+		Backend::Shutdown();
+	}
+} g_shutdown_at_exit;
+#endif
+#pragma endregion
+
+namespace WindowsGamingInput
+{
+	bool InitializeAsync(InitializeMode mode)
+	{
+		g_calls.Count(EntryPoint::InitializeAsync);
+		std::scoped_lock lock(g_init_mutex);
+		if (g_init_stop)
+			return false;
+
+		const bool start_backend = !g_init_requested;
+		if (start_backend)
+		{
+			if (!g_backend_factory)
+				return false;
+
+			g_init_requested = true;
+		}
+		else if (mode == InitializeMode::LazyRawControllers || (!g_init_running && !g_rcontroller_deferred))
+			return false;
+		else
+			g_init_start_raw = true;
+
+		g_init_ready = false;
+		if (g_init_running)
+			return true;
+
+		if (g_init_thread.joinable())
+			g_init_thread.join(); // finished already, g_init_running is cleared last
+
+		g_init_running = true;
+		g_init_thread = std::thread(InitializeThread, start_backend, mode == InitializeMode::LazyRawControllers);
+		return true;
+	}
+
+	bool WaitForInitialization(uint32_t timeout)
+	{
+		g_calls.Count(EntryPoint::WaitForInitialization);
+		std::unique_lock lock(g_init_mutex);
+		return g_init_cv.wait_for(lock, std::chrono::milliseconds(timeout), [] { return g_init_ready; });
+	}
+
+	void GetInitializationStats(InitializationStats& stats)
+	{
+		g_calls.Count(EntryPoint::GetInitializationStats);
+		{
+			std::scoped_lock lock(g_init_mutex);
+			stats.ready = g_init_ready;
+		}
+
+		stats.raw_controllers_deferred = g_rcontroller_deferred;
+		stats.gamepads = g_gamepad_start_time;
+		stats.raw_controllers = g_rcontroller_start_time;
+	}
+
+	uint64_t GetHostTime()
+	{
+		g_calls.Count(EntryPoint::GetHostTime);
+		return GetSteadyMicroseconds();
+	}
+
+	WaitResult WaitForInput(uint64_t gamepads, const RawController::Handle* controllers, size_t count, uint32_t timeout)
+	{
+		g_calls.Count(EntryPoint::WaitForInput);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+		const auto snapshot_timestamp = [](size_t index) -> uint64_t
+		{
+			const auto snapshot = g_gamepad_snapshots[index].Load();
+			return snapshot.connected ? snapshot.state.Timestamp : 0;
+		};
+
+		++g_input_waiters;
+		uint64_t hotplugs;
+		{
+			std::scoped_lock lock(g_input_mutex);
+			hotplugs = g_input_hotplugs;
+		}
+
+		// the readings at the time of the call, read once here and compared against the shared poll afterwards
+		std::array<uint64_t, 64> gamepad_timestamps{};
+		{
+			const auto registry = g_gamepad_registry.Get();
+			for (uint64_t bits = gamepads; bits; bits &= bits - 1)
+			{
+				const size_t index = std::countr_zero(bits);
+				gamepad_timestamps[index] = g_gamepad_polling ? snapshot_timestamp(index) : ReadInputTimestamp(*registry, index);
+			}
+		}
+
+		std::vector<uint64_t> controller_timestamps(count);
+		if (count != 0)
+		{
+			const auto registry = GetRControllers();
+			for (size_t i = 0; i < count; ++i)
+				controller_timestamps[i] = ReadInputTimestamp(*registry, controllers[i]);
+		}
+
+		const InputWait wait{ gamepads, controllers, count };
+		WaitResult result = WaitResult::Timeout;
+		std::unique_lock lock(g_input_mutex);
+		g_input_waits.emplace_back(&wait);
+		g_input_waits_added = true;
+		const uint64_t epoch = g_input_epoch; // passes after it took the devices after the readings above
+		if (!g_input_poller.joinable() && !g_input_poller_stop)
+			g_input_poller = std::thread(InputPollThread);
+		g_input_poller_cv.notify_one();
+
+		// only the passes which started after registering count, an older one may have read before the readings above
+		const auto changed = [&]
+		{
+			for (uint64_t bits = gamepads; bits; bits &= bits - 1)
+			{
+				const size_t index = std::countr_zero(bits);
+				if (g_gamepad_polling)
+				{
+					if (snapshot_timestamp(index) != gamepad_timestamps[index])
+						return true;
+				}
+				else if (const auto& polled = g_input_gamepad_timestamps[index]; polled.epoch > epoch && polled.timestamp != gamepad_timestamps[index])
+					return true;
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto it = g_input_rcontroller_timestamps.find(controllers[i]);
+				if (it != g_input_rcontroller_timestamps.cend() && it->second.epoch > epoch && it->second.timestamp != controller_timestamps[i])
+					return true;
+			}
+			return false;
+		};
+
+		while (true)
+		{
+			if (g_input_hotplugs != hotplugs)
+			{
+				result = WaitResult::ControllerChanged;
+				break;
+			}
+
+			if (changed())
+			{
+				result = WaitResult::Input;
+				break;
+			}
+
+			if (std::chrono::steady_clock::now() >= deadline)
+				break;
+
+			const uint64_t polls = g_input_polls;
+			g_input_cv.wait_until(lock, deadline, [&] { return g_input_polls != polls || g_input_hotplugs != hotplugs; });
+		}
+
+		g_input_waits.erase(std::find(g_input_waits.begin(), g_input_waits.end(), &wait));
+		--g_input_waiters;
+		return result;
+	}
+
+	void AddControllerChanged(ControllerChanged_t cb)
+	{
+		g_calls.Count(EntryPoint::AddControllerChanged);
+		const auto lock = g_callback_lock_stats.Lock(g_cb_mutex);
+		if(std::ranges::find(std::as_const(g_callbacks), cb) == g_callbacks.cend())
+			g_callbacks.emplace_back(cb);
 	}
 
 	void RemoveControllerChanged(ControllerChanged_t cb)
 	{
-		std::scoped_lock lock(g_cb_mutex);
+		g_calls.Count(EntryPoint::RemoveControllerChanged);
+		const auto lock = g_callback_lock_stats.Lock(g_cb_mutex);
 		const auto rm = std::ranges::remove(g_callbacks, cb);
 		g_callbacks.erase(rm.begin(), rm.end());
 	}
 
-	bool GetBatteryInfo(ComPtr<IGameControllerBatteryInfo> battery_info, BatteryStatus& status, double& battery)
+	void SetStatusRefreshInterval(uint32_t interval)
+	{
+		g_calls.Count(EntryPoint::SetStatusRefreshInterval);
+		g_status_interval = interval;
+		WakeStatusRefresh();
+	}
+
+	void AddStatusChanged(StatusChanged_t cb)
 	{
-		ComPtr<ABI::Windows::Devices::Power::IBatteryReport> report;
-		HRESULT hr = battery_info->TryGetBatteryReport(&report);
-		if (FAILED(hr) || !report)
+		g_calls.Count(EntryPoint::AddStatusChanged);
+		{
+			std::scoped_lock lock(g_status_cb_mutex);
+			if (std::ranges::find(std::as_const(g_status_callbacks), cb) == g_status_callbacks.cend())
+				g_status_callbacks.emplace_back(cb);
+		}
+
+		StartStatusRefresh();
+	}
+
+	void RemoveStatusChanged(StatusChanged_t cb)
+	{
+		g_calls.Count(EntryPoint::RemoveStatusChanged);
+		std::scoped_lock lock(g_status_cb_mutex);
+		const auto rm = std::ranges::remove(g_status_callbacks, cb);
+		g_status_callbacks.erase(rm.begin(), rm.end());
+	}
+
+	void GetControllerChangedStats(ControllerChangedStats& stats)
+	{
+		g_calls.Count(EntryPoint::GetControllerChangedStats);
+		stats.delivered = g_dispatch_delivered;
+		stats.coalesced = g_dispatch_coalesced;
+		stats.last_latency = g_dispatch_last_latency;
+		stats.max_latency = g_dispatch_max_latency;
+	}
+
+	bool StartRecording(std::wstring_view path)
+	{
+		g_calls.Count(EntryPoint::StartRecording);
+
+		// hot-plug waits until all connected devices are recorded, so every device gets exactly one connect record
+		const auto gamepad_lock = g_gamepad_lock_stats.Lock(g_gamepad_mutex);
+		const auto rcontroller_lock = g_rcontroller_lock_stats.Lock(g_rcontroller_mutex);
+		if (!g_recorder.Start(std::filesystem::path(path)))
 			return false;
 
-		static_assert(sizeof(BatteryStatus) == sizeof(ABI::Windows::System::Power::BatteryStatus));
-		hr = report->get_Status((ABI::Windows::System::Power::BatteryStatus*)&status);
-		assert(SUCCEEDED(hr));
+		// free slots are recorded as connect + disconnect. SetBackend frees every slot and a new gamepad always gets the lowest free one,
+		// so a replay rebuilds the same free slots and later hot-plugs get the same indices as in the recorded session
+		const auto gamepads = g_gamepad_registry.Load();
+		for (size_t i = 0; i < gamepads->gamepads.size(); ++i)
+			g_recorder.GamepadConnected(i);
+
+		for (size_t i = 0; i < gamepads->gamepads.size(); ++i)
+		{
+			if (!gamepads->gamepads[i])
+				g_recorder.GamepadDisconnected(i);
+		}
+
+		for (const auto& entry : g_rcontroller_registry.Load()->slots)
+		{
+			if (entry)
+				g_recorder.RawControllerConnected(entry->handle, entry->description);
+		}
+
+		return true;
+	}
+
+	void StopRecording()
+	{
+		g_calls.Count(EntryPoint::StopRecording);
+		g_recorder.Stop();
+	}
+
+	void GetMetrics(Metrics& metrics)
+	{
+		g_calls.Count(EntryPoint::GetMetrics);
+		g_calls.Get(metrics.calls);
+
+		g_gamepad_reading_latency.Get(metrics.gamepad_reading);
+		g_gamepad_vibration_latency.Get(metrics.gamepad_vibration);
+		g_rcontroller_reading_latency.Get(metrics.rcontroller_reading);
+		g_rcontroller_vibration_latency.Get(metrics.rcontroller_vibration);
+		g_vibration_worker.GetStats(metrics.vibration_queue);
+		g_poll_scheduler.GetStats(metrics.polling);
+
+		metrics.gamepads_added = g_gamepads_added;
+		metrics.gamepads_removed = g_gamepads_removed;
+		metrics.rcontrollers_added = g_rcontrollers_added;
+		metrics.rcontrollers_removed = g_rcontrollers_removed;
+
+		g_gamepad_lock_stats.Get(metrics.gamepad_lock);
+		g_rcontroller_lock_stats.Get(metrics.rcontroller_lock);
+		g_changes_lock_stats.Get(metrics.changes_lock);
+		g_dispatch_lock_stats.Get(metrics.dispatch_lock);
+		g_callback_lock_stats.Get(metrics.callback_lock);
+	}
+
+	void ResetMetrics()
+	{
+		g_calls.Reset();
+		g_calls.Count(EntryPoint::ResetMetrics);
+
+		g_gamepad_reading_latency.Reset();
+		g_gamepad_vibration_latency.Reset();
+		g_rcontroller_reading_latency.Reset();
+		g_rcontroller_vibration_latency.Reset();
+		g_vibration_worker.ResetStats();
+		g_poll_scheduler.ResetStats();
+
+		for (const auto& clock : g_gamepad_registry.Load()->clocks)
+		{
+			if (clock)
+				clock->ResetStats();
+		}
+
+		for (const auto& controller : g_rcontroller_registry.Load()->slots)
+		{
+			if (controller)
+				controller->clock->ResetStats();
+		}
+
+		g_gamepads_added = 0;
+		g_gamepads_removed = 0;
+		g_rcontrollers_added = 0;
+		g_rcontrollers_removed = 0;
+
+		g_gamepad_lock_stats.Reset();
+		g_rcontroller_lock_stats.Reset();
+		g_changes_lock_stats.Reset();
+		g_dispatch_lock_stats.Reset();
+		g_callback_lock_stats.Reset();
+	}
+
+	namespace Gamepad
+	{
+		bool IsInitialized()
+		{
+			g_calls.Count(EntryPoint::Gamepad_IsInitialized);
+			return g_gamepad_initialized;
+		}
+
+		size_t GetCount()
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetCount);
+			return g_gamepad_registry.Get()->gamepads.size();
+		}
+
+		uint32_t GetGeneration(size_t index)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetGeneration);
+			const auto registry = g_gamepad_registry.Get();
+			return index < registry->generations.size() ? registry->generations[index] : 0;
+		}
+
+		bool StartPolling(uint32_t frequency)
+		{
+			g_calls.Count(EntryPoint::Gamepad_StartPolling);
+			if (frequency == 0)
+				return false;
+
+			std::scoped_lock control_lock(g_poller_control_mutex);
+			{
+				std::scoped_lock lock(g_poller_mutex);
+				g_poll_interval = std::chrono::nanoseconds(std::chrono::seconds(1)) / frequency;
+				g_poll_scheduler.SetMinInterval(std::max<uint64_t>(1000000 / frequency, 1));
+				if (g_poller.joinable())
+					return true; // just changed the rate
+
+				g_poller_stop = false;
+			}
+
+			// publish a first set of snapshots so GetState is valid right away
+			PollGamepads(nullptr);
+			g_gamepad_polling = true;
+
+			g_poller = std::thread(GamepadPollerThread);
+			return true;
+		}
+
+		void SetAdaptivePolling(bool enabled)
+		{
+			g_calls.Count(EntryPoint::Gamepad_SetAdaptivePolling);
+			g_adaptive_polling = enabled;
+		}
+
+		void StopPolling()
+		{
+			g_calls.Count(EntryPoint::Gamepad_StopPolling);
+			std::scoped_lock control_lock(g_poller_control_mutex);
+			if (!g_poller.joinable())
+				return;
 
-		ComPtr<__FIReference_1_int> remaining_ptr, full_ptr;
-		report->get_RemainingCapacityInMilliwattHours(&remaining_ptr);
-		report->get_FullChargeCapacityInMilliwattHours(&full_ptr);
+			g_gamepad_polling = false;
+			{
+				std::scoped_lock lock(g_poller_mutex);
+				g_poller_stop = true;
+				g_poller_cv.notify_all();
+			}
 
-		int remaining = 0, full = 0;
-		if (remaining_ptr)
-		{
-			hr = remaining_ptr->get_Value(&remaining);
-			assert(SUCCEEDED(hr));
+			g_poller.join();
 		}
-		
-		if (full_ptr)
+
+		bool EnableChangeEvents(size_t capacity)
 		{
-			hr = full_ptr->get_Value(&full);
-			assert(SUCCEEDED(hr));
+			g_calls.Count(EntryPoint::Gamepad_EnableChangeEvents);
+			if (capacity == 0)
+				return false;
+
+			const auto lock = g_changes_lock_stats.Lock(g_gamepad_changes_mutex);
+			if (!g_gamepad_changes)
+				g_gamepad_changes = std::make_shared<GamepadChanges>(capacity);
+
+			return true;
 		}
 
-		// remaining is always 100 when connected and status discharching (?!) -> check for IsWireless before
-		battery = full <= 0 ? 0 : static_cast<double>(remaining) / static_cast<double>(full);
-		return true;
-	}
-	
-	namespace Gamepad
-	{
-		bool IsInitialized()
+		void DisableChangeEvents()
 		{
-			return g_gamepad_statics != nullptr;
+			g_calls.Count(EntryPoint::Gamepad_DisableChangeEvents);
+			const auto lock = g_changes_lock_stats.Lock(g_gamepad_changes_mutex);
+			g_gamepad_changes.reset();
 		}
 
-		size_t GetCount()
+		size_t PopChanges(GamepadChange* changes, size_t count)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			return g_gamepads.size();
+			g_calls.Count(EntryPoint::Gamepad_PopChanges);
+			const auto lock = g_changes_lock_stats.Lock(g_gamepad_changes_mutex);
+			if (!g_gamepad_changes)
+				return 0;
+
+			return g_gamepad_changes->Pop(changes, count);
 		}
 
 		bool IsConnected(size_t index)
 		{
+			g_calls.Count(EntryPoint::Gamepad_IsConnected);
 			GamepadState tmp;
-			return GetState(index, tmp);
+			return GetGamepadState(index, tmp);
 		}
 
 		bool GetState(size_t index, GamepadState& state)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			if (index >= g_gamepads.size())
+			g_calls.Count(EntryPoint::Gamepad_GetState);
+			if (!GetGamepadState(index, state))
 				return false;
 
-			const auto gamepad = g_gamepads[index];
-			lock.unlock();
+			ObserveGamepadReading(index, state.Timestamp);
+			return true;
+		}
 
-			if (!gamepad)
+		size_t GetAllStates(GamepadState* states, size_t count, uint64_t& connected)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetAllStates);
+			return GetAllGamepadStates(states, count, connected);
+		}
+
+		bool GetPackedState(size_t index, PackedGamepadState& state, uint64_t& timestamp)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetPackedState);
+			GamepadState reading;
+			if (!GetGamepadState(index, reading))
 				return false;
 
-			return SUCCEEDED(gamepad->GetCurrentReading((GamepadReading*)&state));
+			ObserveGamepadReading(index, reading.Timestamp);
+			timestamp = reading.Timestamp;
+			state = PackGamepadState(reading, timestamp);
+			return true;
+		}
+
+		size_t GetAllPackedStates(PackedGamepadState* states, size_t count, uint64_t& timestamp, uint64_t& connected)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetAllPackedStates);
+			count = std::min(count, kMaxPolledGamepads);
+
+			if (g_gamepad_polling)
+			{
+				const auto frame = g_gamepad_packed_frame.Load();
+				count = std::min(count, frame.count);
+				std::copy_n(frame.states, count, states);
+				timestamp = frame.timestamp;
+				connected = count < 64 ? frame.connected & ((1ull << count) - 1) : frame.connected;
+				return count;
+			}
+
+			GamepadState readings[kMaxPolledGamepads];
+			count = GetAllGamepadStates(readings, count, connected);
+
+			timestamp = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (connected & (1ull << i))
+					timestamp = std::max(timestamp, readings[i].Timestamp);
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				states[i] = connected & (1ull << i) ? PackGamepadState(readings[i], timestamp) : PackedGamepadState{};
+			}
+
+			return count;
 		}
 
 		bool SetVibration(size_t index, const Vibration& vibration)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			if (index >= g_gamepads.size())
+			g_calls.Count(EntryPoint::Gamepad_SetVibration);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
+			if (!gamepad)
 				return false;
 
-			const auto gamepad = g_gamepads[index];
-			lock.unlock();
+			g_vibration_worker.Cancel(gamepad.get());
+			const auto start = std::chrono::steady_clock::now();
+			const bool result = gamepad->SetVibration(vibration);
+			g_gamepad_vibration_latency.Record(Instrumentation::ElapsedNs(start));
+			return result;
+		}
 
+		bool SubmitVibration(size_t index, const Vibration& vibration)
+		{
+			g_calls.Count(EntryPoint::Gamepad_SubmitVibration);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
 			if (!gamepad)
 				return false;
 
-			static_assert(sizeof(Vibration) == sizeof(GamepadVibration));
-			GamepadVibration tmp;
-			memcpy(&tmp, &vibration, sizeof(GamepadVibration));
-			return SUCCEEDED(gamepad->put_Vibration(tmp));
+			g_vibration_worker.Submit(gamepad, vibration);
+			return true;
 		}
 
-		bool GetVibration(size_t index, Vibration& vibration)
+		bool PlayEffect(size_t index, const VibrationEffect& effect)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			if (index >= g_gamepads.size())
+			g_calls.Count(EntryPoint::Gamepad_PlayEffect);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
+			if (!gamepad)
 				return false;
 
-			const auto gamepad = g_gamepads[index];
-			lock.unlock();
+			g_vibration_worker.Play(gamepad, effect);
+			return true;
+		}
 
+		bool StopEffect(size_t index)
+		{
+			g_calls.Count(EntryPoint::Gamepad_StopEffect);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
 			if (!gamepad)
 				return false;
 
-			static_assert(sizeof(Vibration) == sizeof(GamepadVibration));
-			return SUCCEEDED(gamepad->get_Vibration((GamepadVibration*)&vibration));
+			g_vibration_worker.StopEffect(gamepad.get());
+			return true;
 		}
 
-		bool IsWireless(size_t index, bool& wireless)
+		bool SetProcessing(size_t index, const GamepadProcessing* processing)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			if (index >= g_gamepads.size())
+			g_calls.Count(EntryPoint::Gamepad_SetProcessing);
+			const auto lock = g_gamepad_lock_stats.Lock(g_gamepad_mutex);
+			const auto current = g_gamepad_registry.Load();
+			if (!current->Find(index))
 				return false;
 
-			const auto gamepad = g_gamepads[index];
-			lock.unlock();
+			auto registry = std::make_shared<GamepadRegistry>(*current);
+			if (processing)
+			{
+				if (index >= registry->processing.size())
+					registry->processing.resize(index + 1);
+
+				registry->processing[index] = *processing;
+			}
+			else if (index < registry->processing.size())
+				registry->processing[index].reset();
+
+			CompileGamepadProcessing(*registry);
+			g_gamepad_registry.Publish(std::move(registry));
+			return true;
+		}
 
+		bool GetVibration(size_t index, Vibration& vibration)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetVibration);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
 			if (!gamepad)
 				return false;
 
-			ComPtr<IGameController> controller;
-			auto hr = gamepad.As(&controller);
-			assert(SUCCEEDED(hr));
-
-			static_assert(sizeof(bool) == sizeof(boolean));
-			return SUCCEEDED(controller->get_IsWireless((boolean*)&wireless));
+			return gamepad->GetVibration(vibration);
 		}
 
-		bool GetBatteryStatus(size_t index, BatteryStatus& status, double& battery)
+		bool IsWireless(size_t index, bool& wireless)
 		{
-			std::shared_lock lock(g_gamepad_mutex);
-			if (index >= g_gamepads.size())
+			g_calls.Count(EntryPoint::Gamepad_IsWireless);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
+			if (!gamepad)
 				return false;
 
-			const auto gamepad = g_gamepads[index];
-			lock.unlock();
+			return GetDeviceWireless(*gamepad, *registry->status[index], wireless);
+		}
 
+		bool GetBatteryStatus(size_t index, BatteryStatus& status, double& battery)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetBatteryStatus);
+			const auto registry = g_gamepad_registry.Get();
+			const auto& gamepad = registry->Find(index);
 			if (!gamepad)
 				return false;
 
-			ComPtr<IGameControllerBatteryInfo> battery_info;
-			auto hr = gamepad.As(&battery_info);
-			assert(SUCCEEDED(hr));
+			return GetDeviceBatteryStatus(*gamepad, *registry->status[index], status, battery);
+		}
+
+		bool ToHostTime(size_t index, uint64_t timestamp, uint64_t& host)
+		{
+			g_calls.Count(EntryPoint::Gamepad_ToHostTime);
+			const auto registry = g_gamepad_registry.Get();
+			return registry->Find(index) && registry->clocks[index]->ToHost(timestamp, host);
+		}
 
-			return GetBatteryInfo(battery_info, status, battery);
+		bool GetTimingStats(size_t index, ReadingTimingStats& stats)
+		{
+			g_calls.Count(EntryPoint::Gamepad_GetTimingStats);
+			const auto registry = g_gamepad_registry.Get();
+			if (!registry->Find(index))
+				return false;
+
+			registry->clocks[index]->Get(stats);
+			return true;
 		}
 	}
 
+	// the uid overloads look the controller up directly instead of going through Open, so every call is counted once
 	namespace RawGameController
 	{
 		bool IsInitialized()
 		{
-			return g_rcontroller_statics != nullptr;
+			g_calls.Count(EntryPoint::RawGameController_IsInitialized);
+			if (g_rcontroller_deferred)
+				StartDeferredRControllers();
+
+			return g_rcontroller_initialized;
 		}
 		
 		size_t GetCount()
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			return g_rcontrollers.size();
+			g_calls.Count(EntryPoint::RawGameController_GetCount);
+			return GetRControllers()->uids.size();
 		}
 
 		size_t GetControllers(RawController::Description* controllers, size_t count)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
+			g_calls.Count(EntryPoint::RawGameController_GetControllers);
+			const auto registry = GetRControllers();
+			const auto& descriptions = registry->descriptions;
 			if (controllers == nullptr)
-				return g_rcontrollers.size(); // return size if no buffer have been given
+				return descriptions.size(); // return size if no buffer have been given
+
+			const size_t result = std::min(count, descriptions.size());
+			std::copy_n(descriptions.cbegin(), result, controllers);
+			return result;
+		}
 
-			size_t result = 0;
-			for (const auto& kv : g_rcontrollers)
+		bool GetControllersIfChanged(uint64_t& version, RawController::Description* controllers, size_t& count)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetControllersIfChanged);
+			const auto registry = GetRControllers();
+			if (registry->version == version)
+				return false;
+
+			// a truncated list would look current, so the caller gets the size it needs and version stays for the retry
+			if (controllers == nullptr || count < registry->descriptions.size())
 			{
-				if (result >= count)
-					break;
+				count = registry->descriptions.size();
+				return true;
+			}
+
+			count = registry->descriptions.size();
+			std::copy_n(registry->descriptions.cbegin(), count, controllers);
+			version = registry->version;
+			return true;
+		}
+
+		bool GetController(std::wstring_view uid, RawController::Description& description)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetController);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			if (!controller)
+				return false;
+
+			description = controller->description;
+			return true;
+		}
+
+		RawController::Handle Open(std::wstring_view uid)
+		{
+			g_calls.Count(EntryPoint::RawGameController_Open);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller ? controller->handle : RawController::kInvalidHandle;
+		}
 
-				ComPtr<IRawGameController2> controller2;
-				kv.second.As(&controller2);
+		bool IsConnected(RawController::Handle handle)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsConnectedByHandle);
+			return GetRControllers()->Find(handle) != nullptr;
+		}
 
-				HSTRING tmp_name;
-				controller2->get_DisplayName(&tmp_name);
+		bool IsConnected(std::wstring_view uid)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsConnected);
+			return GetRControllers()->Find(uid) != nullptr;
+		}
 
-				const std::wstring name = WindowsGetStringRawBuffer(tmp_name, nullptr);
+		bool GetState(RawController::Handle handle, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetStateByHandle);
+			return GetRControllerState(GetRControllers()->Find(handle), buttons, button_count, switches, switch_count, axis, axis_count, timestamp);
+		}
 
-				wcscpy_s(controllers[result].uid, kv.first.c_str());
-				wcscpy_s(controllers[result].display_name, name.c_str());
+		bool GetState(std::wstring_view uid, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetState);
+			return GetRControllerState(GetRControllers()->Find(uid), buttons, button_count, switches, switch_count, axis, axis_count, timestamp);
+		}
 
-				controllers[result].axis_count = 0;
-				kv.second->get_AxisCount((int*)&controllers[result].axis_count);
+		bool GetPackedState(RawController::Handle handle, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetPackedStateByHandle);
+			return GetPackedRControllerState(GetRControllers()->Find(handle), buttons, changed, previous, word_count, switches, switch_count, axis, axis_count, timestamp);
+		}
 
-				controllers[result].button_count = 0;
-				kv.second->get_ButtonCount((int*)&controllers[result].button_count);
+		bool GetPackedState(std::wstring_view uid, uint64_t* buttons, uint64_t* changed, uint64_t* previous, size_t word_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetPackedState);
+			return GetPackedRControllerState(GetRControllers()->Find(uid), buttons, changed, previous, word_count, switches, switch_count, axis, axis_count, timestamp);
+		}
 
-				controllers[result].switches_count = 0;
-				kv.second->get_SwitchCount((int*)&controllers[result].switches_count);
+		size_t GetAllStates(const RawController::Handle* handles, RawController::State* states, size_t count, uint64_t& connected)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetAllStatesByHandle);
+			connected = 0;
+			count = std::min<size_t>(count, 64); // one bit per entry in connected
 
-				++result;
+			const auto registry = GetRControllers();
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto* controller = registry->Find(handles[i]);
+				if (controller && ReadRController(*controller, states[i]))
+					connected |= 1ull << i;
+				else
+					ClearRControllerState(states[i]);
 			}
 
-			return result;
+			return count;
 		}
 
-		bool GetController(std::wstring_view uid, RawController::Description& description)
+		size_t GetAllStates(const std::wstring_view* uids, RawController::State* states, size_t count, uint64_t& connected)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::RawGameController_GetAllStates);
+			connected = 0;
+			count = std::min<size_t>(count, 64); // one bit per entry in connected
 
-			auto controller = it->second;
-			lock.unlock();
+			const auto registry = GetRControllers();
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto* controller = registry->Find(uids[i]);
+				if (controller && ReadRController(*controller, states[i]))
+					connected |= 1ull << i;
+				else
+					ClearRControllerState(states[i]);
+			}
+
+			return count;
+		}
+
+		bool HasVibration(RawController::Handle handle)
+		{
+			g_calls.Count(EntryPoint::RawGameController_HasVibrationByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			return controller && controller->device->HasVibration();
+		}
 
-			description.axis_count = 0;
-			controller->get_AxisCount((int*)&description.axis_count);
+		bool HasVibration(std::wstring_view uid)
+		{
+			g_calls.Count(EntryPoint::RawGameController_HasVibration);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller && controller->device->HasVibration();
+		}
 
-			description.button_count = 0;
-			controller->get_ButtonCount((int*)&description.button_count);
+		bool SetVibration(RawController::Handle handle, double vibration)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SetVibrationByHandle);
+			return SetRControllerVibration(GetRControllers()->Find(handle), vibration);
+		}
 
-			description.switches_count = 0;
-			controller->get_SwitchCount((int*)&description.switches_count);
-			return true;
+		bool SubmitVibration(RawController::Handle handle, double vibration)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SubmitVibrationByHandle);
+			return SubmitRControllerVibration(GetRControllers()->Find(handle), vibration);
 		}
 
-		bool IsConnected(std::wstring_view uid)
+		bool PlayEffect(RawController::Handle handle, const VibrationEffect& effect)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			return it != g_rcontrollers.cend();
+			g_calls.Count(EntryPoint::RawGameController_PlayEffectByHandle);
+			return PlayRControllerEffect(GetRControllers()->Find(handle), effect);
 		}
 
-		bool GetState(std::wstring_view uid, bool* buttons, size_t button_count, SwitchPosition* switches, size_t switch_count, double* axis, size_t axis_count, uint64_t& timestamp)
+		bool StopEffect(RawController::Handle handle)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::RawGameController_StopEffectByHandle);
+			return StopRControllerEffect(GetRControllers()->Find(handle));
+		}
 
-			ComPtr<IRawGameController> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
+		bool SetVibration(std::wstring_view uid, double vibration)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SetVibration);
+			return SetRControllerVibration(GetRControllers()->Find(uid), vibration);
+		}
 
-			static_assert(sizeof(bool) == sizeof(boolean));
-			hr = controller->GetCurrentReading((uint32_t)button_count, (boolean*)buttons, (uint32_t)switch_count, (GameControllerSwitchPosition*)switches, (uint32_t)axis_count, (double*)axis, &timestamp);
-			return SUCCEEDED(hr);
+		bool SubmitVibration(std::wstring_view uid, double vibration)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SubmitVibration);
+			return SubmitRControllerVibration(GetRControllers()->Find(uid), vibration);
 		}
 
-		bool HasVibration(std::wstring_view uid)
+		bool PlayEffect(std::wstring_view uid, const VibrationEffect& effect)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::RawGameController_PlayEffect);
+			return PlayRControllerEffect(GetRControllers()->Find(uid), effect);
+		}
 
-			ComPtr<IRawGameController2> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
+		bool StopEffect(std::wstring_view uid)
+		{
+			g_calls.Count(EntryPoint::RawGameController_StopEffect);
+			return StopRControllerEffect(GetRControllers()->Find(uid));
+		}
 
-			ComPtr<IVectorView<SimpleHapticsController*>> haptics;
-			hr = controller->get_SimpleHapticsControllers(&haptics);
-			if (FAILED(hr))
-				return false;
+		bool IsVibrating(RawController::Handle handle)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsVibratingByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			return controller && controller->device->IsVibrating();
+		}
 
-			uint32_t count = 0;
-			haptics->get_Size(&count); // motor_count (?)
+		bool IsVibrating(std::wstring_view uid)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsVibrating);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller && controller->device->IsVibrating();
+		}
 
-			for (uint32_t i = 0; i < count; ++i)
-			{
-				ISimpleHapticsController* haptic;
-				haptics->GetAt(i, &haptic);
+		bool IsWireless(RawController::Handle handle, bool& wireless)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsWirelessByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			return controller && GetDeviceWireless(*controller->device, *controller->status, wireless);
+		}
 
-				ComPtr<IVectorView<SimpleHapticsControllerFeedback*>> feedbacks;
-				hr = haptic->get_SupportedFeedback(&feedbacks);
-				if (FAILED(hr))
-					return false;
+		bool IsWireless(std::wstring_view uid, bool& wireless)
+		{
+			g_calls.Count(EntryPoint::RawGameController_IsWireless);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller && GetDeviceWireless(*controller->device, *controller->status, wireless);
+		}
 
-				uint32_t feedback_count = 0;
-				feedbacks->get_Size(&feedback_count);
-				for (uint32_t j = 0; j < feedback_count; ++j)
-				{
-					ISimpleHapticsControllerFeedback* feedback;
-					feedbacks->GetAt(j, &feedback);
+		bool GetBatteryStatus(RawController::Handle handle, BatteryStatus& status, double& battery)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetBatteryStatusByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			return controller && GetDeviceBatteryStatus(*controller->device, *controller->status, status, battery);
+		}
 
-					uint16_t waveform = 0;
-					feedback->get_Waveform(&waveform);
-					if (waveform == kRumbleContinuous)
-						return true;
-				}
-			}
+		bool GetBatteryStatus(std::wstring_view uid, BatteryStatus& status, double& battery)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetBatteryStatus);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller && GetDeviceBatteryStatus(*controller->device, *controller->status, status, battery);
+		}
 
-			return false;
+		bool SetProcessing(RawController::Handle handle, const AxisProcessing* axes, size_t count, uint64_t radial_sticks)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SetProcessingByHandle);
+			if (g_rcontroller_deferred)
+				StartDeferredRControllers();
+
+			return SetRControllerProcessing(handle, axes, count, radial_sticks);
 		}
 
-		bool SetVibration(std::wstring_view uid, double vibration)
+		bool SetProcessing(std::wstring_view uid, const AxisProcessing* axes, size_t count, uint64_t radial_sticks)
+		{
+			g_calls.Count(EntryPoint::RawGameController_SetProcessing);
+			if (g_rcontroller_deferred)
+				StartDeferredRControllers();
+
+			return SetRControllerProcessing(uid, axes, count, radial_sticks);
+		}
+
+		bool ToHostTime(RawController::Handle handle, uint64_t timestamp, uint64_t& host)
+		{
+			g_calls.Count(EntryPoint::RawGameController_ToHostTimeByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			return controller && controller->clock->ToHost(timestamp, host);
+		}
+
+		bool ToHostTime(std::wstring_view uid, uint64_t timestamp, uint64_t& host)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
+			g_calls.Count(EntryPoint::RawGameController_ToHostTime);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			return controller && controller->clock->ToHost(timestamp, host);
+		}
+
+		bool GetTimingStats(RawController::Handle handle, ReadingTimingStats& stats)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetTimingStatsByHandle);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(handle);
+			if (!controller)
 				return false;
 
-			ComPtr<IRawGameController2> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
-			
-			ComPtr<IVectorView<SimpleHapticsController*>> haptics;
-			hr = controller->get_SimpleHapticsControllers(&haptics);
-			assert(SUCCEEDED(hr));
-
-			bool result = false;
-			uint32_t count = 0;
-			haptics->get_Size(&count);
-			for (uint32_t i = 0; i < count; ++i)
-			{
-				ISimpleHapticsController* haptic;
-				haptics->GetAt(i, &haptic);
+			controller->clock->Get(stats);
+			return true;
+		}
 
-				if (vibration <= 0.000001)
-				{
-					haptic->StopFeedback();
-					continue;
-				}
+		bool GetTimingStats(std::wstring_view uid, ReadingTimingStats& stats)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetTimingStats);
+			const auto registry = GetRControllers();
+			const auto* controller = registry->Find(uid);
+			if (!controller)
+				return false;
 
-				ComPtr<IVectorView<SimpleHapticsControllerFeedback*>> feedbacks;
-				hr = haptic->get_SupportedFeedback(&feedbacks);
-				if (FAILED(hr))
-					return false;
+			controller->clock->Get(stats);
+			return true;
+		}
 
-				uint32_t feedback_count = 0;
-				feedbacks->get_Size(&feedback_count);
-				for (uint32_t j = 0; j < feedback_count; ++j)
-				{
-					ISimpleHapticsControllerFeedback* feedback;
-					feedbacks->GetAt(j, &feedback);
-
-					uint16_t waveform = 0;
-					feedback->get_Waveform(&waveform);
-					if (waveform == kRumbleContinuous)
-					{
-						haptic->SendHapticFeedbackWithIntensity(feedback, vibration);
-						result = true;
-						break;
-					}
-				}
-			}
-			return result;
+		bool GetButtonLabel(RawController::Handle handle, size_t button, ButtonLabel& label)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetButtonLabelByHandle);
+			return GetRControllerButtonLabel(GetRControllers()->Find(handle), button, label);
 		}
 
-		bool IsVibrating(std::wstring_view uid)
+		bool GetButtonLabel(std::wstring_view uid, size_t button, ButtonLabel& label)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetButtonLabel);
+			return GetRControllerButtonLabel(GetRControllers()->Find(uid), button, label);
+		}
+
+		bool GetCapabilities(RawController::Handle handle, RawController::Capabilities& capabilities, ButtonLabel* labels, size_t label_count)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
+			g_calls.Count(EntryPoint::RawGameController_GetCapabilitiesByHandle);
+			return GetRControllerCapabilities(GetRControllers()->Find(handle), capabilities, labels, label_count);
+		}
+
+		bool GetCapabilities(std::wstring_view uid, RawController::Capabilities& capabilities, ButtonLabel* labels, size_t label_count)
+		{
+			g_calls.Count(EntryPoint::RawGameController_GetCapabilities);
+			return GetRControllerCapabilities(GetRControllers()->Find(uid), capabilities, labels, label_count);
+		}
+	}
+
+	namespace SharedState
+	{
+		bool StartPublishing(std::wstring_view name, uint32_t frequency)
+		{
+			g_calls.Count(EntryPoint::SharedState_StartPublishing);
+			if (frequency == 0)
 				return false;
 
-			ComPtr<IRawGameController2> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
+			std::scoped_lock control_lock(g_publisher_control_mutex);
+			if (g_publisher.joinable())
+				return false;
 
-			ComPtr<IVectorView<SimpleHapticsController*>> haptics;
-			hr = controller->get_SimpleHapticsControllers(&haptics);
-			assert(SUCCEEDED(hr));
+			auto region = Region::Create(name, sizeof(Layout));
+			if (!region)
+				return false;
 
-			uint32_t count = 0;
-			haptics->get_Size(&count);
-			for (uint32_t i = 0; i < count; ++i)
-			{
-				ISimpleHapticsController* haptic;
-				haptics->GetAt(i, &haptic);
+			auto* layout = new (region->GetData()) Layout();
+			layout->version = kVersion;
+			layout->size = sizeof(Layout);
+			layout->magic.store(kMagic, std::memory_order_release);
 
-				ComPtr<IVectorView<SimpleHapticsControllerFeedback*>> feedbacks;
-				hr = haptic->get_SupportedFeedback(&feedbacks);
-				if (FAILED(hr))
-					return false;
+			if (g_rcontroller_deferred)
+				StartDeferredRControllers();
 
-				uint32_t feedback_count = 0;
-				feedbacks->get_Size(&feedback_count);
-				for (uint32_t j = 0; j < feedback_count; ++j)
-				{
-					ISimpleHapticsControllerFeedback* feedback;
-					feedbacks->GetAt(j, &feedback);
-
-					uint16_t waveform = 0;
-					feedback->get_Waveform(&waveform);
-					if (waveform == kRumbleContinuous)
-					{
-						ABI::Windows::Foundation::TimeSpan ts{};
-						feedback->get_Duration(&ts);
-						if (ts.Duration != 0)
-							return true;
-					}
-				}
+			{
+				std::scoped_lock lock(g_publisher_mutex);
+				g_publish_interval = std::chrono::nanoseconds(std::chrono::seconds(1)) / frequency;
+				g_publisher_stop = false;
 			}
-			return false;
+
+			g_publisher_region = std::move(region);
+			g_publisher = std::thread(PublisherThread, layout);
+			return true;
 		}
 
-		bool IsWireless(std::wstring_view uid, bool& wireless)
+		void StopPublishing()
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::SharedState_StopPublishing);
+			std::scoped_lock control_lock(g_publisher_control_mutex);
+			StopPublisher();
+		}
 
-			ComPtr<IGameController> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
+		const View* Open(std::wstring_view name)
+		{
+			g_calls.Count(EntryPoint::SharedState_Open);
+			auto region = Region::Open(name, sizeof(Layout));
+			if (!region)
+				return nullptr;
+
+			const auto* layout = static_cast<const Layout*>(region->GetData());
+			if (layout->magic.load(std::memory_order_acquire) != kMagic || layout->version != kVersion || layout->size != sizeof(Layout))
+				return nullptr;
 
-			static_assert(sizeof(bool) == sizeof(boolean));
-			return SUCCEEDED(controller->get_IsWireless((boolean*)&wireless));
+			return new View{ std::move(region), layout };
 		}
 
-		bool GetBatteryStatus(std::wstring_view uid, BatteryStatus& status, double& battery)
+		void Close(const View* view)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::SharedState_Close);
+			delete view;
+		}
 
-			ComPtr<IGameController> controller;
-			auto hr = it->second.As(&controller);
-			assert(SUCCEEDED(hr));
-			lock.unlock();
+		uint64_t GetUpdateTime(const View* view)
+		{
+			g_calls.Count(EntryPoint::SharedState_GetUpdateTime);
+			return view ? view->layout->update_time.load(std::memory_order_acquire) : 0;
+		}
 
-			ComPtr<IGameControllerBatteryInfo> battery_info;
-			hr = controller.As(&battery_info);
-			if(FAILED(hr) || !battery_info)
+		bool GetGamepadState(const View* view, size_t index, GamepadState& state)
+		{
+			g_calls.Count(EntryPoint::SharedState_GetGamepadState);
+			GamepadSlot slot;
+			if (!view || index >= kGamepadSlots || !LoadSlot(view->layout->gamepads[index], slot) || slot.generation == 0)
 				return false;
-			
-			return GetBatteryInfo(battery_info, status, battery);
+
+			state = slot.state;
+			return true;
 		}
 
-		bool GetButtonLabel(std::wstring_view uid, size_t button, ButtonLabel& label)
+		size_t GetRawControllers(const View* view, RawController::Description* controllers, RawController::Handle* handles, size_t count)
 		{
-			std::shared_lock lock(g_rcontroller_mutex);
-			const auto it = g_rcontrollers.find(uid);
-			if (it == g_rcontrollers.cend())
-				return false;
+			g_calls.Count(EntryPoint::SharedState_GetRawControllers);
+			if (!view)
+				return 0;
 
-			auto controller = it->second;
-			lock.unlock();
+			size_t written = 0;
+			for (size_t i = 0; i < kRawControllerSlots && written < count; ++i)
+			{
+				RawControllerInfo info;
+				if (!LoadSlot(view->layout->rcontroller_infos[i], info) || info.handle == RawController::kInvalidHandle)
+					continue;
+
+				if (controllers)
+				{
+					auto& description = controllers[written];
+					FromUtf16(info.uid, description.uid, std::size(description.uid));
+					FromUtf16(info.display_name, description.display_name, std::size(description.display_name));
+					description.button_count = info.button_count;
+					description.switches_count = info.switch_count;
+					description.axis_count = info.axis_count;
+				}
+
+				if (handles)
+					handles[written] = info.handle;
+
+				++written;
+			}
 
-			int max_count = 0;
-			controller->get_ButtonCount(&max_count);
-			if ((int)button >= max_count)
+			return written;
+		}
+
+		bool GetRawControllerState(const View* view, RawController::Handle handle, RawController::State& state)
+		{
+			g_calls.Count(EntryPoint::SharedState_GetRawControllerState);
+			const size_t index = (uint32_t)handle;
+			RawControllerSlot slot;
+			if (!view || handle == RawController::kInvalidHandle || index >= kRawControllerSlots
+				|| !LoadSlot(view->layout->rcontrollers[index], slot) || slot.handle != handle)
 				return false;
 
-			static_assert(sizeof(ButtonLabel) == sizeof(GameControllerButtonLabel));
-			return SUCCEEDED(controller->GetButtonLabel((int)button, (GameControllerButtonLabel*)&label));
+			// the slot is zero past the controller's counts, past the limits of the layout the rest is cleared here
+			const size_t button_count = std::min(state.button_count, kMaxButtons);
+			for (size_t i = 0; i < button_count; ++i)
+				state.buttons[i] = (slot.buttons[i / 64] >> (i % 64)) & 1;
+			std::fill(state.buttons + button_count, state.buttons + state.button_count, false);
+
+			const size_t switch_count = std::min(state.switch_count, kMaxSwitches);
+			for (size_t i = 0; i < switch_count; ++i)
+				state.switches[i] = (SwitchPosition)slot.switches[i];
+			std::fill(state.switches + switch_count, state.switches + state.switch_count, SwitchPosition::Center);
+
+			const size_t axis_count = std::min(state.axis_count, kMaxAxes);
+			std::copy_n(slot.axis, axis_count, state.axis);
+			std::fill(state.axis + axis_count, state.axis + state.axis_count, 0.0);
+			state.timestamp = slot.timestamp;
+			return true;
 		}
 	}
 }
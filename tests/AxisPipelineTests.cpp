@@ -0,0 +1,155 @@
+﻿#include "Test.h"
+#include "../bench/Exports.h"
+#include "../src/AxisPipeline.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	constexpr double kTolerance = 1e-12;
+
+	bool Near(double a, double b)
+	{
+		return std::abs(a - b) <= kTolerance;
+	}
+
+	GamepadState MakeGamepadState(uint64_t timestamp, double left_trigger, double right_trigger, double lx, double ly, double rx, double ry)
+	{
+		GamepadState state{};
+		state.Timestamp = timestamp;
+		state.LeftTrigger = left_trigger;
+		state.RightTrigger = right_trigger;
+		state.LeftThumbstickX = lx;
+		state.LeftThumbstickY = ly;
+		state.RightThumbstickX = rx;
+		state.RightThumbstickY = ry;
+		return state;
+	}
+}
+
+TEST(AxisProcessingDefaults)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+
+	// gamepad: per axis the defaults are the identity everywhere, the radial sticks inside the unit circle
+	const auto pad = backend->AddGamepad();
+	GamepadProcessing processing;
+	const GamepadState radial_readings[] = {
+		MakeGamepadState(1, 0, 1, 0, 0, 0.5, -0.5),
+		MakeGamepadState(2, 0.25, 0.75, -1, 0, 0, 1),
+		MakeGamepadState(3, 1, 0, 0.6, -0.8, -0.3, 0.1),
+	};
+	const GamepadState axis_readings[] = {
+		MakeGamepadState(4, 0.5, 0.1, 1, 1, -1, -1),
+		MakeGamepadState(5, 0.9, 0.4, -0.75, 0.75, 0.05, -0.95),
+	};
+	for (const bool radial : { true, false })
+	{
+		processing.radial_left_stick = radial;
+		processing.radial_right_stick = radial;
+		CHECK(Gamepad::SetProcessing(0, &processing));
+		for (const auto& reading : radial ? std::vector(std::begin(radial_readings), std::end(radial_readings)) : std::vector(std::begin(axis_readings), std::end(axis_readings)))
+		{
+			CHECK(backend->SetGamepadState(pad, reading));
+			GamepadState state;
+			CHECK(Gamepad::GetState(0, state));
+			CHECK(Near(state.LeftTrigger, reading.LeftTrigger) && Near(state.RightTrigger, reading.RightTrigger));
+			CHECK(Near(state.LeftThumbstickX, reading.LeftThumbstickX) && Near(state.LeftThumbstickY, reading.LeftThumbstickY));
+			CHECK(Near(state.RightThumbstickX, reading.RightThumbstickX) && Near(state.RightThumbstickY, reading.RightThumbstickY));
+		}
+	}
+
+	// raw axes read 0 .. 1, axes 2 and 3 are a radial stick
+	const auto raw = backend->AddRawController(L"raw", L"Raw", 0, 0, 4);
+	AxisProcessing axes[4];
+	CHECK(RawGameController::SetProcessing(L"raw", axes, 4, 0b10));
+	const double raw_readings[][4] = {
+		{ 0, 1, 0.5, 0.5 },
+		{ 0.25, 0.75, 0.1, 0.5 },
+		{ 0.5, 0.05, 0.8, 0.2 },
+	};
+	const auto read = [&](const double (&reading)[4], double (&axis)[4])
+	{
+		CHECK(backend->SetRawControllerState(raw, nullptr, nullptr, reading));
+		uint64_t timestamp;
+		return RawGameController::GetState(L"raw", nullptr, 0, nullptr, 0, axis, 4, timestamp);
+	};
+	for (const auto& reading : raw_readings)
+	{
+		double axis[4];
+		CHECK(read(reading, axis));
+		for (size_t i = 0; i < 4; ++i)
+			CHECK(Near(axis[i], reading[i]));
+	}
+
+	// only a deadzone keeps the raw center at 0.5 and the extremes where they are
+	axes[0].deadzone = 0.2;
+	CHECK(RawGameController::SetProcessing(L"raw", axes, 1, 0));
+	const double deadzone_readings[][4] = { { 0.5 }, { 0.55 }, { 0 }, { 1 } };
+	const double deadzone_expected[] = { 0.5, 0.5, 0, 1 };
+	for (size_t i = 0; i < std::size(deadzone_readings); ++i)
+	{
+		double axis[4];
+		CHECK(read(deadzone_readings[i], axis));
+		CHECK(Near(axis[0], deadzone_expected[i]));
+	}
+
+	backend->RemoveAll();
+	Backend::SetBackend(nullptr);
+}
+
+TEST(AxisPipelineKernels)
+{
+	// Process (two lanes per SSE2 register where available) and the scalar fallback agree on random configurations
+	std::mt19937 random(15);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	const auto make_axis = [&]
+	{
+		AxisProcessing axis;
+		axis.min = -0.2 - 0.8 * unit(random);
+		axis.center = unit(random) < 0.25 ? axis.min : axis.min + (0.4 - axis.min) * unit(random);
+		axis.max = 0.5 + 0.5 * unit(random);
+		axis.deadzone = 0.5 * unit(random);
+		axis.saturation = 0.5 + 0.5 * unit(random);
+		axis.curve = unit(random);
+		axis.invert = unit(random) < 0.5;
+		return axis;
+	};
+
+	for (size_t trial = 0; trial < 500; ++trial)
+	{
+		AxisPipeline pipeline(trial % 2 == 0 ? 0.0 : 0.5, trial % 2 == 0 ? 1.0 : 0.5);
+		while (pipeline.GetLaneCount() < 9)
+		{
+			const double kind = unit(random);
+			if (kind < 0.4)
+				pipeline.AddStick(make_axis(), make_axis());
+			else if (kind < 0.9)
+				pipeline.Add(make_axis());
+			else
+				pipeline.AddIdentity();
+		}
+
+		const size_t count = pipeline.GetLaneCount();
+		std::vector<double> values(count);
+		for (auto& value : values)
+			value = -1.2 + 2.4 * unit(random);
+		if (trial % 5 == 0)
+			values[0] = 0; // centered stick, 0 / 0 deflection
+
+		auto vector = values;
+		auto scalar = values;
+		pipeline.Process(vector.data(), 0, count);
+		pipeline.ProcessScalar(scalar.data(), 0, count);
+		for (size_t i = 0; i < count; ++i)
+			CHECK(Near(vector[i], scalar[i]));
+	}
+}
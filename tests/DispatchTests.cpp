@@ -0,0 +1,112 @@
+﻿#include "Test.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace WindowsGamingInput;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	constexpr size_t kEvents = 16;
+	constexpr auto kCallbackTime = std::chrono::milliseconds(2);
+	constexpr auto kEventSpacing = std::chrono::microseconds(500);
+	constexpr auto kWakeup = std::chrono::milliseconds(10); // generous, sanitizer builds wake slowly
+
+	struct Delivery
+	{
+		Clock::time_point start;
+		Clock::time_point end;
+	};
+
+	std::array<Delivery, kEvents * 2> g_deliveries;
+	std::atomic_size_t g_delivered = 0;
+
+	void SlowCallback(EventType, ControllerType, std::variant<size_t, std::wstring_view>)
+	{
+		const size_t index = g_delivered.load();
+		g_deliveries[index].start = Clock::now();
+		std::this_thread::sleep_for(kCallbackTime);
+		g_deliveries[index].end = Clock::now();
+		g_delivered = index + 1;
+	}
+
+	bool WaitForDeliveries(size_t count)
+	{
+		const auto deadline = Clock::now() + std::chrono::seconds(10);
+		while (g_delivered < count && Clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return g_delivered == count;
+	}
+
+	// events are delivered in order, so event i is delayed by the callbacks still running or queued before it, plus one wakeup
+	Clock::duration CheckLatencies(const std::vector<Clock::time_point>& queued, size_t first)
+	{
+		Clock::duration max_latency{};
+		for (size_t i = 0; i < queued.size(); ++i)
+		{
+			const Delivery& delivery = g_deliveries[first + i];
+			Clock::duration bound = kWakeup;
+			for (size_t j = first; j < first + i; ++j)
+			{
+				if (g_deliveries[j].end > queued[i])
+					bound += g_deliveries[j].end - std::max(g_deliveries[j].start, queued[i]);
+			}
+
+			const auto latency = delivery.start - queued[i];
+			CHECK(latency >= Clock::duration::zero());
+			CHECK(latency <= bound);
+			max_latency = std::max(max_latency, latency);
+		}
+		return max_latency;
+	}
+}
+
+TEST(DispatchLatency)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+	AddControllerChanged(&SlowCallback);
+
+	// hot-plugs arrive faster than the callback returns, so a backlog builds up behind it
+	std::vector<Backend::FakeBackend::DeviceId> ids;
+	std::vector<Clock::time_point> queued;
+	for (size_t i = 0; i < kEvents; ++i)
+	{
+		queued.emplace_back(Clock::now());
+		ids.emplace_back(backend->AddGamepad());
+		std::this_thread::sleep_for(kEventSpacing);
+	}
+	CHECK(WaitForDeliveries(kEvents));
+	const auto added_latency = CheckLatencies(queued, 0);
+
+	// removes only after the adds were delivered, otherwise they cancel out
+	queued.clear();
+	for (const auto id : ids)
+	{
+		queued.emplace_back(Clock::now());
+		backend->Remove(id);
+		std::this_thread::sleep_for(kEventSpacing);
+	}
+	CHECK(WaitForDeliveries(kEvents * 2));
+	const auto removed_latency = CheckLatencies(queued, kEvents);
+
+	// the backlog really queued events behind the slow callback
+	CHECK(added_latency > kCallbackTime);
+	CHECK(removed_latency > kCallbackTime);
+
+	ControllerChangedStats stats;
+	GetControllerChangedStats(stats);
+	CHECK(stats.delivered == kEvents * 2);
+	CHECK(stats.coalesced == 0);
+	CHECK(stats.max_latency <= uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(added_latency, removed_latency)).count()));
+
+	RemoveControllerChanged(&SlowCallback);
+	Backend::SetBackend(nullptr);
+}
@@ -0,0 +1,47 @@
+﻿#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Test
+{
+	namespace
+	{
+		size_t g_failures = 0;
+	}
+
+	std::vector<Case>& GetCases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	void Fail(const char* file, int line, const char* expression)
+	{
+		std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+		++g_failures;
+	}
+}
+
+// usage: WinGamingInputTests [name], runs all tests without a name
+int main(int argc, char** argv)
+{
+	size_t run = 0;
+	for (const auto& test : Test::GetCases())
+	{
+		if (argc > 1 && std::strcmp(argv[1], test.name) != 0)
+			continue;
+
+		std::printf("%s\n", test.name);
+		test.run();
+		++run;
+	}
+
+	if (run == 0)
+	{
+		std::fprintf(stderr, "no test named %s\n", argc > 1 ? argv[1] : "");
+		return 1;
+	}
+
+	return Test::g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+﻿#include "Test.h"
+#include "../include/WindowsGamingInput.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	bool Equal(const PackedGamepadState& a, const PackedGamepadState& b)
+	{
+		return a.Buttons == b.Buttons && a.TimestampDelta == b.TimestampDelta && a.LeftTrigger == b.LeftTrigger && a.RightTrigger == b.RightTrigger &&
+			a.LeftThumbstickX == b.LeftThumbstickX && a.LeftThumbstickY == b.LeftThumbstickY &&
+			a.RightThumbstickX == b.RightThumbstickX && a.RightThumbstickY == b.RightThumbstickY;
+	}
+
+	GamepadState MakeState(double trigger, double stick)
+	{
+		GamepadState state{};
+		state.Timestamp = 1000;
+		state.LeftTrigger = trigger;
+		state.RightTrigger = trigger;
+		state.LeftThumbstickX = stick;
+		state.LeftThumbstickY = stick;
+		state.RightThumbstickX = stick;
+		state.RightThumbstickY = stick;
+		return state;
+	}
+}
+
+TEST(PackedSticks)
+{
+	// -1, 0 and +1 are exact steps and come back unchanged, out of range values and NaN are clamped
+	const struct { double value; int16_t packed; double unpacked; } cases[] = {
+		{ -1.0, -32767, -1.0 },
+		{ 0.0, 0, 0.0 },
+		{ 1.0, 32767, 1.0 },
+		{ -2.0, -32767, -1.0 },
+		{ 2.0, 32767, 1.0 },
+		{ std::numeric_limits<double>::quiet_NaN(), 0, 0.0 },
+	};
+	for (const auto& test : cases)
+	{
+		const auto packed = PackGamepadState(MakeState(0, test.value), 1000);
+		CHECK(packed.LeftThumbstickX == test.packed && packed.LeftThumbstickY == test.packed);
+		CHECK(packed.RightThumbstickX == test.packed && packed.RightThumbstickY == test.packed);
+
+		const auto state = UnpackGamepadState(packed, 1000);
+		CHECK(state.LeftThumbstickX == test.unpacked && state.LeftThumbstickY == test.unpacked);
+		CHECK(state.RightThumbstickX == test.unpacked && state.RightThumbstickY == test.unpacked);
+	}
+}
+
+TEST(PackedTriggers)
+{
+	const struct { double value; uint16_t packed; double unpacked; } cases[] = {
+		{ 0.0, 0, 0.0 },
+		{ 1.0, 65535, 1.0 },
+		{ -0.5, 0, 0.0 },
+		{ 1.5, 65535, 1.0 },
+		{ std::numeric_limits<double>::quiet_NaN(), 0, 0.0 },
+	};
+	for (const auto& test : cases)
+	{
+		GamepadState state = MakeState(0, 0);
+		state.LeftTrigger = test.value;
+		state.RightTrigger = 1.0 - (test.value == test.value ? test.value : 0.0);
+
+		const auto packed = PackGamepadState(state, 1000);
+		CHECK(packed.LeftTrigger == test.packed);
+		CHECK(packed.RightTrigger == (uint16_t)(65535 - test.packed)); // the other extreme on the other trigger
+
+		const auto unpacked = UnpackGamepadState(packed, 1000);
+		CHECK(unpacked.LeftTrigger == test.unpacked);
+		CHECK(unpacked.RightTrigger == 1.0 - test.unpacked);
+	}
+}
+
+TEST(PackedButtons)
+{
+	// every button bit on its own and all of them, none of them spills into TimestampDelta
+	for (uint32_t bit = 0; bit <= 18; ++bit)
+	{
+		GamepadState state = MakeState(0, 0);
+		state.Buttons = (GamepadButtons)(bit == 18 ? 0x3FFFF : 1u << bit);
+
+		const auto packed = PackGamepadState(state, state.Timestamp);
+		CHECK(packed.Buttons == (uint32_t)state.Buttons);
+		CHECK(packed.TimestampDelta == 0);
+		CHECK(UnpackGamepadState(packed, state.Timestamp).Buttons == state.Buttons);
+	}
+}
+
+TEST(PackedTimestampDelta)
+{
+	const GamepadState state = MakeState(0, 0);
+	const struct { uint64_t timestamp; uint32_t delta; } cases[] = {
+		{ state.Timestamp, 0 },
+		{ state.Timestamp - 1, 0 }, // a reading newer than the full timestamp
+		{ state.Timestamp + 1, 1 },
+		{ state.Timestamp + kMaxPackedTimestampDelta - 1, kMaxPackedTimestampDelta - 1 },
+		{ state.Timestamp + kMaxPackedTimestampDelta, kMaxPackedTimestampDelta },
+		{ state.Timestamp + kMaxPackedTimestampDelta + 1, kMaxPackedTimestampDelta },
+		{ state.Timestamp + 1000000000, kMaxPackedTimestampDelta },
+	};
+	CHECK(kMaxPackedTimestampDelta == 16383);
+	for (const auto& test : cases)
+	{
+		const auto packed = PackGamepadState(state, test.timestamp);
+		CHECK(packed.TimestampDelta == test.delta);
+		CHECK(packed.Buttons == 0);
+		CHECK(UnpackGamepadState(packed, test.timestamp).Timestamp == test.timestamp - test.delta);
+	}
+}
+
+TEST(PackedRoundTrip)
+{
+	// unpacking is within half a step of the reading, packing the unpacked state again is exact
+	std::mt19937 random(16);
+	std::uniform_real_distribution<double> stick(-1.0, 1.0);
+	std::uniform_real_distribution<double> trigger(0.0, 1.0);
+	for (size_t i = 0; i < 100000; ++i)
+	{
+		GamepadState state{};
+		state.Timestamp = 5000;
+		state.Buttons = (GamepadButtons)(random() & 0x3FFFF);
+		state.LeftTrigger = trigger(random);
+		state.RightTrigger = trigger(random);
+		state.LeftThumbstickX = stick(random);
+		state.LeftThumbstickY = stick(random);
+		state.RightThumbstickX = stick(random);
+		state.RightThumbstickY = stick(random);
+		const uint64_t timestamp = state.Timestamp + random() % 20000;
+
+		const auto packed = PackGamepadState(state, timestamp);
+		const auto unpacked = UnpackGamepadState(packed, timestamp);
+		CHECK(std::abs(unpacked.LeftTrigger - state.LeftTrigger) <= 1.0 / 131070);
+		CHECK(std::abs(unpacked.RightTrigger - state.RightTrigger) <= 1.0 / 131070);
+		CHECK(std::abs(unpacked.LeftThumbstickX - state.LeftThumbstickX) <= 1.0 / 65534);
+		CHECK(std::abs(unpacked.LeftThumbstickY - state.LeftThumbstickY) <= 1.0 / 65534);
+		CHECK(std::abs(unpacked.RightThumbstickX - state.RightThumbstickX) <= 1.0 / 65534);
+		CHECK(std::abs(unpacked.RightThumbstickY - state.RightThumbstickY) <= 1.0 / 65534);
+		CHECK(unpacked.Buttons == state.Buttons);
+		CHECK(Equal(PackGamepadState(unpacked, timestamp), packed));
+	}
+}
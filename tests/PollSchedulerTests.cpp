@@ -0,0 +1,204 @@
+﻿#include "Test.h"
+#include "../src/PollScheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	constexpr uint64_t kStart = 1000000;
+	constexpr uint64_t kDeviceClock = 12345; // device timestamp of the report at kStart
+
+	// report k is stamped kDeviceClock + k * period and readable GetDelay(k) µs after it, only the first reports are sent
+	struct FakeDevice
+	{
+		uint64_t period;
+		size_t reports = SIZE_MAX;
+		std::vector<std::pair<size_t, uint64_t>> delays; // report, extra delay
+
+		uint64_t GetDelay(size_t report) const
+		{
+			for (const auto& [delayed, delay] : delays)
+			{
+				if (delayed == report)
+					return delay;
+			}
+			return 0;
+		}
+
+		uint64_t GetVisible(size_t report) const
+		{
+			return kStart + report * period + GetDelay(report);
+		}
+
+		// timestamp of the newest readable report, 0 before the first
+		uint64_t Read(uint64_t now, size_t& report) const
+		{
+			report = SIZE_MAX;
+			for (size_t k = 0; k < reports && kStart + k * period <= now; ++k)
+			{
+				if (GetVisible(k) <= now)
+					report = k;
+			}
+			return report == SIZE_MAX ? 0 : kDeviceClock + report * period;
+		}
+	};
+
+	// drives one slot like the poller: read when due, then Update
+	struct Simulation
+	{
+		PollScheduler scheduler;
+		const FakeDevice& device;
+		uint64_t now = kStart;
+		size_t last_report = SIZE_MAX;
+		bool started = false;
+
+		Simulation(const FakeDevice& device, uint64_t min_interval)
+			: device(device)
+		{
+			scheduler.SetMinInterval(min_interval);
+		}
+
+		// returns true if the read found a new report
+		bool Step()
+		{
+			if (started)
+				now = std::max(now, scheduler.NextDue(now));
+			started = true;
+
+			size_t report;
+			const uint64_t timestamp = device.Read(now, report);
+			const bool found = report != SIZE_MAX && report != last_report;
+			if (found)
+				last_report = report;
+
+			scheduler.Update(0, now, timestamp);
+			return found;
+		}
+
+		// steps until report is found, returns the number of reads
+		size_t RunUntil(size_t report)
+		{
+			size_t reads = 0;
+			while (last_report == SIZE_MAX || last_report < report)
+			{
+				Step();
+				++reads;
+			}
+			return reads;
+		}
+	};
+}
+
+TEST(PollSchedulerInterval)
+{
+	// 125 Hz and 1000 Hz with a 1000 Hz poll: the interval is learned and every report takes one read right after it
+	for (const uint64_t period : { 8000, 1000 })
+	{
+		const FakeDevice device{ period };
+		Simulation simulation(device, 1000);
+		simulation.RunUntil(300);
+		CHECK(simulation.scheduler.GetInterval(0) == period);
+		CHECK(simulation.scheduler.GetMargin(0) == PollScheduler::kMinMargin);
+
+		for (size_t report = 301; report <= 400; ++report)
+		{
+			CHECK(simulation.RunUntil(report) == 1);
+			CHECK(simulation.now - device.GetVisible(report) == PollScheduler::kMinMargin);
+		}
+	}
+
+	// with the poll slowed down below the learned rate every read is one poll interval after the last
+	const FakeDevice fast{ 1000 };
+	Simulation simulation(fast, 1000);
+	simulation.RunUntil(100);
+	CHECK(simulation.scheduler.GetInterval(0) == 1000);
+	simulation.scheduler.SetMinInterval(4000);
+	simulation.Step();
+	for (size_t i = 0; i < 50; ++i)
+	{
+		const uint64_t before = simulation.now;
+		CHECK(simulation.Step());
+		CHECK(simulation.now - before == 4000);
+	}
+}
+
+TEST(PollSchedulerMargin)
+{
+	// report 200 comes 6000 µs late, the margin doubles on every early read up to half the interval.
+	// 201 is late as well so it isn't out yet when 200 is found
+	const FakeDevice device{ 8000, SIZE_MAX, { { 200, 6000 }, { 201, 2000 } } };
+	Simulation simulation(device, 1000);
+
+	// from the initial margin every report found on time takes a 16th off, down to kMinMargin
+	simulation.RunUntil(5);
+	uint64_t margin = simulation.scheduler.GetMargin(0);
+	for (size_t report = 6; report < 200; ++report)
+	{
+		simulation.RunUntil(report);
+		const uint64_t expected = std::max(margin - std::max<uint64_t>(margin / 16, 1), PollScheduler::kMinMargin);
+		CHECK(simulation.scheduler.GetMargin(0) == expected);
+		margin = expected;
+	}
+	CHECK(margin == PollScheduler::kMinMargin);
+
+	std::vector<uint64_t> margins;
+	while (!simulation.Step())
+		margins.emplace_back(simulation.scheduler.GetMargin(0));
+
+	const std::vector<uint64_t> doubled = { 20, 40, 80, 160, 320, 640, 1280, 2560, 4000 };
+	CHECK(margins == doubled);
+	CHECK(simulation.last_report == 200);
+	CHECK(simulation.now == device.GetVisible(200) - 6000 + 10 + 20 + 40 + 80 + 160 + 320 + 640 + 1280 + 2560 + 4000);
+
+	// found again, so it shrinks from the cap. the late report doesn't change the interval
+	CHECK(simulation.scheduler.GetMargin(0) == 4000 - 4000 / 16);
+	CHECK(simulation.scheduler.GetInterval(0) == 8000);
+	simulation.RunUntil(201);
+	CHECK(simulation.scheduler.GetMargin(0) == 3750 - 3750 / 16);
+}
+
+TEST(PollSchedulerIdle)
+{
+	// 50 reports at 125 Hz, then the gamepad goes quiet
+	FakeDevice device{ 8000, 50 };
+	Simulation simulation(device, 1000);
+	simulation.RunUntil(49);
+
+	// retries within the interval of the missing report, then backs off from the poll interval to kMaxIdleInterval
+	std::vector<uint64_t> gaps;
+	while (gaps.size() < 20)
+	{
+		const uint64_t before = simulation.now;
+		CHECK(!simulation.Step());
+		gaps.emplace_back(simulation.now - before);
+		CHECK(simulation.scheduler.NextDue(simulation.now) <= simulation.now + PollScheduler::kMaxIdleInterval);
+	}
+
+	const auto idle = std::find(gaps.begin(), gaps.end(), 1000);
+	CHECK(idle != gaps.end());
+	const std::vector<uint64_t> backoff = { 1000, 2000, 4000, 8000, 16000, 16000, 16000 };
+	CHECK(std::equal(backoff.begin(), backoff.end(), idle));
+	CHECK(std::all_of(idle + backoff.size(), gaps.end(), [](uint64_t gap) { return gap == PollScheduler::kMaxIdleInterval; }));
+
+	// once it reports again the next read finds it within kMaxIdleInterval and the back off ends
+	device.reports = SIZE_MAX;
+	const size_t resumed = (simulation.now - kStart) / device.period + 1;
+	simulation.RunUntil(resumed);
+	CHECK(simulation.now - device.GetVisible(resumed) <= PollScheduler::kMaxIdleInterval);
+	CHECK(simulation.scheduler.GetInterval(0) == 8000);
+	CHECK(simulation.RunUntil(resumed + 1) <= 2);
+
+	// failing reads back off the same way
+	PollScheduler scheduler;
+	scheduler.SetMinInterval(1000);
+	uint64_t now = kStart;
+	for (const uint64_t gap : backoff)
+	{
+		scheduler.Update(1, now, 0);
+		CHECK(scheduler.NextDue(now) == now + gap);
+		now += gap;
+	}
+}
@@ -0,0 +1,131 @@
+﻿#include "Test.h"
+#include "../bench/Exports.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+
+using namespace WindowsGamingInput;
+
+TEST(RawGetAllStates)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+
+	const auto first = backend->AddRawController(L"first", L"First", 2, 1, 2);
+	const auto second = backend->AddRawController(L"second", L"Second", 2, 1, 2);
+	const bool buttons[2] = { true, false };
+	const SwitchPosition switches[1] = { SwitchPosition::Left };
+	const double axis[2] = { 0.25, 0.75 };
+	CHECK(backend->SetRawControllerState(first, buttons, switches, axis, 11));
+	CHECK(backend->SetRawControllerState(second, buttons, switches, axis, 22));
+
+	const RawController::Handle first_handle = RawGameController::Open(L"first");
+	const RawController::Handle second_handle = RawGameController::Open(L"second");
+	CHECK(first_handle != RawController::kInvalidHandle && second_handle != RawController::kInvalidHandle);
+	CHECK(backend->Remove(second));
+
+	// whatever the caller had in the entries of missing controllers gets zeroed
+	bool state_buttons[3][2];
+	SwitchPosition state_switches[3][1];
+	double state_axis[3][2];
+	RawController::State states[3];
+	const auto fill = [&]
+	{
+		for (size_t i = 0; i < 3; ++i)
+		{
+			std::fill_n(state_buttons[i], 2, true);
+			std::fill_n(state_switches[i], 1, SwitchPosition::UpLeft);
+			std::fill_n(state_axis[i], 2, -5.0);
+			states[i] = { state_buttons[i], 2, state_switches[i], 1, state_axis[i], 2, 99 };
+		}
+	};
+	const auto check = [&](uint64_t connected)
+	{
+		CHECK(connected == 0b001);
+		CHECK(states[0].timestamp == 11);
+		CHECK(state_buttons[0][0] && !state_buttons[0][1]);
+		CHECK(state_switches[0][0] == SwitchPosition::Left);
+		CHECK(state_axis[0][0] == 0.25 && state_axis[0][1] == 0.75);
+		for (size_t i = 1; i < 3; ++i)
+		{
+			CHECK(states[i].timestamp == 0);
+			CHECK(!state_buttons[i][0] && !state_buttons[i][1]);
+			CHECK(state_switches[i][0] == SwitchPosition::Center);
+			CHECK(state_axis[i][0] == 0.0 && state_axis[i][1] == 0.0);
+		}
+	};
+
+	uint64_t connected = ~0ull;
+	fill();
+	const std::wstring_view uids[3] = { L"first", L"second", L"missing" };
+	CHECK(RawGameController::GetAllStates(uids, states, 3, connected) == 3);
+	check(connected);
+
+	connected = ~0ull;
+	fill();
+	const RawController::Handle handles[3] = { first_handle, second_handle, RawController::kInvalidHandle };
+	CHECK(RawGameController::GetAllStates(handles, states, 3, connected) == 3);
+	check(connected);
+
+	backend->RemoveAll();
+	Backend::SetBackend(nullptr);
+}
+
+TEST(RawPackedChanged)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+
+	constexpr size_t kButtons = 70;
+	const auto id = backend->AddRawController(L"packed", L"Packed", kButtons, 0, 0);
+	bool buttons[kButtons]{};
+	const auto set = [&](size_t button, bool pressed)
+	{
+		buttons[button] = pressed;
+		CHECK(backend->SetRawControllerState(id, buttons, nullptr, nullptr));
+	};
+
+	// every reader owns its previous buttons and sees every edge, no matter how the reads interleave
+	struct Reader
+	{
+		uint64_t buttons[3];
+		uint64_t changed[3];
+		uint64_t previous[3]{};
+
+		bool Read()
+		{
+			uint64_t timestamp;
+			return RawGameController::GetPackedState(L"packed", buttons, changed, previous, std::size(buttons), nullptr, 0, nullptr, 0, timestamp);
+		}
+	};
+	Reader game, ui;
+
+	set(3, true);
+	set(65, true);
+	CHECK(game.Read());
+	CHECK(game.buttons[0] == 1ull << 3 && game.buttons[1] == 1ull << 1 && game.buttons[2] == 0);
+	CHECK(game.changed[0] == 1ull << 3 && game.changed[1] == 1ull << 1 && game.changed[2] == 0);
+	CHECK(ui.Read());
+	CHECK(ui.changed[0] == 1ull << 3 && ui.changed[1] == 1ull << 1);
+
+	set(3, false);
+	CHECK(game.Read());
+	CHECK(game.changed[0] == 1ull << 3 && game.changed[1] == 0);
+	CHECK(game.Read());
+	CHECK(game.changed[0] == 0 && game.changed[1] == 0);
+	CHECK(ui.Read());
+	CHECK(ui.changed[0] == 1ull << 3 && ui.changed[1] == 0);
+	CHECK(ui.previous[0] == 0 && ui.previous[1] == 1ull << 1);
+
+	// without previous the changes are against no buttons pressed
+	uint64_t packed[2], changed[2];
+	uint64_t timestamp;
+	CHECK(RawGameController::GetPackedState(L"packed", packed, changed, nullptr, std::size(packed), nullptr, 0, nullptr, 0, timestamp));
+	CHECK(changed[0] == packed[0] && changed[1] == packed[1]);
+
+	backend->RemoveAll();
+	Backend::SetBackend(nullptr);
+}
@@ -0,0 +1,338 @@
+﻿#include "Test.h"
+#include "../bench/Exports.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+#include "../src/RecordingFormat.h"
+#include "../src/ReplayBackend.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	constexpr size_t kSlots = 6;
+	const std::wstring_view kRawUids[] = { L"raw-a", L"raw-b" };
+
+	struct RawCapture
+	{
+		bool connected = false;
+		bool buttons[3]{};
+		SwitchPosition switches[1]{};
+		double axis[2]{};
+		uint64_t timestamp = 0;
+	};
+
+	// everything the API reports at one point of the session
+	struct Capture
+	{
+		std::array<bool, kSlots> connected{};
+		std::array<GamepadState, kSlots> gamepads{};
+		std::array<RawCapture, std::size(kRawUids)> controllers{};
+	};
+
+	struct Session
+	{
+		std::vector<Capture> captures;
+		std::vector<uint64_t> times; // µs since the start of the recording of each capture
+	};
+
+	std::filesystem::path GetPath(const char* name)
+	{
+		return std::filesystem::temp_directory_path() / ("WinGamingInputTest-" + std::to_string(getpid()) + "-" + name + ".wgir");
+	}
+
+	std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}
+
+	void WriteFile(const std::filesystem::path& path, const uint8_t* data, size_t size)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write((const char*)data, (std::streamsize)size);
+	}
+
+	// the reads also record the readings
+	Capture Read()
+	{
+		Capture capture;
+		for (size_t i = 0; i < kSlots; ++i)
+			capture.connected[i] = Gamepad::GetState(i, capture.gamepads[i]);
+
+		for (size_t i = 0; i < std::size(kRawUids); ++i)
+		{
+			auto& controller = capture.controllers[i];
+			controller.connected = RawGameController::GetState(kRawUids[i], controller.buttons, 3, controller.switches, 1, controller.axis, 2, controller.timestamp);
+		}
+		return capture;
+	}
+
+	bool Equal(const GamepadState& a, const GamepadState& b)
+	{
+		return a.Timestamp == b.Timestamp && a.Buttons == b.Buttons && a.LeftTrigger == b.LeftTrigger && a.RightTrigger == b.RightTrigger &&
+			a.LeftThumbstickX == b.LeftThumbstickX && a.LeftThumbstickY == b.LeftThumbstickY &&
+			a.RightThumbstickX == b.RightThumbstickX && a.RightThumbstickY == b.RightThumbstickY;
+	}
+
+	void CheckEqual(const Capture& replayed, const Capture& recorded)
+	{
+		for (size_t i = 0; i < kSlots; ++i)
+		{
+			CHECK(replayed.connected[i] == recorded.connected[i]);
+			if (recorded.connected[i])
+				CHECK(Equal(replayed.gamepads[i], recorded.gamepads[i]));
+		}
+
+		for (size_t i = 0; i < std::size(kRawUids); ++i)
+		{
+			const auto& a = replayed.controllers[i];
+			const auto& b = recorded.controllers[i];
+			CHECK(a.connected == b.connected);
+			if (!b.connected)
+				continue;
+
+			CHECK(std::equal(std::begin(a.buttons), std::end(a.buttons), std::begin(b.buttons)));
+			CHECK(a.switches[0] == b.switches[0]);
+			CHECK(a.axis[0] == b.axis[0] && a.axis[1] == b.axis[1]);
+			CHECK(a.timestamp == b.timestamp);
+		}
+	}
+
+	GamepadState MakeGamepadState(uint64_t timestamp, double value)
+	{
+		GamepadState state{};
+		state.Timestamp = timestamp;
+		state.Buttons = (GamepadButtons)(timestamp & 0x3FFFF);
+		state.LeftTrigger = value;
+		state.RightThumbstickY = -value;
+		return state;
+	}
+
+	// captures are taken well apart from the records around them, so AdvanceTo(time) lands exactly on a capture
+	void Checkpoint(Session& session, std::chrono::steady_clock::time_point start)
+	{
+		session.captures.emplace_back(Read());
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		session.times.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// hot-plugs fake devices while recording. the last record is the disconnect of the gamepad in slot 1
+	Session RecordSession(const std::filesystem::path& path)
+	{
+		auto backend = std::make_shared<Backend::FakeBackend>();
+		Backend::SetBackend(backend);
+
+		// slot 3 and then slot 1 get freed before the recording starts, the replay frees them in ascending order
+		std::array<Backend::FakeBackend::DeviceId, 5> pads;
+		for (auto& pad : pads)
+			pad = backend->AddGamepad();
+		backend->Remove(pads[3]);
+		backend->Remove(pads[1]);
+		const auto raw_a = backend->AddRawController(kRawUids[0], L"A", 3, 1, 2);
+
+		Session session;
+		const auto start = std::chrono::steady_clock::now();
+		CHECK(StartRecording(path.wstring()));
+
+		for (const size_t i : { 0, 2, 4 })
+			backend->SetGamepadState(pads[i], MakeGamepadState(100 + i, 0.1 * (double)i));
+		const bool buttons_a[3] = { true, false, true };
+		const SwitchPosition switches_a[1] = { SwitchPosition::DownLeft };
+		const double axis_a[2] = { 0.25, 1.0 };
+		backend->SetRawControllerState(raw_a, buttons_a, switches_a, axis_a, 500);
+		Checkpoint(session, start);
+
+		const auto pad5 = backend->AddGamepad();
+		CHECK(Gamepad::IsConnected(1) && !Gamepad::IsConnected(3));
+		backend->SetGamepadState(pad5, MakeGamepadState(900, -0.5));
+		backend->SetGamepadState(pads[0], MakeGamepadState(1000, 0.75));
+		Checkpoint(session, start);
+
+		backend->Remove(pads[4]);
+		backend->Remove(pads[2]);
+		Checkpoint(session, start);
+
+		const auto raw_b = backend->AddRawController(kRawUids[1], L"B", 3, 1, 2);
+		const bool buttons_b[3] = { false, true, true };
+		const SwitchPosition switches_b[1] = { SwitchPosition::Up };
+		const double axis_b[2] = { 0.5, 0.0 };
+		backend->SetRawControllerState(raw_b, buttons_b, switches_b, axis_b, 700);
+		backend->Remove(raw_a);
+		Checkpoint(session, start);
+
+		backend->AddGamepad();
+		CHECK(Gamepad::IsConnected(2) && !Gamepad::IsConnected(3) && !Gamepad::IsConnected(4));
+		Checkpoint(session, start);
+
+		backend->Remove(pad5);
+		Checkpoint(session, start);
+
+		StopRecording();
+		Backend::SetBackend(nullptr);
+		return session;
+	}
+}
+
+TEST(RecordingRoundTrip)
+{
+	const auto path = GetPath("RoundTrip");
+	const Session session = RecordSession(path);
+
+	const auto replay = Backend::ReplayBackend::Open(path);
+	CHECK(replay);
+	if (replay)
+	{
+		Backend::SetBackend(replay);
+		for (size_t i = 0; i < session.captures.size(); ++i)
+		{
+			replay->AdvanceTo(session.times[i]);
+			CheckEqual(Read(), session.captures[i]);
+		}
+
+		CHECK(!replay->AdvanceTo(UINT64_MAX));
+		CHECK(replay->IsFinished());
+		CheckEqual(Read(), session.captures.back());
+		Backend::SetBackend(nullptr);
+	}
+
+	std::filesystem::remove(path);
+}
+
+TEST(RecordingTruncated)
+{
+	const auto path = GetPath("Truncated");
+	const Session session = RecordSession(path);
+	const auto data = ReadFile(path);
+	CHECK(data.size() > sizeof(Recording::kMagic) + 1);
+
+	// a file cut anywhere replays up to the cut, one without the full header isn't a recording
+	const auto truncated_path = GetPath("Truncated-cut");
+	for (size_t size = 0; size < data.size(); ++size)
+	{
+		WriteFile(truncated_path, data.data(), size);
+		const auto replay = Backend::ReplayBackend::Open(truncated_path);
+		CHECK((replay != nullptr) == (size > sizeof(Recording::kMagic)));
+		if (replay)
+		{
+			CHECK(!replay->AdvanceTo(UINT64_MAX));
+			CHECK(replay->IsFinished());
+		}
+	}
+
+	// without its last byte the final gamepad disconnect is incomplete, everything before it still gets applied
+	WriteFile(truncated_path, data.data(), data.size() - 1);
+	const auto replay = Backend::ReplayBackend::Open(truncated_path);
+	CHECK(replay);
+	if (replay)
+	{
+		Backend::SetBackend(replay);
+		replay->AdvanceTo(UINT64_MAX);
+		CheckEqual(Read(), session.captures[session.captures.size() - 2]);
+		Backend::SetBackend(nullptr);
+	}
+
+	std::filesystem::remove(path);
+	std::filesystem::remove(truncated_path);
+}
+
+TEST(RecordingCorrupt)
+{
+	const auto path = GetPath("Corrupt");
+	RecordSession(path);
+	const auto data = ReadFile(path);
+
+	// every byte of the body overwritten with values that break varints, counts and record types
+	const auto corrupt_path = GetPath("Corrupt-byte");
+	for (size_t offset = sizeof(Recording::kMagic) + 1; offset < data.size(); ++offset)
+	{
+		for (const uint8_t value : { 0x00, 0x7F, 0x80, 0xFF })
+		{
+			auto corrupt = data;
+			corrupt[offset] = value;
+			WriteFile(corrupt_path, corrupt.data(), corrupt.size());
+			const auto replay = Backend::ReplayBackend::Open(corrupt_path);
+			CHECK(replay);
+			if (replay)
+			{
+				replay->AdvanceTo(UINT64_MAX);
+				CHECK(replay->IsFinished());
+			}
+		}
+	}
+
+	// counts above the limits are rejected before anything gets allocated for them
+	std::vector<uint8_t> crafted(std::begin(Recording::kMagic), std::end(Recording::kMagic));
+	crafted.emplace_back(Recording::kVersion);
+	const auto connect = [&](uint32_t id, uint64_t button_count, const wchar_t* uid)
+	{
+		crafted.emplace_back((uint8_t)Recording::RecordType::RawControllerConnected);
+		Recording::WriteVarint(crafted, 0);
+		Recording::WriteVarint(crafted, id);
+		Recording::WriteVarint(crafted, button_count);
+		Recording::WriteVarint(crafted, 0);
+		Recording::WriteVarint(crafted, 0);
+		for (const wchar_t* str : { uid, uid })
+		{
+			Recording::WriteVarint(crafted, std::char_traits<wchar_t>::length(str));
+			for (const wchar_t* c = str; *c; ++c)
+				Recording::WriteVarint(crafted, (uint32_t)*c);
+		}
+	};
+	connect(0, 1, L"raw-a");
+	connect(1, 1ull << 40, L"raw-b");
+
+	WriteFile(corrupt_path, crafted.data(), crafted.size());
+	auto replay = Backend::ReplayBackend::Open(corrupt_path);
+	CHECK(replay);
+	if (replay)
+	{
+		Backend::SetBackend(replay);
+		replay->AdvanceTo(UINT64_MAX);
+		CHECK(RawGameController::IsConnected(kRawUids[0]));
+		CHECK(!RawGameController::IsConnected(kRawUids[1]));
+		Backend::SetBackend(nullptr);
+	}
+
+	// a reading announcing the maximum counts without the payload for them
+	crafted.resize(sizeof(Recording::kMagic) + 1);
+	connect(0, 1, L"raw-a");
+	crafted.emplace_back((uint8_t)Recording::RecordType::RawControllerReading);
+	Recording::WriteVarint(crafted, 0);
+	Recording::WriteVarint(crafted, 0);
+	Recording::WriteSigned(crafted, 1000);
+	for (size_t i = 0; i < 3; ++i)
+		Recording::WriteVarint(crafted, Recording::kMaxInputCount);
+	crafted.emplace_back(3);
+
+	WriteFile(corrupt_path, crafted.data(), crafted.size());
+	replay = Backend::ReplayBackend::Open(corrupt_path);
+	CHECK(replay);
+	if (replay)
+	{
+		Backend::SetBackend(replay);
+		replay->AdvanceTo(UINT64_MAX);
+		bool button = true;
+		uint64_t timestamp = 0;
+		CHECK(RawGameController::GetState(kRawUids[0], &button, 1, nullptr, 0, nullptr, 0, timestamp));
+		CHECK(!button && timestamp != 1000);
+		Backend::SetBackend(nullptr);
+	}
+
+	std::filesystem::remove(path);
+	std::filesystem::remove(corrupt_path);
+}
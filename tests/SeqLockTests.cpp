@@ -0,0 +1,114 @@
+﻿#include "Test.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+#include "../src/SeqLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	// every word holds the same value, a torn read shows up as a mix of two stores
+	struct Words
+	{
+		uint64_t values[16];
+	};
+
+	bool IsConsistent(const Words& words)
+	{
+		for (const auto value : words.values)
+		{
+			if (value != words.values[0])
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST(SeqLock)
+{
+	SeqLock<Words> lock;
+	std::atomic_bool done = false;
+	std::atomic_size_t torn = 0;
+	std::atomic_size_t backwards = 0;
+
+	std::vector<std::thread> readers;
+	for (size_t i = 0; i < 3; ++i)
+	{
+		readers.emplace_back([&, i]
+		{
+			uint64_t last = 0;
+			while (!done)
+			{
+				Words words;
+				if (i == 0)
+					words = lock.Load();
+				else if (!lock.TryLoad(words))
+					continue;
+
+				if (!IsConsistent(words))
+					++torn;
+				if (words.values[0] < last)
+					++backwards;
+				last = words.values[0];
+			}
+		});
+	}
+
+	for (uint64_t i = 1; i <= 200000; ++i)
+	{
+		Words words;
+		std::fill(std::begin(words.values), std::end(words.values), i);
+		lock.Store(words);
+	}
+
+	done = true;
+	for (auto& reader : readers)
+		reader.join();
+
+	CHECK(torn == 0);
+	CHECK(backwards == 0);
+	CHECK(lock.Load().values[0] == 200000);
+}
+
+TEST(PolledSnapshots)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	const auto first = backend->AddGamepad();
+	backend->AddGamepad();
+	Backend::SetBackend(backend);
+	CHECK(Gamepad::StartPolling(1000));
+
+	GamepadState expected{};
+	expected.Timestamp = 1234;
+	expected.Buttons = GamepadButtons::A;
+	expected.LeftTrigger = 0.5;
+	expected.RightThumbstickY = -0.25;
+	backend->SetGamepadState(first, expected);
+
+	// the next poll publishes the reading
+	GamepadState state{};
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (!(Gamepad::GetState(0, state) && state.Timestamp == expected.Timestamp) && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	CHECK(state.Timestamp == expected.Timestamp);
+	CHECK(state.Buttons == expected.Buttons);
+	CHECK(state.LeftTrigger == expected.LeftTrigger);
+	CHECK(state.RightThumbstickY == expected.RightThumbstickY);
+
+	GamepadState states[2];
+	uint64_t connected = 0;
+	CHECK(Gamepad::GetAllStates(states, 2, connected) == 2);
+	CHECK(connected == 0b11);
+	CHECK(states[0].Timestamp == expected.Timestamp);
+
+	Gamepad::StopPolling();
+	Backend::SetBackend(nullptr);
+}
@@ -0,0 +1,254 @@
+﻿#include "Test.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+#include "../src/SharedState.h"
+
+#include <chrono>
+#include <cwchar>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	std::wstring GetRegionName()
+	{
+		return L"WinGamingInputTest-" + std::to_wstring(getpid());
+	}
+
+	// waits for a publish after now
+	bool WaitForPublish(const SharedState::View* view)
+	{
+		const uint64_t start = GetHostTime();
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+		while (SharedState::GetUpdateTime(view) <= start)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+}
+
+// the layout is shared between processes, it may only hold plain data and lock free atomics
+static_assert(std::is_standard_layout_v<SharedState::Layout>);
+static_assert(std::atomic_uint32_t::is_always_lock_free && std::atomic_uint64_t::is_always_lock_free);
+
+TEST(SharedStateLayout)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	backend->AddGamepad();
+	Backend::SetBackend(backend);
+
+	const auto name = GetRegionName();
+	CHECK(SharedState::StartPublishing(name, 1000));
+
+	// read the posix shm directly like a reader built from another version would
+	const auto region = SharedState::Region::Open(name, sizeof(SharedState::Layout));
+	CHECK(region != nullptr);
+	if (region)
+	{
+		const auto& layout = *(const SharedState::Layout*)region->GetData();
+		CHECK(layout.magic == SharedState::kMagic);
+		CHECK(layout.version == SharedState::kVersion);
+		CHECK(layout.size == sizeof(SharedState::Layout));
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+		while (layout.update_time == 0 && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		CHECK(layout.update_time != 0);
+
+		SharedState::GamepadSlot slot{};
+		CHECK(SharedState::LoadSlot(layout.gamepads[0], slot));
+		CHECK(slot.generation == Gamepad::GetGeneration(0));
+		CHECK(SharedState::LoadSlot(layout.gamepads[1], slot));
+		CHECK(slot.generation == 0);
+
+		SharedState::RawControllerInfo info{};
+		CHECK(SharedState::LoadSlot(layout.rcontroller_infos[0], info));
+		CHECK(info.handle == RawController::kInvalidHandle);
+	}
+
+	SharedState::StopPublishing();
+	CHECK(SharedState::Region::Open(name, sizeof(SharedState::Layout)) == nullptr); // unlinked
+	Backend::SetBackend(nullptr);
+}
+
+TEST(SharedStateRoundTrip)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	const auto gamepad = backend->AddGamepad();
+	// a character outside the BMP checks the utf-16 round trip with 4 byte wchar_t
+	const std::wstring uid = L"test-\U0001F3AE";
+	const auto controller = backend->AddRawController(uid, L"Test Controller", 3, 1, 2);
+	Backend::SetBackend(backend);
+
+	GamepadState expected{};
+	expected.Timestamp = 42;
+	expected.Buttons = GamepadButtons::B | GamepadButtons::Menu;
+	expected.LeftThumbstickX = 0.75;
+	backend->SetGamepadState(gamepad, expected);
+
+	const bool buttons[] = { true, false, true };
+	const SwitchPosition switches[] = { SwitchPosition::Left };
+	const double axis[] = { 0.25, -1.0 };
+	backend->SetRawControllerState(controller, buttons, switches, axis, 77);
+
+	const auto name = GetRegionName();
+	CHECK(SharedState::StartPublishing(name, 1000));
+	const auto* view = SharedState::Open(name);
+	CHECK(view != nullptr);
+	if (!view)
+	{
+		SharedState::StopPublishing();
+		Backend::SetBackend(nullptr);
+		return;
+	}
+
+	CHECK(WaitForPublish(view));
+
+	GamepadState state{};
+	CHECK(SharedState::GetGamepadState(view, 0, state));
+	CHECK(state.Timestamp == expected.Timestamp);
+	CHECK(state.Buttons == expected.Buttons);
+	CHECK(state.LeftThumbstickX == expected.LeftThumbstickX);
+	CHECK(!SharedState::GetGamepadState(view, 1, state));
+
+	RawController::Description description{};
+	RawController::Handle handle = RawController::kInvalidHandle;
+	CHECK(SharedState::GetRawControllers(view, &description, &handle, 1) == 1);
+	CHECK(uid == description.uid);
+	CHECK(std::wcscmp(description.display_name, L"Test Controller") == 0);
+	CHECK(description.button_count == 3 && description.switches_count == 1 && description.axis_count == 2);
+	CHECK(handle != RawController::kInvalidHandle);
+
+	bool read_buttons[3]{};
+	SwitchPosition read_switches[1]{};
+	double read_axis[2]{};
+	RawController::State raw{ read_buttons, 3, read_switches, 1, read_axis, 2, 0 };
+	CHECK(SharedState::GetRawControllerState(view, handle, raw));
+	CHECK(raw.timestamp == 77);
+	CHECK(read_buttons[0] && !read_buttons[1] && read_buttons[2]);
+	CHECK(read_switches[0] == SwitchPosition::Left);
+	CHECK(read_axis[0] == 0.25 && read_axis[1] == -1.0);
+
+	// a removed controller disappears with the next publish, its handle goes stale
+	backend->Remove(controller);
+	CHECK(WaitForPublish(view));
+	CHECK(SharedState::GetRawControllers(view, nullptr, nullptr, 1) == 0);
+	CHECK(!SharedState::GetRawControllerState(view, handle, raw));
+
+	// open views read everything as disconnected once publishing stopped
+	SharedState::StopPublishing();
+	CHECK(SharedState::GetUpdateTime(view) == 0);
+	CHECK(!SharedState::GetGamepadState(view, 0, state));
+	SharedState::Close(view);
+	CHECK(SharedState::Open(name) == nullptr);
+
+	Backend::SetBackend(nullptr);
+}
+
+TEST(SharedStateRegionInUse)
+{
+	// a running publisher keeps its name, another Create fails and leaves the region alone
+	const auto name = GetRegionName();
+	const auto other = SharedState::Region::Create(name, sizeof(SharedState::Layout));
+	CHECK(other != nullptr);
+	auto& layout = *static_cast<SharedState::Layout*>(other->GetData());
+	layout.update_time = 123;
+
+	CHECK(SharedState::Region::Create(name, sizeof(SharedState::Layout)) == nullptr);
+	CHECK(!SharedState::StartPublishing(name, 1000));
+
+	const auto region = SharedState::Region::Open(name, sizeof(SharedState::Layout));
+	CHECK(region != nullptr);
+	if (region)
+		CHECK(static_cast<const SharedState::Layout*>(region->GetData())->update_time == 123);
+}
+
+TEST(SharedStateRegionLeftBehind)
+{
+	// a publisher that dies without cleaning up leaves its region unlocked
+	const auto name = GetRegionName();
+	const pid_t child = fork();
+	if (child == 0)
+	{
+		const auto region = SharedState::Region::Create(name, sizeof(SharedState::Layout));
+		_exit(region ? 0 : 1);
+	}
+
+	int status = 0;
+	CHECK(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	CHECK(SharedState::Region::Open(name, sizeof(SharedState::Layout)) != nullptr);
+
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	backend->AddGamepad();
+	Backend::SetBackend(backend);
+
+	// taken over by the next publisher
+	CHECK(SharedState::StartPublishing(name, 1000));
+	const auto* view = SharedState::Open(name);
+	CHECK(view != nullptr);
+	CHECK(WaitForPublish(view));
+	GamepadState state{};
+	CHECK(SharedState::GetGamepadState(view, 0, state));
+	SharedState::Close(view);
+
+	SharedState::StopPublishing();
+	CHECK(SharedState::Region::Open(name, sizeof(SharedState::Layout)) == nullptr);
+	Backend::SetBackend(nullptr);
+}
+
+TEST(SharedStateRawControllerCounts)
+{
+	// more than the layout holds, read into arrays larger still that start out dirty
+	constexpr size_t kButtons = 300, kSwitches = 20, kAxes = 20;
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	const auto controller = backend->AddRawController(L"counts", L"Counts", kButtons, kSwitches, kAxes);
+	Backend::SetBackend(backend);
+
+	bool buttons[kButtons];
+	std::fill(std::begin(buttons), std::end(buttons), true);
+	const std::vector<SwitchPosition> switches(kSwitches, SwitchPosition::Up);
+	const std::vector<double> axis(kAxes, 0.5);
+	backend->SetRawControllerState(controller, buttons, switches.data(), axis.data(), 5);
+
+	const auto name = GetRegionName();
+	CHECK(SharedState::StartPublishing(name, 1000));
+	const auto* view = SharedState::Open(name);
+	CHECK(view != nullptr);
+	CHECK(WaitForPublish(view));
+
+	RawController::Handle handle = RawController::kInvalidHandle;
+	CHECK(SharedState::GetRawControllers(view, nullptr, &handle, 1) == 1);
+
+	bool read_buttons[kButtons + 10];
+	SwitchPosition read_switches[kSwitches + 4];
+	double read_axis[kAxes + 4];
+	std::fill(std::begin(read_buttons), std::end(read_buttons), true);
+	std::fill(std::begin(read_switches), std::end(read_switches), SwitchPosition::Left);
+	std::fill(std::begin(read_axis), std::end(read_axis), 9.0);
+
+	RawController::State state{ read_buttons, std::size(read_buttons), read_switches, std::size(read_switches), read_axis, std::size(read_axis), 0 };
+	CHECK(SharedState::GetRawControllerState(view, handle, state));
+	CHECK(state.timestamp == 5);
+	CHECK(std::all_of(read_buttons, read_buttons + SharedState::kMaxButtons, [](bool b) { return b; }));
+	CHECK(std::none_of(read_buttons + SharedState::kMaxButtons, std::end(read_buttons), [](bool b) { return b; }));
+	CHECK(std::all_of(read_switches, read_switches + SharedState::kMaxSwitches, [](SwitchPosition p) { return p == SwitchPosition::Up; }));
+	CHECK(std::all_of(read_switches + SharedState::kMaxSwitches, std::end(read_switches), [](SwitchPosition p) { return p == SwitchPosition::Center; }));
+	CHECK(std::all_of(read_axis, read_axis + SharedState::kMaxAxes, [](double a) { return a == 0.5; }));
+	CHECK(std::all_of(read_axis + SharedState::kMaxAxes, std::end(read_axis), [](double a) { return a == 0.0; }));
+
+	SharedState::Close(view);
+	SharedState::StopPublishing();
+	Backend::SetBackend(nullptr);
+}
@@ -0,0 +1,121 @@
+﻿#include "Test.h"
+#include "../src/Backend.h"
+#include "../src/FakeBackend.h"
+#include "../src/SlotAllocator.h"
+
+#include <memory>
+#include <vector>
+
+using namespace WindowsGamingInput;
+
+TEST(SlotAllocator)
+{
+	SlotAllocator allocator;
+	const size_t a = allocator.Allocate();
+	const size_t b = allocator.Allocate();
+	const size_t c = allocator.Allocate();
+	CHECK(a == 0 && b == 1 && c == 2);
+	CHECK(allocator.IsAllocated(b));
+	CHECK((allocator.GetGeneration(b) & 1) == 1);
+
+	// a released slot is stale and the next allocation reuses it with a new generation
+	const uint32_t generation = allocator.GetGeneration(b);
+	allocator.Release(b);
+	CHECK(!allocator.IsAllocated(b));
+	CHECK(allocator.GetGeneration(b) != generation);
+	CHECK(allocator.Allocate() == b);
+	CHECK(allocator.GetGeneration(b) == generation + 2);
+	CHECK(allocator.GetCapacity() == 3);
+
+	// thousands of hot-plugs reuse the same slots instead of growing
+	for (size_t i = 0; i < 10000; ++i)
+	{
+		const size_t index = allocator.Allocate();
+		CHECK(index == 3);
+		allocator.Release(index);
+	}
+	CHECK(allocator.GetCapacity() == 4);
+	CHECK(allocator.GetGeneration(3) == 20000);
+}
+
+TEST(GamepadSlotReuse)
+{
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+
+	constexpr size_t kConnected = 4;
+	constexpr size_t kCycles = 2500;
+
+	std::vector<Backend::FakeBackend::DeviceId> ids;
+	std::vector<uint32_t> previous(kConnected, 0);
+	for (size_t cycle = 0; cycle < kCycles; ++cycle)
+	{
+		for (size_t i = 0; i < kConnected; ++i)
+			ids.emplace_back(backend->AddGamepad());
+
+		// the slots get reused, so the registry never grows past the connected gamepads
+		CHECK(Gamepad::GetCount() == kConnected);
+		for (size_t i = 0; i < kConnected; ++i)
+		{
+			const uint32_t generation = Gamepad::GetGeneration(i);
+			CHECK(Gamepad::IsConnected(i));
+			CHECK(generation != 0);
+			CHECK(generation != previous[i]); // a (index, generation) pair from the last cycle is stale
+			previous[i] = generation;
+		}
+
+		for (const auto id : ids)
+			backend->Remove(id);
+		ids.clear();
+
+		for (size_t i = 0; i < kConnected; ++i)
+		{
+			CHECK(!Gamepad::IsConnected(i));
+			CHECK(Gamepad::GetGeneration(i) == 0);
+
+			GamepadState state;
+			CHECK(!Gamepad::GetState(i, state));
+		}
+	}
+
+	Backend::SetBackend(nullptr);
+}
+
+TEST(SlotLowestFree)
+{
+	// a new pad takes the lowest free slot, not the one freed last
+	SlotAllocator allocator;
+	for (size_t i = 0; i < 4; ++i)
+		allocator.Allocate();
+	allocator.Release(0);
+	allocator.Release(3);
+	allocator.Release(1);
+	CHECK(allocator.Allocate() == 0);
+	CHECK(allocator.Allocate() == 1);
+	CHECK(allocator.Allocate() == 3);
+	CHECK(allocator.Allocate() == 4);
+
+	allocator.Clear();
+	CHECK(allocator.GetCapacity() == 0);
+	CHECK(allocator.Allocate() == 0);
+
+	auto backend = std::make_shared<Backend::FakeBackend>();
+	Backend::SetBackend(backend);
+
+	const auto pad0 = backend->AddGamepad();
+	const auto pad1 = backend->AddGamepad();
+	const auto pad2 = backend->AddGamepad();
+	CHECK(Gamepad::GetCount() == 3);
+
+	backend->Remove(pad0);
+	backend->Remove(pad2);
+	const auto pad3 = backend->AddGamepad();
+	CHECK(Gamepad::IsConnected(0));
+	CHECK(!Gamepad::IsConnected(2));
+	const auto pad4 = backend->AddGamepad();
+	CHECK(Gamepad::IsConnected(2));
+
+	for (const auto id : { pad1, pad3, pad4 })
+		backend->Remove(id);
+	Backend::SetBackend(nullptr);
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <vector>
+
+// minimal test registry. ctest runs every test in its own process (WinGamingInputTests <name>), so the core's globals start fresh
+namespace Test
+{
+	struct Case
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	std::vector<Case>& GetCases();
+	void Fail(const char* file, int line, const char* expression);
+
+	struct Register
+	{
+		Register(const char* name, void (*run)()) { GetCases().push_back({ name, run }); }
+	};
+}
+
+#define TEST(name) \
+	static void Test_##name(); \
+	static const Test::Register g_register_##name(#name, &Test_##name); \
+	static void Test_##name()
+
+// reports the failure and keeps going, the test fails once any check failed
+#define CHECK(expression) \
+	do { if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); } while (false)
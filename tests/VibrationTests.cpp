@@ -0,0 +1,124 @@
+﻿#include "Test.h"
+#include "../src/VibrationWorker.h"
+
+#include <cmath>
+
+using namespace WindowsGamingInput;
+
+namespace
+{
+	bool Near(double a, double b)
+	{
+		return std::abs(a - b) <= 1e-12;
+	}
+
+	// level 0.8 after 5 ms: 10 ms attack, 20 ms sustain, 10 ms decay
+	VibrationEnvelope MakeEnvelope()
+	{
+		VibrationEnvelope envelope;
+		envelope.level = 0.8;
+		envelope.delay = 5;
+		envelope.attack = 10;
+		envelope.sustain = 20;
+		envelope.decay = 10;
+		return envelope;
+	}
+}
+
+TEST(VibrationEnvelope)
+{
+	const VibrationEnvelope envelope = MakeEnvelope();
+	const struct { double time; double value; bool done; } samples[] = {
+		{ 0, 0, false }, // delay
+		{ 4.9, 0, false },
+		{ 5, 0, false }, // attack from 0
+		{ 10, 0.4, false },
+		{ 14.9, 0.8 * 0.99, false },
+		{ 15, 0.8, false }, // sustain
+		{ 34.9, 0.8, false },
+		{ 35, 0.8, false }, // decay from level
+		{ 40, 0.4, false },
+		{ 44.9, 0.8 * 0.01, false },
+		{ 45, 0, true }, // done from the end of the decay on
+		{ 1000, 0, true },
+	};
+	for (const auto& sample : samples)
+	{
+		bool done = !sample.done;
+		CHECK(Near(VibrationWorker::Sample(envelope, sample.time, done), sample.value));
+		CHECK(done == sample.done);
+	}
+
+	// without attack the level applies right after the delay, without any phase the channel is done at once
+	VibrationEnvelope step = envelope;
+	step.attack = 0;
+	bool done;
+	CHECK(VibrationWorker::Sample(step, 5, done) == 0.8 && !done);
+	CHECK(VibrationWorker::Sample(VibrationEnvelope{}, 0, done) == 0 && done);
+}
+
+TEST(VibrationPulseTrain)
+{
+	// three 50 ms pulses, each one the envelope shifted by the period
+	VibrationEnvelope envelope = MakeEnvelope();
+	envelope.delay = 0;
+	envelope.period = 50;
+	envelope.count = 3;
+	for (uint32_t pulse = 0; pulse < 3; ++pulse)
+	{
+		const double start = pulse * 50.0;
+		bool done;
+		CHECK(Near(VibrationWorker::Sample(envelope, start + 5, done), 0.4) && !done);
+		CHECK(Near(VibrationWorker::Sample(envelope, start + 20, done), 0.8) && !done);
+		CHECK(Near(VibrationWorker::Sample(envelope, start + 35, done), 0.4) && !done);
+		CHECK(VibrationWorker::Sample(envelope, start + 45, done) == 0 && !done); // gap until the next pulse
+	}
+
+	bool done;
+	CHECK(VibrationWorker::Sample(envelope, 149.9, done) == 0 && !done);
+	CHECK(VibrationWorker::Sample(envelope, 150, done) == 0 && done);
+
+	// an envelope longer than the period is cut off by the next pulse
+	envelope.period = 25;
+	CHECK(Near(VibrationWorker::Sample(envelope, 24, done), 0.8) && !done);
+	CHECK(Near(VibrationWorker::Sample(envelope, 25, done), 0) && !done);
+	CHECK(Near(VibrationWorker::Sample(envelope, 35, done), 0.8) && !done);
+	CHECK(VibrationWorker::Sample(envelope, 75, done) == 0 && done);
+
+	// a count of 0 repeats until the effect gets stopped
+	envelope.count = 0;
+	CHECK(Near(VibrationWorker::Sample(envelope, 25 * 100000.0 + 20, done), 0.8) && !done);
+}
+
+TEST(VibrationEffectDone)
+{
+	// the effect is done once its longest channel is, channels past the sampled ones are ignored
+	VibrationEffect effect;
+	effect.channels[0] = MakeEnvelope(); // done at 45
+	effect.channels[1] = MakeEnvelope();
+	effect.channels[1].delay = 55; // done at 95
+	effect.channels[3] = MakeEnvelope();
+	effect.channels[3].delay = 0;
+	effect.channels[3].period = 100;
+	effect.channels[3].count = 2; // done at 200
+
+	bool done;
+	auto vibration = VibrationWorker::Sample(effect, 4, 60, done);
+	CHECK(vibration.LeftMotor == 0 && Near(vibration.RightMotor, 0.4) && vibration.LeftTrigger == 0 && Near(vibration.RightTrigger, 0));
+	CHECK(!done);
+
+	vibration = VibrationWorker::Sample(effect, 4, 100, done);
+	CHECK(vibration.LeftMotor == 0 && vibration.RightMotor == 0 && vibration.RightTrigger == 0);
+	CHECK(!done);
+
+	vibration = VibrationWorker::Sample(effect, 4, 199, done);
+	CHECK(vibration.RightTrigger == 0 && !done);
+	vibration = VibrationWorker::Sample(effect, 4, 200, done);
+	CHECK(vibration.RightTrigger == 0 && done);
+
+	// a raw controller only plays the first channel
+	VibrationWorker::Sample(effect, 1, 45, done);
+	CHECK(done);
+	VibrationWorker::Sample(effect, 2, 45, done);
+	CHECK(!done);
+}